@@ -0,0 +1,74 @@
+// analyser.h - header in front of each analyser sample buffer, usbAnalyser and usbUVC analyser mode
+// - sequence and timestamp let the host rebuild the timeline and see where buffers or samples went missing
+#pragma once
+
+#include <cyu3types.h>
+
+#define ANALYSER_HEADER_SIZE 16  // dma prodHeader, keeps gpif payload a multiple of 16 bytes
+
+// encoding
+#define ANALYSER_RAW 0  // 16 bit samples as captured
+#define ANALYSER_RLE 1  // analyserRun_t records
+
+// flags
+#define ANALYSER_FLAG_FIRST (1 << 0)  // first buffer of capture or trigger window, sequence restarts at 0
+#define ANALYSER_FLAG_PIB   (1 << 1)  // any pib error since the last buffer
+#define ANALYSER_FLAG_GAP   (1 << 2)  // gpif thread write overrun since the last buffer, no dma buffer free, samples
+                                      // dropped before this one; set by usbAnalyser only, not inferred from timestamps
+
+typedef struct analyserHeader {
+  uint8_t  encoding;  // ANALYSER_RAW, ANALYSER_RLE
+  uint8_t  flags;     // ANALYSER_FLAG_
+  uint16_t length;    // payload bytes after header
+  uint32_t sequence;  // buffers since capture start, a jump is a lost buffer
+  uint32_t timestamp; // timerTicks when gpif completed the buffer, timerFrequency ticks per second
+  uint32_t samples;   // samples in payload once decoded
+} analyserHeader_t;
+
+typedef struct analyserRun {
+  uint16_t value;
+  uint16_t run;       // samples of value, 1..65535
+} analyserRun_t;
+
+// decoders, vendor request configures, decoded events stream on their own endpoint
+#define ANALYSER_DECODERS 4
+
+#define ANALYSER_DECODE_NONE 0
+#define ANALYSER_DECODE_UART 1  // 8N1, lsb first, idle high, bit0 rx, bitSamples
+#define ANALYSER_DECODE_SPI  2  // 8 bit msb first, bit0 clk, bit1 mosi, bit2 miso, bit3 cs active low or 0xFF, mode
+#define ANALYSER_DECODE_I2C  3  // bit0 scl, bit1 sda
+
+typedef struct analyserDecoder {
+  uint8_t  type;        // ANALYSER_DECODE_
+  uint8_t  bit0;        // sample bits decoded
+  uint8_t  bit1;
+  uint8_t  bit2;
+  uint8_t  bit3;
+  uint8_t  mode;        // spi, cpol bit 1, cpha bit 0
+  uint16_t reserved;
+  uint32_t bitSamples;  // uart, samples per bit, 24.8 fixed point
+} analyserDecoder_t;
+
+typedef struct analyserDecode {
+  uint8_t  eventsOnly;  // raw samples not sent, decoded events only
+  uint8_t  reserved[3];
+  analyserDecoder_t decoder[ANALYSER_DECODERS];
+} analyserDecode_t;
+
+// event types
+#define ANALYSER_EVENT_UART      1  // data byte
+#define ANALYSER_EVENT_UART_ERR  2  // data byte, stop bit low
+#define ANALYSER_EVENT_SPI       3  // data mosi byte, miso byte << 8
+#define ANALYSER_EVENT_SPI_END   4  // cs deasserted, data bits of an unfinished byte
+#define ANALYSER_EVENT_I2C_START 5  // start or repeated start
+#define ANALYSER_EVENT_I2C_STOP  6
+#define ANALYSER_EVENT_I2C_ADDR  7  // data address byte, bit 8 nack
+#define ANALYSER_EVENT_I2C_DATA  8  // data byte, bit 8 nack
+#define ANALYSER_EVENT_LOST      9  // data events dropped before this one, event endpoint not read
+
+typedef struct analyserEvent {
+  uint32_t sample;      // sample index since capture start the event completed on
+  uint8_t  decoder;     // index into analyserDecode_t decoder
+  uint8_t  type;        // ANALYSER_EVENT_
+  uint16_t data;
+} analyserEvent_t;
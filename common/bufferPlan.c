@@ -0,0 +1,60 @@
+// bufferPlan.c - pick dma buffer size, count from usb speed, frame size, free buffer heap
+//{{{  includes
+#include <cyu3system.h>
+#include <cyu3usb.h>
+
+#include "bufferPlan.h"
+//}}}
+
+//{{{
+void bufferPlanMake (bufferPlan_t* plan, CyU3PUSBSpeed_t speed, uint32_t size, uint32_t frameSize,
+                     uint16_t header, uint16_t footer) {
+// plan for a many to one channel, count buffers for each of the two gpif sockets
+// - call with the previous channel destroyed, so its buffers count as free
+// - size is a whole number of max packets for the speed
+// - size != 0 overrides, isochronous buffers hold one service interval
+// - count buffers a sixth of a frame to ride out host scheduling gaps,
+//   never more than a frame, limited by buffer heap less BUFFER_PLAN_RESERVE
+// - frameSize 0, continuous stream, count as many as the heap allows
+
+  if (!size)
+    size = (speed == CY_U3P_SUPER_SPEED) ? BUFFER_PLAN_SIZE_SS : BUFFER_PLAN_SIZE_HS;
+  plan->size = size;
+  plan->payload = plan->size - header - footer;
+
+  CyU3PBufGetFree (&plan->heapFree, &plan->heapLargest);
+
+  // allocator leaves a free cache line after each buffer
+  uint32_t pairBytes = 2 * (plan->size + 32);
+  uint32_t count = (plan->heapFree > BUFFER_PLAN_RESERVE) ?
+                     (plan->heapFree - BUFFER_PLAN_RESERVE) / pairBytes : 0;
+
+  if (frameSize) {
+    uint32_t wantCount = (frameSize / 6) / (2 * plan->payload);
+    uint32_t frameCount = (frameSize / (2 * plan->payload)) + 1;
+    if (wantCount > frameCount)
+      wantCount = frameCount;
+    if (count > wantCount)
+      count = wantCount;
+    }
+
+  if (count > BUFFER_PLAN_COUNT_MAX)
+    count = BUFFER_PLAN_COUNT_MAX;
+  if (count < BUFFER_PLAN_COUNT_MIN)
+    count = BUFFER_PLAN_COUNT_MIN;
+
+  plan->count = count;
+  }
+//}}}
+//{{{
+uint32_t bufferPlanSpare (uint32_t size) {
+// count of size buffers the buffer heap can spare, leaving BUFFER_PLAN_RESERVE
+
+  uint32_t heapFree;
+  uint32_t heapLargest;
+  CyU3PBufGetFree (&heapFree, &heapLargest);
+
+  // allocator leaves a free cache line after each buffer
+  return (heapFree > BUFFER_PLAN_RESERVE) ? (heapFree - BUFFER_PLAN_RESERVE) / (size + 32) : 0;
+  }
+//}}}
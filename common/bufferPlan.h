@@ -0,0 +1,26 @@
+// bufferPlan.h - dma buffer size, count for a two socket gpif channel
+#pragma once
+
+#include <cyu3types.h>
+#include <cyu3usbconst.h>
+
+#define BUFFER_PLAN_SIZE_SS   16384       // 16 x 1024 byte burst
+#define BUFFER_PLAN_SIZE_HS   8192        // 16 x 512 byte packets
+#define BUFFER_PLAN_COUNT_MIN 2           // per producer socket
+#define BUFFER_PLAN_COUNT_MAX 16          // per producer socket
+#define BUFFER_PLAN_RESERVE   (16 * 1024) // buffer heap left for other channels
+
+typedef struct bufferPlan {
+  uint32_t size;        // dma buffer size, includes prodHeader, prodFooter
+  uint32_t count;       // buffers per producer socket
+  uint32_t payload;     // gpif bytes per buffer, size - header - footer
+  uint32_t heapFree;    // buffer heap free bytes when planned
+  uint32_t heapLargest; // largest contiguous free block when planned
+} bufferPlan_t;
+
+extern void bufferPlanMake (bufferPlan_t* plan, CyU3PUSBSpeed_t speed, uint32_t size, uint32_t frameSize,
+                            uint16_t header, uint16_t footer);
+extern uint32_t bufferPlanSpare (uint32_t size);
+
+// cyfxtx.c
+extern void CyU3PBufGetFree (uint32_t* free_p, uint32_t* largest_p);
@@ -939,6 +939,52 @@ void CyU3PBufGetCounts (uint32_t* allocCnt_p, uint32_t* freeCnt_p)
 }
 //}}}
 //{{{
+/* Function     : CyU3PBufGetFree
+ * Description  : Get the free space left in the DMA buffer heap, used to size DMA channels.
+ * Parameters   :
+ *                free_p    : Parameter to be filled with the total free bytes.
+ *                largest_p : Parameter to be filled with the largest contiguous free block in bytes.
+ * Return Value : None
+ */
+void CyU3PBufGetFree (uint32_t* free_p, uint32_t* largest_p)
+{
+    uint32_t status, wordnum, bitnum;
+    uint32_t run = 0, largest = 0, total = 0;
+
+    if (CyU3PThreadIdentify())
+        status = CyU3PMutexGet (&glBufferManager.lock, CY_U3P_BUFFER_ALLOC_TIMEOUT);
+    else
+        status = CyU3PMutexGet (&glBufferManager.lock, CYU3P_NO_WAIT);
+
+    if (status == CY_U3P_SUCCESS)
+    {
+        /* One status bit per cache line, a clear bit is a free line. */
+        for (wordnum = 0; wordnum < glBufferManager.statusSize; wordnum++)
+        {
+            for (bitnum = 0; bitnum < 32; bitnum++)
+            {
+                if ((glBufferManager.usedStatus[wordnum] & (1 << bitnum)) == 0)
+                {
+                    total++;
+                    run++;
+                    if (run > largest)
+                        largest = run;
+                }
+                else
+                    run = 0;
+            }
+        }
+
+        CyU3PMutexPut (&glBufferManager.lock);
+    }
+
+    if (free_p != 0)
+        *free_p = total * FX3_CACHE_LINE_SZ;
+    if (largest_p != 0)
+        *largest_p = largest * FX3_CACHE_LINE_SZ;
+}
+//}}}
+//{{{
 /* Function     : CyU3PBufGetActiveList
  * Description  : Get list of current in-use memory blocks. This can be used to
  *                check for memory leaks leading to allocation failure at runtime.
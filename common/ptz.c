@@ -11,6 +11,9 @@ static int32_t pan_cur;     /* Current pan value. */
 static int32_t tilt_cur;    /* Current tilt value. */
 static uint16_t zoom_cur;   /* Current zoom value. */
 
+volatile static int pending;  /* Window out of date with pan, tilt, zoom, set by control thread. */
+static int frames;          /* Frames since last window update. */
+
 //{{{
 uint16_t CyFxUvcAppGetCurrentZoom() {
 
@@ -34,6 +37,7 @@ int32_t CyFxUvcAppGetCurrentTilt() {
 void CyFxUvcAppModifyPan (int32_t panValue) {
 
   pan_cur = panValue;
+  pending = 1;
   line3 ("pan", panValue);
   CyU3PDebugPrint (4, "Pan %d\r\n", panValue);
   }
@@ -42,6 +46,7 @@ void CyFxUvcAppModifyPan (int32_t panValue) {
 void CyFxUvcAppModifyTilt (int32_t tiltValue) {
 
   tilt_cur = tiltValue;
+  pending = 1;
   line3 ("tilt", tiltValue);
   CyU3PDebugPrint (4, "Tilt %d\r\n", tiltValue);
   }
@@ -50,17 +55,62 @@ void CyFxUvcAppModifyTilt (int32_t tiltValue) {
 void CyFxUvcAppModifyZoom (uint16_t zoomValue) {
 
   zoom_cur = zoomValue;
+  pending = 1;
   line3 ("zoom", zoomValue);
-  sensorFocus (zoomValue);
   CyU3PDebugPrint (4, "Zoom %d\r\n", zoomValue);
   }
 //}}}
 
+
+//{{{
+void PTZRefresh() {
+// mode switched, window of the new mode needs applying
+
+  pending = 1;
+  }
+//}}}
+//{{{
+int PTZFrame (int lines) {
+// called each frame end, sensor i2c held, applies the latest window at most every PTZ_RATE_FRAMES
+// - zoom 0:255 is 1x:4x, crop shrinks, scaler keeps the output size
+// - pan, tilt full range moves the crop across the free travel, positive tilt up
+// - returns 1 when a window was written
+
+  if (frames < PTZ_RATE_FRAMES)
+    frames++;
+  if (!pending || (frames < PTZ_RATE_FRAMES))
+    return 0;
+
+  // cleared before reading, a change during the i2c write below is applied next time
+  pending = 0;
+  int32_t pan = pan_cur;
+  int32_t tilt = tilt_cur;
+  int32_t zoom = zoom_cur;
+
+  // pre scaler size of the mode, 4:3
+  int32_t fullHeight = lines;
+  int32_t fullWidth = (lines * 4) / 3;
+
+  int32_t width = ((fullWidth * 255) / (255 + 3 * zoom)) & ~1;
+  int32_t height = (fullHeight * 255) / (255 + 3 * zoom);
+
+  int32_t x = ((fullWidth - width) / 2) + (((int64_t)pan * ((fullWidth - width) / 2)) / PANTILT_MAX);
+  int32_t y = ((fullHeight - height) / 2) - (((int64_t)tilt * ((fullHeight - height) / 2)) / PANTILT_MAX);
+
+  sensorCrop (lines, x & ~1, y, width, height);
+
+  frames = 0;
+  return 1;
+  }
+//}}}
+
 //{{{
 void PTZInit() {
 
   zoom_cur = ZOOM_DEFAULT;
   pan_cur = 0;
   tilt_cur = 0;
+  pending = 0;
+  frames = 0;
   }
 //}}}
@@ -27,6 +27,8 @@
 #define CyFxUvcAppGetTiltResolution()   ((int32_t)1)        /* Resolution for tilt setting. */
 #define CyFxUvcAppGetDefaultTilt()      ((int32_t)0)        /* Default tilt setting. */
 
+#define PTZ_RATE_FRAMES                 4                   /* Minimum frames between crop window updates. */
+
 extern void PTZInit();
 
 extern uint16_t CyFxUvcAppGetCurrentZoom();
@@ -36,3 +38,6 @@ extern int32_t CyFxUvcAppGetCurrentTilt();
 extern void CyFxUvcAppModifyPan (int32_t panValue);
 extern void CyFxUvcAppModifyTilt (int32_t tiltValue);
 extern void CyFxUvcAppModifyZoom  (uint16_t zoomValue);
+
+extern void PTZRefresh();
+extern int PTZFrame (int lines);
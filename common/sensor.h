@@ -6,11 +6,30 @@
 extern void I2C_Write (uint8_t hiAddr, uint8_t loAddr, uint8_t hiData, uint8_t loData);
 extern void I2C_Read (uint8_t hiAddr, uint8_t loAddr, uint8_t *buf);
 
-extern uint8_t sensorGetBrightness();
-extern void sensorSetBrightness (uint8_t brightness);
+// sensorControl controls, processing unit
+#define CONTROL_BRIGHTNESS 0  // ae target 0:255
+#define CONTROL_CONTRAST   1  // 0:4, 100% to 200%
+#define CONTROL_SATURATION 2  // 0:6, 0% to 150%
+#define CONTROL_SHARPNESS  3  // 0:7
+#define CONTROL_GAIN       4  // 32:127, 1x to 4x
+#define CONTROL_GAMMA      5  // 0:4 gamma table
+#define CONTROL_WB_TEMP    6  // 2800:6500 K
+#define CONTROL_WB_AUTO    7  // 0:1
+#define CONTROL_POWER_LINE 8  // 0 disabled, 1 50Hz, 2 60Hz
+
+extern void sensorControl (int control, int value);
 
 extern void sensorScaling (int lines);
+extern void sensorJpeg (int lines, int enable);
+extern int sensorJpegCapable();
+extern void sensorFrameInterval (int lines, uint32_t interval);
+extern void sensorCrop (int lines, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+extern void sensorStats (uint16_t* luma, uint16_t* sharpness);
+extern void sensorAutoExposure (int enable);
+extern int sensorExposure (uint32_t exposure);
 extern void sensorButton (int value);
 extern void sensorFocus (int value);
 
 extern void sensorInit();
+extern uint32_t sensorInitMs();
+extern void sensorShadowCounters (uint32_t* hits, uint32_t* misses);
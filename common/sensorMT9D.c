@@ -16,7 +16,66 @@
 #define SENSOR_ADDR_WR112 0x78
 #define SENSOR_ADDR_RD112 0x79
 
+#define SENSOR_SLEEP     0xFFFF // pseudo address, value = ms
+#define SENSOR_SEQ_WAIT  0xFFFE // pseudo address, wait sequencer cmd done, value = timeout ms
+#define SENSOR_BURST_MAX 8      // mcu data burst registers, 111 0xC8:0xCF, 112 0x3390:0x339E
+
+#define SHADOW_VARS      32     // direct mapped mcu var shadow entries
+
+// mcu var address, 12:8 driver id, shadowed drivers only firmware writes, the mcu never changes
+#define SHADOW_DRIVER_MODE 7    // mode, output size, crop, gamma, per context
+#define SHADOW_DRIVER_JPEG 9    // jpeg config
+#define SHADOW_DRIVER_SFR  16   // special function registers, focus gpio
+
+//{{{
+typedef struct sensorReg {
+  uint16_t address;
+  uint16_t value;
+  } sensorReg_t;
+//}}}
+
+//{{{
+typedef struct shadowVar {
+  uint16_t var;
+  uint16_t value;
+  } shadowVar_t;
+//}}}
+
 static int mt9d111 = 1;
+static uint32_t initMs = 0;
+
+//{{{  shadow vars
+static int shadowPage = -1;  // mt9d111 0xF0 page select, -1 unknown
+static uint16_t chipId = 0;  // static, served from shadow
+static shadowVar_t shadowVars[SHADOW_VARS];
+
+static uint32_t shadowHits = 0;
+static uint32_t shadowMisses = 0;
+//}}}
+//{{{
+static void shadowInvalidate() {
+// forget page and vars, after reset or when the host writes behind our back
+
+  shadowPage = -1;
+  CyU3PMemSet ((uint8_t*)shadowVars, 0, sizeof(shadowVars));
+  }
+//}}}
+//{{{
+static int shadowOwned (uint16_t var) {
+// sequencer, ae, awb, flicker vars change under the mcu, eg awb moves awb.CCMPosition, never shadowed
+
+  uint16_t driver = (var >> 8) & 0x1F;
+  return (driver == SHADOW_DRIVER_MODE) || (driver == SHADOW_DRIVER_JPEG) || (driver == SHADOW_DRIVER_SFR);
+  }
+//}}}
+//{{{
+static shadowVar_t* shadowFind (uint16_t var) {
+// var 0 never used, marks empty entry
+
+  return &shadowVars[(var ^ (var >> 8)) % SHADOW_VARS];
+  }
+//}}}
+
 //{{{
 static void I2Cinit (int speed) {
 
@@ -45,15 +104,23 @@ static uint16_t readReg111  (uint16_t address) {
   uint8_t buf[2];
   buf[0] = 0;
   buf[1] = 0;
-  if (CyU3PI2cReceiveBytes (&preamble, buf, 2, 0) == CY_U3P_SUCCESS)
-    CyU3PBusyWait (10);
+  CyU3PI2cReceiveBytes (&preamble, buf, 2, 0);
 
   return (buf[0] << 8) | buf[1];
   }
 //}}}
 //{{{
-static void writeReg111 (uint16_t address, uint16_t value) {
-// 1 byte address
+static CyU3PReturnStatus_t writeReg111 (uint16_t address, uint16_t value) {
+// 1 byte address, page select skipped if already selected, shadowed once written
+
+  if (address == 0xF0) {
+    if (shadowPage == value) {
+      shadowHits++;
+      return CY_U3P_SUCCESS;
+      }
+    shadowMisses++;
+    shadowPage = -1;
+    }
 
   CyU3PI2cPreamble_t preamble;
   preamble.buffer[0] = SENSOR_ADDR_WR111;
@@ -65,8 +132,10 @@ static void writeReg111 (uint16_t address, uint16_t value) {
   buf[0] = value >> 8;
   buf[1] = value & 0xFF;
 
-  if (CyU3PI2cTransmitBytes (&preamble, buf, 2, 0) == CY_U3P_SUCCESS)
-    CyU3PBusyWait (10);
+  CyU3PReturnStatus_t status = CyU3PI2cTransmitBytes (&preamble, buf, 2, 0);
+  if ((address == 0xF0) && (status == CY_U3P_SUCCESS))
+    shadowPage = value;
+  return status;
   }
 //}}}
 
@@ -85,14 +154,13 @@ static uint16_t readReg112 (uint16_t address) {
   uint8_t buf[2];
   buf[0] = 0;
   buf[1] = 0;
-  if (CyU3PI2cReceiveBytes (&preamble, buf, 2, 0) == CY_U3P_SUCCESS)
-    CyU3PBusyWait (10);
+  CyU3PI2cReceiveBytes (&preamble, buf, 2, 0);
 
   return (buf[0] << 8) | buf[1];
   }
 //}}}
 //{{{
-static void writeReg112 (uint16_t address, uint16_t value) {
+static CyU3PReturnStatus_t writeReg112 (uint16_t address, uint16_t value) {
 // 2 byte address
 
   CyU3PI2cPreamble_t preamble;
@@ -106,14 +174,193 @@ static void writeReg112 (uint16_t address, uint16_t value) {
   buf[0] = value >> 8;
   buf[1] = value & 0xFF;
 
-  if (CyU3PI2cTransmitBytes (&preamble, buf, 2, 0) == CY_U3P_SUCCESS)
-    CyU3PBusyWait (10);
+  return CyU3PI2cTransmitBytes (&preamble, buf, 2, 0);
+  }
+//}}}
+//{{{
+static void writeBurst (uint16_t address, uint16_t* values, int count) {
+// one transfer of count values to auto incrementing registers from address
+
+  CyU3PI2cPreamble_t preamble;
+  if (mt9d111) {
+    preamble.buffer[0] = SENSOR_ADDR_WR111;
+    preamble.buffer[1] = address & 0xFF;
+    preamble.length = 2;
+    }
+  else {
+    preamble.buffer[0] = SENSOR_ADDR_WR112;
+    preamble.buffer[1] = address >> 8;
+    preamble.buffer[2] = address & 0xFF;
+    preamble.length = 3;
+    }
+  preamble.ctrlMask = 0x0000;
+
+  uint8_t buf[SENSOR_BURST_MAX * 2];
+  for (int i = 0; i < count; i++) {
+    buf[i*2] = values[i] >> 8;
+    buf[i*2 + 1] = values[i] & 0xFF;
+    }
+
+  CyU3PI2cTransmitBytes (&preamble, buf, count * 2, 0);
+  }
+//}}}
+//{{{
+static void writeVar (uint16_t var, uint16_t value) {
+// write mcu var, skipped if shadow already holds value, firmware owned vars only
+// - shadow only holds values the sensor acked, a failed write is retried by the next caller
+
+  int owned = shadowOwned (var);
+  shadowVar_t* shadow = shadowFind (var);
+  if (owned && (shadow->var == var) && (shadow->value == value)) {
+    shadowHits++;
+    return;
+    }
+
+  shadowMisses++;
+  if (owned)
+    shadow->var = 0;
+
+  CyU3PReturnStatus_t status;
+  if (mt9d111) {
+    status = writeReg111 (0xC6, var);
+    if (status == CY_U3P_SUCCESS)
+      status = writeReg111 (0xC8, value);
+    }
+  else {
+    status = writeReg112 (0x338C, var);
+    if (status == CY_U3P_SUCCESS)
+      status = writeReg112 (0x3390, value);
+    }
+
+  if (owned && (status == CY_U3P_SUCCESS)) {
+    shadow->var = var;
+    shadow->value = value;
+    }
   }
 //}}}
-//
+//{{{
+static uint16_t readVar (uint16_t var) {
+// live read, vars we poll are changed by the mcu
+
+  if (mt9d111) {
+    writeReg111 (0xC6, var);
+    return readReg111 (0xC8);
+    }
+  else {
+    writeReg112 (0x338C, var);
+    return readReg112 (0x3390);
+    }
+  }
+//}}}
+//{{{
+static int waitVar (uint16_t var, uint16_t value, uint32_t timeout) {
+// poll mcu var until value, instead of sleeping the worst case, returns 0 on timeout
+
+  uint32_t start = CyU3PGetTime();
+  while (readVar (var) != value) {
+    if (CyU3PGetTime() - start > timeout)
+      return 0;
+    CyU3PThreadSleep (2);
+    }
+
+  return 1;
+  }
+//}}}
+//{{{
+static void sensorWriteTable (const sensorReg_t* table, int count) {
+// write register table, merging runs into single i2c bursts
+// - var address, data pairs with consecutive vars, 8bit vars step 1, 16bit step 2, burst to mcu data regs
+// - consecutive registers, 111 step 1, 112 step 2, burst with register auto increment
+
+  uint16_t varAddrReg = mt9d111 ? 0xC6 : 0x338C;
+  uint16_t varDataReg = mt9d111 ? 0xC8 : 0x3390;
+  uint16_t regStep = mt9d111 ? 1 : 2;
+  uint16_t values[SENSOR_BURST_MAX];
+
+  int i = 0;
+  while (i < count) {
+    const sensorReg_t* reg = &table[i];
+
+    if (reg->address == SENSOR_SLEEP) {
+      CyU3PThreadSleep (reg->value);
+      i++;
+      }
+
+    else if (reg->address == SENSOR_SEQ_WAIT) {
+      if (!waitVar (0xA103, 0, reg->value))
+        CyU3PDebugPrint (4, "sensor sequencer timeout\r\n");
+      i++;
+      }
+
+    else if ((reg->address == varAddrReg) && (i+1 < count) && (table[i+1].address == varDataReg)) {
+      //{{{  var run, pairs of var address, var data
+      uint16_t var = reg->value;
+      uint16_t varStep = (var & 0x8000) ? 1 : 2;
+
+      int n = 0;
+      while ((n < SENSOR_BURST_MAX) && (i+1 < count) &&
+             (table[i].address == varAddrReg) && (table[i+1].address == varDataReg) &&
+             (table[i].value == var + (n * varStep))) {
+        values[n++] = table[i+1].value;
+        i += 2;
+        }
+
+      // table writes bypass the var shadow, its entries stay empty until written at runtime
+      if (mt9d111)
+        writeReg111 (varAddrReg, var);
+      else
+        writeReg112 (varAddrReg, var);
+
+      if (n == 1) {
+        if (mt9d111)
+          writeReg111 (varDataReg, values[0]);
+        else
+          writeReg112 (varDataReg, values[0]);
+        }
+      else
+        writeBurst (varDataReg, values, n);
+      }
+      //}}}
+
+    else {
+      //{{{  register run, stops at var and page registers
+      uint16_t address = reg->address;
+
+      int n = 0;
+      while ((n < SENSOR_BURST_MAX) && (i < count) &&
+             (table[i].address == address + (n * regStep)) &&
+             (table[i].address != varAddrReg) && (table[i].address != varDataReg) &&
+             (!mt9d111 || (table[i].address != 0xF0))) {
+        values[n++] = table[i].value;
+        i++;
+        }
+
+      if (n == 0) {
+        // lone var address or data register
+        values[n++] = table[i].value;
+        i++;
+        }
+
+      if (n == 1) {
+        if (mt9d111)
+          writeReg111 (address, values[0]);
+        else
+          writeReg112 (address, values[0]);
+        }
+      else
+        writeBurst (address, values, n);
+      }
+      //}}}
+    }
+  }
+//}}}
+
 //{{{
 void I2C_Write (uint8_t hiAddr, uint8_t loAddr, uint8_t hiData, uint8_t loData) {
 
+  // host may write vars through the var registers
+  CyU3PMemSet ((uint8_t*)shadowVars, 0, sizeof(shadowVars));
+
   if (mt9d111)
     writeReg111 (loAddr, (hiData << 8) | loData);
   else
@@ -122,27 +369,105 @@ void I2C_Write (uint8_t hiAddr, uint8_t loAddr, uint8_t hiData, uint8_t loData)
 //}}}
 //{{{
 void I2C_Read (uint8_t hiAddr, uint8_t loAddr, uint8_t *buf) {
+// page select and chip id served from shadow, everything else from the bus
+
+  uint16_t value;
+  if (mt9d111 && (loAddr == 0xF0) && (shadowPage >= 0)) {
+    shadowHits++;
+    value = shadowPage;
+    }
+  else if (mt9d111 && (loAddr == 0) && (shadowPage == 0) && chipId) {
+    shadowHits++;
+    value = chipId;
+    }
+  else if (!mt9d111 && (((hiAddr << 8) | loAddr) == 0x3000) && chipId) {
+    shadowHits++;
+    value = chipId;
+    }
+  else {
+    shadowMisses++;
+    value = mt9d111 ? readReg111 (loAddr) : readReg112 ((hiAddr << 8) | loAddr);
+    }
 
-  uint16_t value = mt9d111 ? readReg111 (loAddr) : readReg112 ((hiAddr << 8) | loAddr);
   buf[0] = value >> 8;
   buf[1] = value & 0xFF;
   }
 //}}}
 
 //{{{
-uint8_t sensorGetBrightness() {
-  if (mt9d111)
-    return 0x34;
-  else
-    return 0x34;
-  }
-//}}}
-//{{{
-void sensorSetBrightness (uint8_t brightness) {
+void sensorControl (int control, int value) {
+// processing unit controls, value already range checked against the UVC control table
+// - mcu vars common to both, ae.Target, mode.gam_cont A,B, awb.CCMPosition, fd.mode, seq.mode
+// - mt9d111 saturation R0x25:1, sharpness R0x05:1, gain R0x2F:0
+// - mt9d112 saturation awb.saturation, no sharpness, gain mapping, value only kept
+
+  static int contrast = 0;
+  static int gamma = 2;
+
+  // 0%, 25%, 37.5%, 50%, 75%, 100%, 150% - mt9d111 R0x25:1 5:3 codes, mt9d112 awb.saturation
+  static const uint8_t saturation111[7] = { 6, 4, 3, 2, 1, 0, 5 };
+  static const uint8_t saturation112[7] = { 0, 8, 11, 15, 23, 30, 45 };
+
   if (mt9d111)
-    CyU3PDebugPrint (4, "SensorSetBrightness %d\r\n", brightness);
-  else
-    CyU3PDebugPrint (4, "SensorSetBrightness %d\r\n", brightness);
+    writeReg111 (0xF0, 1); // page 1
+
+  switch (control) {
+    case CONTROL_BRIGHTNESS:
+      writeVar (0xA206, value); // ae.Target
+      break;
+
+    case CONTROL_CONTRAST:
+    case CONTROL_GAMMA:
+      // mode.gam_cont A,B - 6:4 contrast, 2:0 gamma, sequencer refresh to take effect
+      if (control == CONTROL_CONTRAST)
+        contrast = value;
+      else
+        gamma = value;
+      writeVar (0xA743, (contrast << 4) | gamma);
+      writeVar (0xA744, (contrast << 4) | gamma);
+      writeVar (0xA103, 5);
+      break;
+
+    case CONTROL_SATURATION:
+      if (mt9d111)
+        writeReg111 (0x25, (readReg111 (0x25) & ~0x38) | (saturation111[value] << 3));
+      else
+        writeVar (0xA352, saturation112[value]);
+      break;
+
+    case CONTROL_SHARPNESS:
+      if (mt9d111)
+        writeReg111 (0x05, (readReg111 (0x05) & ~0x07) | value); // aperture correction 2:0
+      break;
+
+    case CONTROL_GAIN:
+      if (mt9d111) {
+        writeReg111 (0xF0, 0); // page 0
+        writeReg111 (0x2F, value); // global gain
+        writeReg111 (0xF0, 1); // page 1
+        }
+      break;
+
+    case CONTROL_WB_TEMP:
+      // awb.CCMPosition 0 incandescent 2800K to 127 daylight 6500K, held while awb off
+      writeVar (0xA351, ((value - 2800) * 127) / (6500 - 2800));
+      break;
+
+    case CONTROL_WB_AUTO: {
+      // sequencer.mode - 5:0 - 6500K:AF:histogram:AWB:flicker:AE
+      uint16_t mode = readVar (0xA102);
+      writeVar (0xA102, value ? (mode | 0x04) : (mode & ~0x04));
+      break;
+      }
+
+    case CONTROL_POWER_LINE:
+      // fd.mode 7 manual, 6 50Hz, 0 disabled, 1 50Hz, 2 60Hz
+      writeVar (0xA404, (value == 1) ? 0xC0 : (value == 2) ? 0x80 : 0);
+      break;
+
+    default:
+      break;
+    }
   }
 //}}}
 
@@ -152,119 +477,217 @@ void sensorScaling (int lines) {
   if (mt9d111) {
     if (lines == 1200) {
       line2 ("1600x1200x9");
-      writeReg111 (0xC6, 0xA120); writeReg111 (0xC8, 0x02); // Sequencer.params.mode - capture video
-      writeReg111 (0xC6, 0xA103); writeReg111 (0xC8, 0x02); // Sequencer goto capture B  - 1600x1200
+      writeVar (0xA120, 0x02); // Sequencer.params.mode - capture video
+      writeVar (0xA103, 0x02); // Sequencer goto capture B  - 1600x1200
       }
     else {
       line2 ("800x600x18");
-      writeReg111 (0xC6, 0xA120); writeReg111 (0xC8, 0x00); // Sequencer.params.mode - none
-      writeReg111 (0xC6, 0xA103); writeReg111 (0xC8, 0x01); // Sequencer goto preview A - 800x600
+      writeVar (0xA120, 0x00); // Sequencer.params.mode - none
+      writeVar (0xA103, 0x01); // Sequencer goto preview A - 800x600
       }
     }
 
   else {
     if (lines == 1200) {
       line2 ("1600x1200x15");
-      writeReg112 (0x338C, 0xA120); writeReg112 (0x3390, 0x0002); // sequencer.params.mode - capture video
-      writeReg112 (0x338C, 0xA103); writeReg112 (0x3390, 0x0002); // sequencer.cmd - goto capture mode B
+      writeVar (0xA120, 0x0002); // sequencer.params.mode - capture video
+      writeVar (0xA103, 0x0002); // sequencer.cmd - goto capture mode B
       }
     else{
       line2 ("800x600x30");
-      writeReg112 (0x338C, 0xA120); writeReg112 (0x3390, 0x0000); // sequencer.params.mode - none
-      writeReg112 (0x338C, 0xA103); writeReg112 (0x3390, 0x0001); // sequencer.cmd - goto preview mode A
+      writeVar (0xA120, 0x0000); // sequencer.params.mode - none
+      writeVar (0xA103, 0x0001); // sequencer.cmd - goto preview mode A
       }
     }
 
-  CyU3PThreadSleep (100);
+  // wait for sequencer.state capture 7, preview 3, rather than a fixed sleep
+  if (!waitVar (0xA104, (lines == 1200) ? 7 : 3, 500))
+    CyU3PDebugPrint (4, "sensorScaling sequencer timeout\r\n");
   }
 //}}}
 //{{{
-void sensorButton (int value) {
+void sensorJpeg (int lines, int enable) {
+// select jpeg encoder output for the mode lines selects, call before sensorScaling switches mode
+// - mt9d111 mode.config bit4 disables jpeg A, bit5 disables jpeg B
+// - mt9d112 has no jpeg encoder, stays uncompressed
 
   if (mt9d111) {
+    uint16_t modeConfig = 0x30;
+    if (enable)
+      modeConfig = (lines == 1200) ? 0x10 : 0x20;
+
     writeReg111 (0xF0, 1); // page 1
-    if (value) {
-      line2 ("cam AE 6500");
-      // sequencer.mode - 5:0 - 6500K:AF:histogram:AWB:flicker:AE
-      writeReg111 (0xC6, 0xA102); writeReg111 (0xC8, 0x21);
-      }
-    else  {
-      line2 ("cam none");
-      writeReg111 (0xC6, 0xA102); writeReg111 (0xC8, 0);
-      }
+    writeVar (0x270B, modeConfig); // mode.config - jpeg A,B disable
+    writeVar (0xA906, 0);          // jpeg.format - YCbCr 4:2:2
+    writeVar (0xA907, enable ? 1 : 0); // jpeg.config - video, continuous frames
+    }
+  }
+//}}}
+//{{{
+int sensorJpegCapable() {
+// mt9d111 only, mt9d112 has no jpeg encoder
 
-    CyU3PThreadSleep (20);
+  return mt9d111;
+  }
+//}}}
+//{{{
+void sensorFrameInterval (int lines, uint32_t interval) {
+// interval in 100ns units, slower than the mode rate by stretching VBLANK
+// - mt9d111 both modes, row time 53.772us, base VBLANK 11 gives 30fps A, 15fps B
+// - mt9d112 runs at its mode rate
+
+  if (mt9d111) {
+    uint32_t baseInterval = (lines == 1200) ? 666666 : 333333;
+    uint32_t vblank = 11;
+    if (interval > baseInterval)
+      vblank += ((interval - baseInterval) * 10) / 5377;
+
+    writeReg111 (0xF0, 0); // page 0
+    writeReg111 ((lines == 1200) ? 0x06 : 0x08, vblank);  // VBLANK B, VBLANK A
+    writeReg111 (0xF0, 1); // page 1
+    }
+  }
+//}}}
+//{{{
+void sensorCrop (int lines, uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+// crop window of the mode lines selects, pre scaler coords, scaler keeps the output size
+// - sequencer refresh latches the new window at the next frame start, no torn frame
+// - mt9d111 crop A 0x2727, B 0x2735, mt9d112 crop A 0x2751, B 0x275F
+
+  uint16_t var;
+  if (mt9d111) {
+    writeReg111 (0xF0, 1); // page 1
+    var = (lines == 1200) ? 0x2735 : 0x2727;
     }
+  else
+    var = (lines == 1200) ? 0x275F : 0x2751;
 
+  writeVar (var, x);              // Crop_X0
+  writeVar (var + 2, x + width);  // Crop_X1
+  writeVar (var + 4, y);          // Crop_Y0
+  writeVar (var + 6, y + height); // Crop_Y1
+  writeVar (0xA103, 5);           // sequencer refresh
+  }
+//}}}
+//{{{
+void sensorStats (uint16_t* luma, uint16_t* sharpness) {
+// per frame statistics for the ae af loop
+// - ae.CurrentY, histogram driver average luma of the ae window
+// - af.sharpness, filtered edge sum of the af window, mt9d112 has no focus, 0
+
+  if (mt9d111) {
+    writeReg111 (0xF0, 1); // page 1
+    *luma = readVar (0xA21D);
+    *sharpness = readVar (0x2510);
+    }
   else {
-    if (value) {
-      line2 ("cam AE 6500");
-      // sequencer.mode - 5:0 - 6500K:AF:histogram:AWB:flicker:AE
-      writeReg112 (0x338C, 0xA102); writeReg112 (0x3390, 0x21);
-      }
-    else  {
-      line2 ("cam none");
-      writeReg112 (0x338C, 0xA102); writeReg112 (0x3390, 0);
-      }
+    *luma = readVar (0xA21D);
+    *sharpness = 0;
     }
   }
 //}}}
 //{{{
+void sensorAutoExposure (int enable) {
+// sensor mcu ae, sequencer.mode bit 0, off holds exposure for sensorExposure
+
+  if (mt9d111)
+    writeReg111 (0xF0, 1); // page 1
+
+  uint16_t mode = readVar (0xA102);
+  writeVar (0xA102, enable ? (mode | 0x01) : (mode & ~0x01));
+  }
+//}}}
+//{{{
+int sensorExposure (uint32_t exposure) {
+// exposure in 100us units, mt9d111 shutter width R0x09:0 in 53.772us rows, returns 0 if not supported
+
+  if (mt9d111) {
+    uint32_t rows = (exposure * 100000) / 53772;
+    if (rows < 1)
+      rows = 1;
+    if (rows > 0xFFFF)
+      rows = 0xFFFF;
+
+    writeReg111 (0xF0, 0); // page 0
+    writeReg111 (0x09, rows);
+    writeReg111 (0xF0, 1); // page 1
+    return 1;
+    }
+
+  return 0;
+  }
+//}}}
+//{{{
+void sensorButton (int value) {
+// button down sets sequencer AE and 6500K, up clears them, other sequencer.mode bits left as they are
+
+  if (mt9d111)
+    writeReg111 (0xF0, 1); // page 1
+
+  line2 (value ? "cam AE 6500" : "cam none");
+
+  // sequencer.mode - 5:0 - 6500K:AF:histogram:AWB:flicker:AE
+  uint16_t mode = readVar (0xA102);
+  writeVar (0xA102, value ? (mode | 0x21) : (mode & ~0x21));
+
+  if (mt9d111)
+    CyU3PThreadSleep (20);
+  }
+//}}}
+//{{{
 void sensorFocus (int value) {
 
   if (mt9d111) {
     writeReg111 (0xF0, 1);
 
     if (value <= 1) {
-      writeReg111 (0xC6, 0x9071); writeReg111 (0xC8, 0x00); // SFR GPIO data b1:0 = 0 - disable GPIO1
-      writeReg111 (0xC6, 0x9081); writeReg111 (0xC8, 255);  // SFR GPIO wg_t00 = 255 initial off
-      writeReg111 (0xC6, 0x9083); writeReg111 (0xC8, 0);    // SFR GPIO wg_t10 = 0 no on
+      writeVar (0x9071, 0x00); // SFR GPIO data b1:0 = 0 - disable GPIO1
+      writeVar (0x9081, 255);  // SFR GPIO wg_t00 = 255 initial off
+      writeVar (0x9083, 0);    // SFR GPIO wg_t10 = 0 no on
       }
 
     else {
       if (value > 254)
         value = 254;
 
-      writeReg111 (0xF0, 1);
-      writeReg111 (0xC6, 0x9071); writeReg111 (0xC8, 0x02);        // SFR GPIO data b1:0 = enable GPIO1
-      writeReg111 (0xC6, 0x9081); writeReg111 (0xC8, 255 - value); // SFR GPIO wg_t00 pwm off
-      writeReg111 (0xC6, 0x9083); writeReg111 (0xC8, value);       // SFR GPIO wg_t10 pwm on
+      writeVar (0x9071, 0x02);        // SFR GPIO data b1:0 = enable GPIO1
+      writeVar (0x9081, 255 - value); // SFR GPIO wg_t00 pwm off
+      writeVar (0x9083, value);       // SFR GPIO wg_t10 pwm on
       }
     }
   }
 //}}}
 
 //{{{
-void sensorInit111() {
-
+static const sensorReg_t init111[] = {
   //  soft reset
-  writeReg111 (0x65, 0xA000); // Bypass the PLL, R0x65:0 = 0xA000,
-  writeReg111 (0xF0, 1); // page 1
-  writeReg111 (0xC3, 0x0501); // Perform MCU reset by setting R0xC3:1 = 0x0501.
-  writeReg111 (0xF0, 0); // page 0
-  writeReg111 (0x0D, 0x0021); // Enable soft reset by setting R0x0D:0 = 0x0021. Bit 0 is used for the sensor core reset
-  writeReg111 (0x0D, 0x0000); // Disable soft reset by setting R0x0D:0 = 0x0000.
-  CyU3PThreadSleep (100);
-
-  writeReg111 (0x05, 0x0243); // HBLANK B
-  writeReg111 (0x06, 0x000b); // VBLANK B
-  writeReg111 (0x07, 0x010d); // HBLANK A
-  writeReg111 (0x08, 0x000b); // VBLANK A
-  writeReg111 (0x20, 0x0300); // Read Mode B = 9:showBorder 8:overSized
-  writeReg111 (0x21, 0x8400); // Read Mode A = 15:binning 10:bothADC
+  { 0x65, 0xA000 }, // Bypass the PLL, R0x65:0 = 0xA000,
+  { 0xF0, 1 }, // page 1
+  { 0xC3, 0x0501 }, // Perform MCU reset by setting R0xC3:1 = 0x0501.
+  { 0xF0, 0 }, // page 0
+  { 0x0D, 0x0021 }, // Enable soft reset by setting R0x0D:0 = 0x0021. Bit 0 is used for the sensor core reset
+  { 0x0D, 0x0000 }, // Disable soft reset by setting R0x0D:0 = 0x0000.
+  { SENSOR_SLEEP, 100 },
+
+  { 0x05, 0x0243 }, // HBLANK B
+  { 0x06, 0x000b }, // VBLANK B
+  { 0x07, 0x010d }, // HBLANK A
+  { 0x08, 0x000b }, // VBLANK A
+  { 0x20, 0x0300 }, // Read Mode B = 9:showBorder 8:overSized
+  { 0x21, 0x8400 }, // Read Mode A = 15:binning 10:bothADC
 
   //  PLL
-  writeReg111 (0x66, 0x1402);  // PLL Control 1    M:N - M=20, N=2 P=0 (24mhz/(N+1))*M / 2*(P+1) = 80mhz
-  writeReg111 (0x67, 0x0500);  // PLL Control 2 0x05:P
-  writeReg111 (0x65, 0xA000);  // Clock CNTRL - PLL ON
-  writeReg111 (0x65, 0x2000);  // Clock CNTRL - USE PLL
-  CyU3PThreadSleep (100);
+  { 0x66, 0x1402 },  // PLL Control 1    M:N - M=20, N=2 P=0 (24mhz/(N+1))*M / 2*(P+1) = 80mhz
+  { 0x67, 0x0500 },  // PLL Control 2 0x05:P
+  { 0x65, 0xA000 },  // Clock CNTRL - PLL ON
+  { 0x65, 0x2000 },  // Clock CNTRL - USE PLL
+  { SENSOR_SLEEP, 100 },
 
   // page 1
-  writeReg111 (0xF0, 1);
-  writeReg111 (0x97, 0x0002); // output format configuration luma:chroma swap
+  { 0xF0, 1 },
+  { 0x97, 0x0002 }, // output format configuration luma:chroma swap
   //{{{  mode a,b params
-  writeReg111 (0xC6, 0x270B); writeReg111 (0xC8, 0x0030); // mode_config = disable jpeg A,B
+  { 0xC6, 0x270B }, { 0xC8, 0x0030 }, // mode_config = disable jpeg A,B
 
   //{{{  [MODE A PARAMETERS]
   /*
@@ -288,20 +711,20 @@ void sensorInit111() {
   ; 60Hz Flicker Period: 154.97 lines
   */
   //}}}
-  writeReg111 (0xC6, 0x2703); writeReg111 (0xC8, 800);    // Output Width A  = 800
-  writeReg111 (0xC6, 0x2705); writeReg111 (0xC8, 600);    // Output Height A = 600
-  writeReg111 (0xC6, 0x270F); writeReg111 (0xC8, 0x001C); // Row Start A = 28
-  writeReg111 (0xC6, 0x2711); writeReg111 (0xC8, 0x003C); // Column Start A = 60
-  writeReg111 (0xC6, 0x2713); writeReg111 (0xC8, 1200);   // Row Height A = 1200
-  writeReg111 (0xC6, 0x2715); writeReg111 (0xC8, 1600);   // Column Width A = 1600
-  writeReg111 (0xC6, 0x2717); writeReg111 (0xC8, 0x0003); // Extra Delay A
-  writeReg111 (0xC6, 0x2719); writeReg111 (0xC8, 0x0011); // Row Speed A
-  writeReg111 (0xC6, 0x2727); writeReg111 (0xC8, 0);      // Crop_X0 A = 0
-  writeReg111 (0xC6, 0x2729); writeReg111 (0xC8, 800);    // Crop_X1 A = 800
-  writeReg111 (0xC6, 0x272B); writeReg111 (0xC8, 0);      // Crop_Y0 A = 0
-  writeReg111 (0xC6, 0x272D); writeReg111 (0xC8, 600);    // Crop_Y1 A = 600
-  writeReg111 (0xC6, 0xA743); writeReg111 (0xC8, 0x02);   // Gamma and Contrast Settings A
-  writeReg111 (0xC6, 0xA77D); writeReg111 (0xC8, 0x02);   // output format config A = 0x02 swap luma:chroma
+  { 0xC6, 0x2703 }, { 0xC8, 800 },    // Output Width A  = 800
+  { 0xC6, 0x2705 }, { 0xC8, 600 },    // Output Height A = 600
+  { 0xC6, 0x270F }, { 0xC8, 0x001C }, // Row Start A = 28
+  { 0xC6, 0x2711 }, { 0xC8, 0x003C }, // Column Start A = 60
+  { 0xC6, 0x2713 }, { 0xC8, 1200 },   // Row Height A = 1200
+  { 0xC6, 0x2715 }, { 0xC8, 1600 },   // Column Width A = 1600
+  { 0xC6, 0x2717 }, { 0xC8, 0x0003 }, // Extra Delay A
+  { 0xC6, 0x2719 }, { 0xC8, 0x0011 }, // Row Speed A
+  { 0xC6, 0x2727 }, { 0xC8, 0 },      // Crop_X0 A = 0
+  { 0xC6, 0x2729 }, { 0xC8, 800 },    // Crop_X1 A = 800
+  { 0xC6, 0x272B }, { 0xC8, 0 },      // Crop_Y0 A = 0
+  { 0xC6, 0x272D }, { 0xC8, 600 },    // Crop_Y1 A = 600
+  { 0xC6, 0xA743 }, { 0xC8, 0x02 },   // Gamma and Contrast Settings A
+  { 0xC6, 0xA77D }, { 0xC8, 0x02 },   // output format config A = 0x02 swap luma:chroma
 
   //{{{  [MODE B PARAMETERS]
   /*
@@ -325,430 +748,455 @@ void sensorInit111() {
   ; 60Hz Flicker Period: 154.97 lines
   */
   //}}}
-  writeReg111 (0xC6, 0x2707); writeReg111 (0xC8, 1600);   // Output Width B  = 1600
-  writeReg111 (0xC6, 0x2709); writeReg111 (0xC8, 1200);   // Output Height B = 1200
-  writeReg111 (0xC6, 0x271B); writeReg111 (0xC8, 0x001C); // Row Start B = 28
-  writeReg111 (0xC6, 0x271D); writeReg111 (0xC8, 0x003C); // Column Start B = 60
-  writeReg111 (0xC6, 0x271F); writeReg111 (0xC8, 1200);   // Row Height B = 1200
-  writeReg111 (0xC6, 0x2721); writeReg111 (0xC8, 1600);   // Column Width B = 1600
-  writeReg111 (0xC6, 0x2723); writeReg111 (0xC8, 0x02C9); // Extra Delay B
-  writeReg111 (0xC6, 0x2725); writeReg111 (0xC8, 0x0011); // Row Speed B
-  writeReg111 (0xC6, 0x2735); writeReg111 (0xC8, 0);      // Crop_X0 B = 0
-  writeReg111 (0xC6, 0x2737); writeReg111 (0xC8, 1600);   // Crop_X1 B = 1600
-  writeReg111 (0xC6, 0x2739); writeReg111 (0xC8, 0);      // Crop_Y0 B = 0
-  writeReg111 (0xC6, 0x273B); writeReg111 (0xC8, 1200);   // Crop_Y1 B = 1200
-  writeReg111 (0xC6, 0xA744); writeReg111 (0xC8, 0x02);   // Gamma and Contrast Settings B
-  writeReg111 (0xC6, 0xA77E); writeReg111 (0xC8, 0x02);   // output format config B = 0x02 swap luma:chroma
+  { 0xC6, 0x2707 }, { 0xC8, 1600 },   // Output Width B  = 1600
+  { 0xC6, 0x2709 }, { 0xC8, 1200 },   // Output Height B = 1200
+  { 0xC6, 0x271B }, { 0xC8, 0x001C }, // Row Start B = 28
+  { 0xC6, 0x271D }, { 0xC8, 0x003C }, // Column Start B = 60
+  { 0xC6, 0x271F }, { 0xC8, 1200 },   // Row Height B = 1200
+  { 0xC6, 0x2721 }, { 0xC8, 1600 },   // Column Width B = 1600
+  { 0xC6, 0x2723 }, { 0xC8, 0x02C9 }, // Extra Delay B
+  { 0xC6, 0x2725 }, { 0xC8, 0x0011 }, // Row Speed B
+  { 0xC6, 0x2735 }, { 0xC8, 0 },      // Crop_X0 B = 0
+  { 0xC6, 0x2737 }, { 0xC8, 1600 },   // Crop_X1 B = 1600
+  { 0xC6, 0x2739 }, { 0xC8, 0 },      // Crop_Y0 B = 0
+  { 0xC6, 0x273B }, { 0xC8, 1200 },   // Crop_Y1 B = 1200
+  { 0xC6, 0xA744 }, { 0xC8, 0x02 },   // Gamma and Contrast Settings B
+  { 0xC6, 0xA77E }, { 0xC8, 0x02 },   // output format config B = 0x02 swap luma:chroma
 
   //other config
-  writeReg111 (0xC6, 0x276D); writeReg111 (0xC8, 0xE0E2); // FIFO_Conf1 A = 57570
-  writeReg111 (0xC6, 0xA76F); writeReg111 (0xC8, 0xE1);   // FIFO_Conf2 A = 225
-  writeReg111 (0xC6, 0x2774); writeReg111 (0xC8, 0xE0E1); // FIFO_Conf1 B = 57569
-  writeReg111 (0xC6, 0xA776); writeReg111 (0xC8, 0xE1);   // FIFO_Conf2 B = 225
-
-  writeReg111 (0xC6, 0xA217); writeReg111 (0xC8, 0x08);   // IndexTH23 = 8
-
-  writeReg111 (0xC6, 0x220B); writeReg111 (0xC8, 0x01B0); // Max R12 B (Shutter Delay)
-  writeReg111 (0xC6, 0x2228); writeReg111 (0xC8, 0x0216); // RowTime (msclk per)/4
-  writeReg111 (0xC6, 0x222F); writeReg111 (0xC8, 0x009A); // R9 Step = 94
-  writeReg111 (0xC6, 0xA408); writeReg111 (0xC8, 0x24);   // search_f1_50 = 21
-  writeReg111 (0xC6, 0xA409); writeReg111 (0xC8, 0x26);   // search_f2_50 = 23
-  writeReg111 (0xC6, 0xA40A); writeReg111 (0xC8, 0x1D);   // search_f1_60 = 17
-  writeReg111 (0xC6, 0xA40B); writeReg111 (0xC8, 0x1F);   // search_f2_60 = 19
-  writeReg111 (0xC6, 0x2411); writeReg111 (0xC8, 0x009A); // R9_Step_60 = 94
-  writeReg111 (0xC6, 0x2413); writeReg111 (0xC8, 0x00B9); // R9_Step_50 = 112
+  { 0xC6, 0x276D }, { 0xC8, 0xE0E2 }, // FIFO_Conf1 A = 57570
+  { 0xC6, 0xA76F }, { 0xC8, 0xE1 },   // FIFO_Conf2 A = 225
+  { 0xC6, 0x2774 }, { 0xC8, 0xE0E1 }, // FIFO_Conf1 B = 57569
+  { 0xC6, 0xA776 }, { 0xC8, 0xE1 },   // FIFO_Conf2 B = 225
+
+  { 0xC6, 0xA217 }, { 0xC8, 0x08 },   // IndexTH23 = 8
+
+  { 0xC6, 0x220B }, { 0xC8, 0x01B0 }, // Max R12 B (Shutter Delay)
+  { 0xC6, 0x2228 }, { 0xC8, 0x0216 }, // RowTime (msclk per)/4
+  { 0xC6, 0x222F }, { 0xC8, 0x009A }, // R9 Step = 94
+  { 0xC6, 0xA408 }, { 0xC8, 0x24 },   // search_f1_50 = 21
+  { 0xC6, 0xA409 }, { 0xC8, 0x26 },   // search_f2_50 = 23
+  { 0xC6, 0xA40A }, { 0xC8, 0x1D },   // search_f1_60 = 17
+  { 0xC6, 0xA40B }, { 0xC8, 0x1F },   // search_f2_60 = 19
+  { 0xC6, 0x2411 }, { 0xC8, 0x009A }, // R9_Step_60 = 94
+  { 0xC6, 0x2413 }, { 0xC8, 0x00B9 }, // R9_Step_50 = 112
   //}}}
   //{{{  sequencer
-  writeReg111 (0xC6, 0xA122); writeReg111 (0xC8, 0x01); // Enter Preview: Auto Exposure = 1
-  writeReg111 (0xC6, 0xA123); writeReg111 (0xC8, 0x00); // Enter Preview: Flicker Detection = 0
-  writeReg111 (0xC6, 0xA124); writeReg111 (0xC8, 0x01); // Enter Preview: Auto White Balance = 1
-  writeReg111 (0xC6, 0xA125); writeReg111 (0xC8, 0x00); // Enter Preview: Auto Focus = 0
-  writeReg111 (0xC6, 0xA126); writeReg111 (0xC8, 0x01); // Enter Preview: Histogram = 1
-  writeReg111 (0xC6, 0xA127); writeReg111 (0xC8, 0x00); // Enter Preview: Strobe Control  = 0
-  writeReg111 (0xC6, 0xA128); writeReg111 (0xC8, 0x00); // Enter Preview: Skip Control = 0
-
-  writeReg111 (0xC6, 0xA129); writeReg111 (0xC8, 0x03); // In Preview: Auto Exposure = 3
-  writeReg111 (0xC6, 0xA12A); writeReg111 (0xC8, 0x02); // In Preview: Flicker Detection = 2
-  writeReg111 (0xC6, 0xA12B); writeReg111 (0xC8, 0x03); // In Preview: Auto White Balance = 3
-  writeReg111 (0xC6, 0xA12C); writeReg111 (0xC8, 0x00); // In Preview: Auto Focus = 0
-  writeReg111 (0xC6, 0xA12D); writeReg111 (0xC8, 0x03); // In Preview: Histogram  = 3
-  writeReg111 (0xC6, 0xA12E); writeReg111 (0xC8, 0x00); // In Preview: Strobe Control = 0
-  writeReg111 (0xC6, 0xA12F); writeReg111 (0xC8, 0x00); // In Preview: Skip Control = 0
-
-  writeReg111 (0xC6, 0xA130); writeReg111 (0xC8, 0x04); // Exit Preview: Auto Exposure = 4
-  writeReg111 (0xC6, 0xA131); writeReg111 (0xC8, 0x00); // Exit Preview: Flicker Detection = 0
-  writeReg111 (0xC6, 0xA132); writeReg111 (0xC8, 0x01); // Exit Preview: Auto White Balance = 1
-  writeReg111 (0xC6, 0xA133); writeReg111 (0xC8, 0x00); // Exit Preview: Auto Focus = 0
-  writeReg111 (0xC6, 0xA134); writeReg111 (0xC8, 0x01); // Exit Preview: Histogram = 1
-  writeReg111 (0xC6, 0xA135); writeReg111 (0xC8, 0x00); // Exit Preview: Strobe Control = 0
-  writeReg111 (0xC6, 0xA136); writeReg111 (0xC8, 0x00); // Exit Preview: Skip Control = 0
-
-  writeReg111 (0xC6, 0xA137); writeReg111 (0xC8, 0x00); // Capture: Auto Exposure = 0
-  writeReg111 (0xC6, 0xA138); writeReg111 (0xC8, 0x00); // Capture: Flicker Detection = 0
-  writeReg111 (0xC6, 0xA139); writeReg111 (0xC8, 0x00); // Capture: Auto White Balance  = 0
-  writeReg111 (0xC6, 0xA13A); writeReg111 (0xC8, 0x00); // Capture: Auto Focus = 0
-  writeReg111 (0xC6, 0xA13B); writeReg111 (0xC8, 0x00); // Capture: Histogram = 0
-  writeReg111 (0xC6, 0xA13C); writeReg111 (0xC8, 0x00); // Capture: Strobe Control = 0
-  writeReg111 (0xC6, 0xA13D); writeReg111 (0xC8, 0x00); // Capture: Skip Control = 0
+  { 0xC6, 0xA122 }, { 0xC8, 0x01 }, // Enter Preview: Auto Exposure = 1
+  { 0xC6, 0xA123 }, { 0xC8, 0x00 }, // Enter Preview: Flicker Detection = 0
+  { 0xC6, 0xA124 }, { 0xC8, 0x01 }, // Enter Preview: Auto White Balance = 1
+  { 0xC6, 0xA125 }, { 0xC8, 0x00 }, // Enter Preview: Auto Focus = 0
+  { 0xC6, 0xA126 }, { 0xC8, 0x01 }, // Enter Preview: Histogram = 1
+  { 0xC6, 0xA127 }, { 0xC8, 0x00 }, // Enter Preview: Strobe Control  = 0
+  { 0xC6, 0xA128 }, { 0xC8, 0x00 }, // Enter Preview: Skip Control = 0
+
+  { 0xC6, 0xA129 }, { 0xC8, 0x03 }, // In Preview: Auto Exposure = 3
+  { 0xC6, 0xA12A }, { 0xC8, 0x02 }, // In Preview: Flicker Detection = 2
+  { 0xC6, 0xA12B }, { 0xC8, 0x03 }, // In Preview: Auto White Balance = 3
+  { 0xC6, 0xA12C }, { 0xC8, 0x00 }, // In Preview: Auto Focus = 0
+  { 0xC6, 0xA12D }, { 0xC8, 0x03 }, // In Preview: Histogram  = 3
+  { 0xC6, 0xA12E }, { 0xC8, 0x00 }, // In Preview: Strobe Control = 0
+  { 0xC6, 0xA12F }, { 0xC8, 0x00 }, // In Preview: Skip Control = 0
+
+  { 0xC6, 0xA130 }, { 0xC8, 0x04 }, // Exit Preview: Auto Exposure = 4
+  { 0xC6, 0xA131 }, { 0xC8, 0x00 }, // Exit Preview: Flicker Detection = 0
+  { 0xC6, 0xA132 }, { 0xC8, 0x01 }, // Exit Preview: Auto White Balance = 1
+  { 0xC6, 0xA133 }, { 0xC8, 0x00 }, // Exit Preview: Auto Focus = 0
+  { 0xC6, 0xA134 }, { 0xC8, 0x01 }, // Exit Preview: Histogram = 1
+  { 0xC6, 0xA135 }, { 0xC8, 0x00 }, // Exit Preview: Strobe Control = 0
+  { 0xC6, 0xA136 }, { 0xC8, 0x00 }, // Exit Preview: Skip Control = 0
+
+  { 0xC6, 0xA137 }, { 0xC8, 0x00 }, // Capture: Auto Exposure = 0
+  { 0xC6, 0xA138 }, { 0xC8, 0x00 }, // Capture: Flicker Detection = 0
+  { 0xC6, 0xA139 }, { 0xC8, 0x00 }, // Capture: Auto White Balance  = 0
+  { 0xC6, 0xA13A }, { 0xC8, 0x00 }, // Capture: Auto Focus = 0
+  { 0xC6, 0xA13B }, { 0xC8, 0x00 }, // Capture: Histogram = 0
+  { 0xC6, 0xA13C }, { 0xC8, 0x00 }, // Capture: Strobe Control = 0
+  { 0xC6, 0xA13D }, { 0xC8, 0x00 }, // Capture: Skip Control = 0
   //}}}
   //{{{  Custom gamma tables...
-  writeReg111 (0xC6, 0xA745);    //Gamma Table 0 A
-  writeReg111 (0xC8, 0x00);  //      = 0
-  writeReg111 (0xC6, 0xA746);    //Gamma Table 1 A
-  writeReg111 (0xC8, 0x14);  //      = 20
-  writeReg111 (0xC6, 0xA747);    //Gamma Table 2 A
-  writeReg111 (0xC8, 0x23);  //      = 35
-  writeReg111 (0xC6, 0xA748);    //Gamma Table 3 A
-  writeReg111 (0xC8, 0x3A);  //      = 58
-  writeReg111 (0xC6, 0xA749);    //Gamma Table 4 A
-  writeReg111 (0xC8, 0x5E);  //      = 94
-  writeReg111 (0xC6, 0xA74A);    //Gamma Table 5 A
-  writeReg111 (0xC8, 0x76);  //      = 118
-  writeReg111 (0xC6, 0xA74B);    //Gamma Table 6 A
-  writeReg111 (0xC8, 0x88);  //      = 136
-  writeReg111 (0xC6, 0xA74C);    //Gamma Table 7 A
-  writeReg111 (0xC8, 0x96);  //      = 150
-  writeReg111 (0xC6, 0xA74D);    //Gamma Table 8 A
-  writeReg111 (0xC8, 0xA3);  //      = 163
-  writeReg111 (0xC6, 0xA74E);    //Gamma Table 9 A
-  writeReg111 (0xC8, 0xAF);  //      = 175
-  writeReg111 (0xC6, 0xA74F);    //Gamma Table 10 A
-  writeReg111 (0xC8, 0xBA);  //      = 186
-  writeReg111 (0xC6, 0xA750);    //Gamma Table 11 A
-  writeReg111 (0xC8, 0xC4);  //      = 196
-  writeReg111 (0xC6, 0xA751);    //Gamma Table 12 A
-  writeReg111 (0xC8, 0xCE);  //      = 206
-  writeReg111 (0xC6, 0xA752);    //Gamma Table 13 A
-  writeReg111 (0xC8, 0xD7);  //      = 215
-  writeReg111 (0xC6, 0xA753);    //Gamma Table 14 A
-  writeReg111 (0xC8, 0xE0);  //      = 224
-  writeReg111 (0xC6, 0xA754);    //Gamma Table 15 A
-  writeReg111 (0xC8, 0xE8);  //      = 232
-  writeReg111 (0xC6, 0xA755);    //Gamma Table 16 A
-  writeReg111 (0xC8, 0xF0);  //      = 240
-  writeReg111 (0xC6, 0xA756);    //Gamma Table 17 A
-  writeReg111 (0xC8, 0xF8);  //      = 248
-  writeReg111 (0xC6, 0xA757);    //Gamma Table 18 A
-  writeReg111 (0xC8, 0xFF);  //      = 255
-  writeReg111 (0xC6, 0xA758);    //Gamma Table 0 B
-  writeReg111 (0xC8, 0x00);  //      = 0
-  writeReg111 (0xC6, 0xA759);    //Gamma Table 1 B
-  writeReg111 (0xC8, 0x14);  //      = 20
-  writeReg111 (0xC6, 0xA75A);    //Gamma Table 2 B
-  writeReg111 (0xC8, 0x23);  //      = 35
-  writeReg111 (0xC6, 0xA75B);    //Gamma Table 3 B
-  writeReg111 (0xC8, 0x3A);  //      = 58
-  writeReg111 (0xC6, 0xA75C);    //Gamma Table 4 B
-  writeReg111 (0xC8, 0x5E);  //      = 94
-  writeReg111 (0xC6, 0xA75D);    //Gamma Table 5 B
-  writeReg111 (0xC8, 0x76);  //      = 118
-  writeReg111 (0xC6, 0xA75E);    //Gamma Table 6 B
-  writeReg111 (0xC8, 0x88);  //      = 136
-  writeReg111 (0xC6, 0xA75F);    //Gamma Table 7 B
-  writeReg111 (0xC8, 0x96);  //      = 150
-  writeReg111 (0xC6, 0xA760);    //Gamma Table 8 B
-  writeReg111 (0xC8, 0xA3);  //      = 163
-  writeReg111 (0xC6, 0xA761);    //Gamma Table 9 B
-  writeReg111 (0xC8, 0xAF);  //      = 175
-  writeReg111 (0xC6, 0xA762);    //Gamma Table 10 B
-  writeReg111 (0xC8, 0xBA);  //      = 186
-  writeReg111 (0xC6, 0xA763);    //Gamma Table 11 B
-  writeReg111 (0xC8, 0xC4);  //      = 196
-  writeReg111 (0xC6, 0xA764);    //Gamma Table 12 B
-  writeReg111 (0xC8, 0xCE);  //      = 206
-  writeReg111 (0xC6, 0xA765);    //Gamma Table 13 B
-  writeReg111 (0xC8, 0xD7);  //      = 215
-  writeReg111 (0xC6, 0xA766);    //Gamma Table 14 B
-  writeReg111 (0xC8, 0xE0);  //      = 224
-  writeReg111 (0xC6, 0xA767);    //Gamma Table 15 B
-  writeReg111 (0xC8, 0xE8);  //      = 232
-  writeReg111 (0xC6, 0xA768);    //Gamma Table 16 B
-  writeReg111 (0xC8, 0xF0);  //      = 240
-  writeReg111 (0xC6, 0xA769);    //Gamma Table 17 B
-  writeReg111 (0xC8, 0xF8);  //      = 248
-  writeReg111 (0xC6, 0xA76A);    //Gamma Table 18 B
-  writeReg111 (0xC8, 0xFF);  //      = 255
+  { 0xC6, 0xA745 },    //Gamma Table 0 A
+  { 0xC8, 0x00 },  //      = 0
+  { 0xC6, 0xA746 },    //Gamma Table 1 A
+  { 0xC8, 0x14 },  //      = 20
+  { 0xC6, 0xA747 },    //Gamma Table 2 A
+  { 0xC8, 0x23 },  //      = 35
+  { 0xC6, 0xA748 },    //Gamma Table 3 A
+  { 0xC8, 0x3A },  //      = 58
+  { 0xC6, 0xA749 },    //Gamma Table 4 A
+  { 0xC8, 0x5E },  //      = 94
+  { 0xC6, 0xA74A },    //Gamma Table 5 A
+  { 0xC8, 0x76 },  //      = 118
+  { 0xC6, 0xA74B },    //Gamma Table 6 A
+  { 0xC8, 0x88 },  //      = 136
+  { 0xC6, 0xA74C },    //Gamma Table 7 A
+  { 0xC8, 0x96 },  //      = 150
+  { 0xC6, 0xA74D },    //Gamma Table 8 A
+  { 0xC8, 0xA3 },  //      = 163
+  { 0xC6, 0xA74E },    //Gamma Table 9 A
+  { 0xC8, 0xAF },  //      = 175
+  { 0xC6, 0xA74F },    //Gamma Table 10 A
+  { 0xC8, 0xBA },  //      = 186
+  { 0xC6, 0xA750 },    //Gamma Table 11 A
+  { 0xC8, 0xC4 },  //      = 196
+  { 0xC6, 0xA751 },    //Gamma Table 12 A
+  { 0xC8, 0xCE },  //      = 206
+  { 0xC6, 0xA752 },    //Gamma Table 13 A
+  { 0xC8, 0xD7 },  //      = 215
+  { 0xC6, 0xA753 },    //Gamma Table 14 A
+  { 0xC8, 0xE0 },  //      = 224
+  { 0xC6, 0xA754 },    //Gamma Table 15 A
+  { 0xC8, 0xE8 },  //      = 232
+  { 0xC6, 0xA755 },    //Gamma Table 16 A
+  { 0xC8, 0xF0 },  //      = 240
+  { 0xC6, 0xA756 },    //Gamma Table 17 A
+  { 0xC8, 0xF8 },  //      = 248
+  { 0xC6, 0xA757 },    //Gamma Table 18 A
+  { 0xC8, 0xFF },  //      = 255
+  { 0xC6, 0xA758 },    //Gamma Table 0 B
+  { 0xC8, 0x00 },  //      = 0
+  { 0xC6, 0xA759 },    //Gamma Table 1 B
+  { 0xC8, 0x14 },  //      = 20
+  { 0xC6, 0xA75A },    //Gamma Table 2 B
+  { 0xC8, 0x23 },  //      = 35
+  { 0xC6, 0xA75B },    //Gamma Table 3 B
+  { 0xC8, 0x3A },  //      = 58
+  { 0xC6, 0xA75C },    //Gamma Table 4 B
+  { 0xC8, 0x5E },  //      = 94
+  { 0xC6, 0xA75D },    //Gamma Table 5 B
+  { 0xC8, 0x76 },  //      = 118
+  { 0xC6, 0xA75E },    //Gamma Table 6 B
+  { 0xC8, 0x88 },  //      = 136
+  { 0xC6, 0xA75F },    //Gamma Table 7 B
+  { 0xC8, 0x96 },  //      = 150
+  { 0xC6, 0xA760 },    //Gamma Table 8 B
+  { 0xC8, 0xA3 },  //      = 163
+  { 0xC6, 0xA761 },    //Gamma Table 9 B
+  { 0xC8, 0xAF },  //      = 175
+  { 0xC6, 0xA762 },    //Gamma Table 10 B
+  { 0xC8, 0xBA },  //      = 186
+  { 0xC6, 0xA763 },    //Gamma Table 11 B
+  { 0xC8, 0xC4 },  //      = 196
+  { 0xC6, 0xA764 },    //Gamma Table 12 B
+  { 0xC8, 0xCE },  //      = 206
+  { 0xC6, 0xA765 },    //Gamma Table 13 B
+  { 0xC8, 0xD7 },  //      = 215
+  { 0xC6, 0xA766 },    //Gamma Table 14 B
+  { 0xC8, 0xE0 },  //      = 224
+  { 0xC6, 0xA767 },    //Gamma Table 15 B
+  { 0xC8, 0xE8 },  //      = 232
+  { 0xC6, 0xA768 },    //Gamma Table 16 B
+  { 0xC8, 0xF0 },  //      = 240
+  { 0xC6, 0xA769 },    //Gamma Table 17 B
+  { 0xC8, 0xF8 },  //      = 248
+  { 0xC6, 0xA76A },    //Gamma Table 18 B
+  { 0xC8, 0xFF },  //      = 255
   //}}}
-  CyU3PThreadSleep (100);
+  { SENSOR_SEQ_WAIT, 500 },
 
-  writeReg111 (0xC6, 0xA103); writeReg111 (0xC8, 0x06); // Sequencer Refresh Mode
-  CyU3PThreadSleep (200);
+  { 0xC6, 0xA103 }, { 0xC8, 0x06 }, // Sequencer Refresh Mode
+  { SENSOR_SEQ_WAIT, 500 },
 
-  writeReg111 (0xC6, 0xA103); writeReg111 (0xC8, 0x05); // Sequencer Refresh
-  CyU3PThreadSleep (200);
+  { 0xC6, 0xA103 }, { 0xC8, 0x05 }, // Sequencer Refresh
+  { SENSOR_SEQ_WAIT, 500 },
 
   //{{{  focus init
-  writeReg111 (0xC6, 0x90B6); writeReg111 (0xC8, 0x01); // SFR GPIO suspend
+  { 0xC6, 0x90B6 }, { 0xC8, 0x01 }, // SFR GPIO suspend
 
   // enable GPIO0,1 as output, initial value 0
-  writeReg111 (0xC6, 0x9079); writeReg111 (0xC8, 0xFC); // SFR GPIO data direction
-  writeReg111 (0xC6, 0x9071); writeReg111 (0xC8, 0x00); // SFR GPIO data b1:0 = 0 GPIO0,1 initial 0
+  { 0xC6, 0x9079 }, { 0xC8, 0xFC }, // SFR GPIO data direction
+  { 0xC6, 0x9071 }, { 0xC8, 0x00 }, // SFR GPIO data b1:0 = 0 GPIO0,1 initial 0
 
   // use 8bit counter clkdiv 2^(1+2)=8 -> 48mhz -> 6mhz ->> 23.7khz
-  writeReg111 (0xC6, 0x90B0); writeReg111 (0xC8, 0x01); // SFR GPIO wg_config b0 = 1 8bit counter
-  writeReg111 (0xC6, 0x90B2); writeReg111 (0xC8, 0x02); // SFR GPIO wg_clkdiv b0 = 2
+  { 0xC6, 0x90B0 }, { 0xC8, 0x01 }, // SFR GPIO wg_config b0 = 1 8bit counter
+  { 0xC6, 0x90B2 }, { 0xC8, 0x02 }, // SFR GPIO wg_clkdiv b0 = 2
 
   // GPIO0
-  writeReg111 (0xC6, 0x908B); writeReg111 (0xC8, 0x00); // SFR GPIO wg_n0 = 0 infinite
-  writeReg111 (0xC6, 0x9081); writeReg111 (0xC8, 255);  // SFR GPIO wg_t00 = 255 initial off
-  writeReg111 (0xC6, 0x9083); writeReg111 (0xC8, 0);    // SFR GPIO wg_t10 = 0 no on
+  { 0xC6, 0x908B }, { 0xC8, 0x00 }, // SFR GPIO wg_n0 = 0 infinite
+  { 0xC6, 0x9081 }, { 0xC8, 255 },  // SFR GPIO wg_t00 = 255 initial off
+  { 0xC6, 0x9083 }, { 0xC8, 0 },    // SFR GPIO wg_t10 = 0 no on
 
   // GPIO1
-  writeReg111 (0xC6, 0x908A); writeReg111 (0xC8, 0x00); // SFR GPIO wg_n1 = 0 infinite
-  writeReg111 (0xC6, 0x9080); writeReg111 (0xC8, 0xFF); // SFR GPIO wg_t01 = 255 max initial on
-  writeReg111 (0xC6, 0x9082); writeReg111 (0xC8, 0x00); // SFR GPIO wg_t11 = 0 no off
+  { 0xC6, 0x908A }, { 0xC8, 0x00 }, // SFR GPIO wg_n1 = 0 infinite
+  { 0xC6, 0x9080 }, { 0xC8, 0xFF }, // SFR GPIO wg_t01 = 255 max initial on
+  { 0xC6, 0x9082 }, { 0xC8, 0x00 }, // SFR GPIO wg_t11 = 0 no off
 
-  writeReg111 (0xC6, 0x90B5); writeReg111 (0xC8, 0x00); // SFR GPIO reset
-  writeReg111 (0xC6, 0x90B6); writeReg111 (0xC8, 0x00); // SFR GPIO suspend
+  { 0xC6, 0x90B5 }, { 0xC8, 0x00 }, // SFR GPIO reset
+  { 0xC6, 0x90B6 }, { 0xC8, 0x00 }, // SFR GPIO suspend
   //}}}
+  };
+//}}}
+//{{{
+static void sensorInit111() {
+
+  sensorWriteTable (init111, sizeof(init111) / sizeof(sensorReg_t));
   sensorScaling (600);
   }
 //}}}
 //{{{
-void sensorInit112() {
-
+static const sensorReg_t init112[] = {
   //{{{  MCUBootMode - pulse reset
-  writeReg112 (0x3386, 0x2501);
-  writeReg112 (0x3386, 0x2500);
-  CyU3PThreadSleep (100);
+  { 0x3386, 0x2501 },
+  { 0x3386, 0x2500 },
+  { SENSOR_SLEEP, 100 },
   //}}}
   //{{{  set parallel, standby, slew, PLL control
   // reset_register = parallel enable
-  writeReg112 (0x301A, 0x0ACC);
+  { 0x301A, 0x0ACC },
 
   // standby_control
-  writeReg112 (0x3202, 0x0008);
-  CyU3PThreadSleep (100);
+  { 0x3202, 0x0008 },
+  { SENSOR_SLEEP, 100 },
 
   // input powerDown 10:8:PIXCLKSlew=0, 7:inputPowerDown=0, 2:0:outputSlew=0 0=slow
-  writeReg112 (0x3214, 0x0080);
+  { 0x3214, 0x0080 },
 
-  writeReg112 (0x341E, 0x8F09); // PLL,clk_in control BYPASS PLL
-  writeReg112 (0x341C, 0x0150); // PLL 13:8:n=1, 7:0:m=85 clk = (10mhz/(n+1)) * (m/8) = 50mhz
-  //writeReg112 (0x341C, 0x0180); // PLL 13:8:n=1, 7:0:m=128 clk = (10mhz/(n+1)) * (m/8) = 80mhz
-  CyU3PThreadSleep (5);
+  { 0x341E, 0x8F09 }, // PLL,clk_in control BYPASS PLL
+  { 0x341C, 0x0150 }, // PLL 13:8:n=1, 7:0:m=85 clk = (10mhz/(n+1)) * (m/8) = 50mhz
+  //{ 0x341C, 0x0180 }, // PLL 13:8:n=1, 7:0:m=128 clk = (10mhz/(n+1)) * (m/8) = 80mhz
+  { SENSOR_SLEEP, 5 },
 
-  writeReg112 (0x341E, 0x8F09); // PLL,clk_in control: PLL ON, bypass PLL
-  writeReg112 (0x341E, 0x8F08); // PLL,clk_in control: USE PLL
+  { 0x341E, 0x8F09 }, // PLL,clk_in control: PLL ON, bypass PLL
+  { 0x341E, 0x8F08 }, // PLL,clk_in control: USE PLL
   //}}}
 
   //{{{  preview A
   // A output width = 640, height = 480
-  writeReg112 (0x338C, 0x2703); writeReg112 (0x3390, 800);  // Output Width
-  writeReg112 (0x338C, 0x2705); writeReg112 (0x3390, 600);  // Output Height
+  { 0x338C, 0x2703 }, { 0x3390, 800 },  // Output Width
+  { 0x338C, 0x2705 }, { 0x3390, 600 },  // Output Height
 
   // A row,column start,end = 120,160,1101,1461
-  writeReg112 (0x338C, 0x270D); writeReg112 (0x3390, 0x0078);
-  writeReg112 (0x338C, 0x270F); writeReg112 (0x3390, 0x00A0);
-  writeReg112 (0x338C, 0x2711); writeReg112 (0x3390, 0x044d);
-  writeReg112 (0x338C, 0x2713); writeReg112 (0x3390, 0x05b5);
+  { 0x338C, 0x270D }, { 0x3390, 0x0078 },
+  { 0x338C, 0x270F }, { 0x3390, 0x00A0 },
+  { 0x338C, 0x2711 }, { 0x3390, 0x044d },
+  { 0x338C, 0x2713 }, { 0x3390, 0x05b5 },
 
   // A sensor_col_delay_A = 175
-  writeReg112 (0x338C, 0x2715); writeReg112 (0x3390, 0x00AF);
+  { 0x338C, 0x2715 }, { 0x3390, 0x00AF },
 
   // A sensor_row_speed_A = 0x2111
-  writeReg112 (0x338C, 0x2717); writeReg112 (0x3390, 0x2111);
+  { 0x338C, 0x2717 }, { 0x3390, 0x2111 },
 
   // A read mode = 0x046c default, x, xy binning, x,y odd increment
-  writeReg112 (0x338C, 0x2719); writeReg112 (0x3390, 0x046c);
+  { 0x338C, 0x2719 }, { 0x3390, 0x046c },
 
   // A sensor_x
-  writeReg112 (0x338C, 0x271B); writeReg112 (0x3390, 0x024F); // sensor_sample_time_pck= 591
-  writeReg112 (0x338C, 0x271D); writeReg112 (0x3390, 0x0102); // sensor_fine_correction = 258
-  writeReg112 (0x338C, 0x271F); writeReg112 (0x3390, 0x0279); // sensor_fine_IT_min ) = 633
-  writeReg112 (0x338C, 0x2721); writeReg112 (0x3390, 0x0155); // sensor_fine_IT_max_margin = 341
+  { 0x338C, 0x271B }, { 0x3390, 0x024F }, // sensor_sample_time_pck= 591
+  { 0x338C, 0x271D }, { 0x3390, 0x0102 }, // sensor_fine_correction = 258
+  { 0x338C, 0x271F }, { 0x3390, 0x0279 }, // sensor_fine_IT_min ) = 633
+  { 0x338C, 0x2721 }, { 0x3390, 0x0155 }, // sensor_fine_IT_max_margin = 341
 
   // A frame lines = 480
-  writeReg112 (0x338C, 0x2723); writeReg112 (0x3390, 0x01e0);
+  { 0x338C, 0x2723 }, { 0x3390, 0x01e0 },
 
   // A line length = 768 + 64
-  writeReg112 (0x338C, 0x2725); writeReg112 (0x3390, 0x0340);
+  { 0x338C, 0x2725 }, { 0x3390, 0x0340 },
 
   // A sensor_dac_id_x
-  writeReg112 (0x338C, 0x2727); writeReg112 (0x3390, 0x2020); // sensor_dac_id_4_5 = 8224
-  writeReg112 (0x338C, 0x2729); writeReg112 (0x3390, 0x2020); // sensor_dac_id_6_7 = 8224
-  writeReg112 (0x338C, 0x272B); writeReg112 (0x3390, 0x1020); // sensor_dac_id_8_9 = 4128
-  writeReg112 (0x338C, 0x272D); writeReg112 (0x3390, 0x2007); // sensor_dac_id_10_11 = 8199
+  { 0x338C, 0x2727 }, { 0x3390, 0x2020 }, // sensor_dac_id_4_5 = 8224
+  { 0x338C, 0x2729 }, { 0x3390, 0x2020 }, // sensor_dac_id_6_7 = 8224
+  { 0x338C, 0x272B }, { 0x3390, 0x1020 }, // sensor_dac_id_8_9 = 4128
+  { 0x338C, 0x272D }, { 0x3390, 0x2007 }, // sensor_dac_id_10_11 = 8199
 
   // A crop = 0,0,640,480
-  writeReg112 (0x338C, 0x2751); writeReg112 (0x3390, 0);   // Crop_X0 = 0
-  writeReg112 (0x338C, 0x2753); writeReg112 (0x3390, 800); // Crop_X1 = 800
-  writeReg112 (0x338C, 0x2755); writeReg112 (0x3390, 0);   // Crop_Y0 = 0
-  writeReg112 (0x338C, 0x2757); writeReg112 (0x3390, 600); // Crop_Y1 = 600
+  { 0x338C, 0x2751 }, { 0x3390, 0 },   // Crop_X0 = 0
+  { 0x338C, 0x2753 }, { 0x3390, 800 }, // Crop_X1 = 800
+  { 0x338C, 0x2755 }, { 0x3390, 0 },   // Crop_Y0 = 0
+  { 0x338C, 0x2757 }, { 0x3390, 600 }, // Crop_Y1 = 600
 
   // A output_format
-  writeReg112 (0x338c, 0x2795); writeReg112 (0x3390, 0x0002); // Natural, Swaps chrominance byte, yuv
+  { 0x338c, 0x2795 }, { 0x3390, 0x0002 }, // Natural, Swaps chrominance byte, yuv
   //}}}
   //{{{  capture B
   // B output width = 1600, height = 1200
-  writeReg112 (0x338C, 0x2707); writeReg112 (0x3390, 1600);
-  writeReg112 (0x338C, 0x2709); writeReg112 (0x3390, 1200);
+  { 0x338C, 0x2707 }, { 0x3390, 1600 },
+  { 0x338C, 0x2709 }, { 0x3390, 1200 },
 
   // B row,column start,end = 4,4,1211,1611
-  writeReg112 (0x338C, 0x272F); writeReg112 (0x3390, 0x0004); // Row Start (B)= 4
-  writeReg112 (0x338C, 0x2731); writeReg112 (0x3390, 0x0004); // Column Start (B)= 4
-  writeReg112 (0x338C, 0x2733); writeReg112 (0x3390, 0x04BB); // Row End (B)= 1211
-  writeReg112 (0x338C, 0x2735); writeReg112 (0x3390, 0x064B); // Column End (B)= 1611
+  { 0x338C, 0x272F }, { 0x3390, 0x0004 }, // Row Start (B)= 4
+  { 0x338C, 0x2731 }, { 0x3390, 0x0004 }, // Column Start (B)= 4
+  { 0x338C, 0x2733 }, { 0x3390, 0x04BB }, // Row End (B)= 1211
+  { 0x338C, 0x2735 }, { 0x3390, 0x064B }, // Column End (B)= 1611
 
   // B extra delay = 124
-  writeReg112 (0x338C, 0x2737); writeReg112 (0x3390, 0x007C);
+  { 0x338C, 0x2737 }, { 0x3390, 0x007C },
 
   // B row speed  = 8465
-  writeReg112 (0x338C, 0x2739); writeReg112 (0x3390, 0x2111);
+  { 0x338C, 0x2739 }, { 0x3390, 0x2111 },
 
   // B read mode = 0x0024 default, no binning, normal readout
-  writeReg112 (0x338C, 0x273B); writeReg112 (0x3390, 0x0024);
+  { 0x338C, 0x273B }, { 0x3390, 0x0024 },
 
   // B sensor_x
-  writeReg112 (0x338C, 0x273D); writeReg112 (0x3390, 0x0120); // sensor_sample_time_pck (B)= 288
-  writeReg112 (0x338C, 0x2741); writeReg112 (0x3390, 0x0169); // sensor_fine_IT_min (B)= 361
+  { 0x338C, 0x273D }, { 0x3390, 0x0120 }, // sensor_sample_time_pck (B)= 288
+  { 0x338C, 0x2741 }, { 0x3390, 0x0169 }, // sensor_fine_IT_min (B)= 361
 
   // B frame lines = 1232
-  writeReg112 (0x338C, 0x2745); writeReg112 (0x3390, 0x04D0);
+  { 0x338C, 0x2745 }, { 0x3390, 0x04D0 },
 
   // B line length = 2284
-  writeReg112 (0x338C, 0x2747); writeReg112 (0x3390, 0x08ec);
+  { 0x338C, 0x2747 }, { 0x3390, 0x08ec },
 
   // B crop = 0,0,1600,1200
-  writeReg112 (0x338C, 0x275F); writeReg112 (0x3390, 0);    // Crop_X0 (B)= 0
-  writeReg112 (0x338C, 0x2761); writeReg112 (0x3390, 1600); // Crop_X1 (B)= 1600
-  writeReg112 (0x338C, 0x2763); writeReg112 (0x3390, 0);    // Crop_Y0 (B)= 0
-  writeReg112 (0x338C, 0x2765); writeReg112 (0x3390, 1200); // Crop_Y1 (B)= 1200
+  { 0x338C, 0x275F }, { 0x3390, 0 },    // Crop_X0 (B)= 0
+  { 0x338C, 0x2761 }, { 0x3390, 1600 }, // Crop_X1 (B)= 1600
+  { 0x338C, 0x2763 }, { 0x3390, 0 },    // Crop_Y0 (B)= 0
+  { 0x338C, 0x2765 }, { 0x3390, 1200 }, // Crop_Y1 (B)= 1200
 
   // B output format
-  writeReg112 (0x338c, 0x2797); writeReg112 (0x3390, 0x0002); // B - Natural, Swaps chrominance byte, yuv
+  { 0x338c, 0x2797 }, { 0x3390, 0x0002 }, // B - Natural, Swaps chrominance byte, yuv
   //}}}
 
   //{{{  AE
-  writeReg112 (0x338C, 0xA215); writeReg112 (0x3390, 0x0006); // AE_maxADC
-  writeReg112 (0x338C, 0xA206); writeReg112 (0x3390, 0x0036); // AE_TARGET brightness
-  writeReg112 (0x338C, 0xA207); writeReg112 (0x3390, 0x0040); // AE_GATE sensitivity
-  writeReg112 (0x338C, 0xA20C); writeReg112 (0x3390, 0x0008); // AE_maxIndex max zone num
+  { 0x338C, 0xA215 }, { 0x3390, 0x0006 }, // AE_maxADC
+  { 0x338C, 0xA206 }, { 0x3390, 0x0036 }, // AE_TARGET brightness
+  { 0x338C, 0xA207 }, { 0x3390, 0x0040 }, // AE_GATE sensitivity
+  { 0x338C, 0xA20C }, { 0x3390, 0x0008 }, // AE_maxIndex max zone num
   //}}}
   //{{{  black level, gain
-  writeReg112 (0x3278, 0x0050); // first black level
-  writeReg112 (0x327a, 0x0050); // first black level,red
-  writeReg112 (0x327c, 0x0050); // green_1
-  writeReg112 (0x327e, 0x0050); // green_2
-  writeReg112 (0x3280, 0x0050); // blue
+  { 0x3278, 0x0050 }, // first black level
+  { 0x327a, 0x0050 }, // first black level,red
+  { 0x327c, 0x0050 }, // green_1
+  { 0x327e, 0x0050 }, // green_2
+  { 0x3280, 0x0050 }, // blue
 
-  CyU3PThreadSleep (10);
+  { SENSOR_SLEEP, 10 },
   //}}}
-  writeReg112 (0x337e, 0x2000); // Y,RGB offset
+  { 0x337e, 0x2000 }, // Y,RGB offset
   //{{{  AWB
-  writeReg112 (0x338C, 0xA34A); writeReg112 (0x3390, 0x0059);     // AWB_GAIN_MIN
-  writeReg112 (0x338C, 0xA34B); writeReg112 (0x3390, 0x00A6);     // AWB_GAIN_MAX
-
-  writeReg112 (0x338C, 0x235F); writeReg112 (0x3390, 0x0040);     // AWB_CNT_PXL_TH
-
-  writeReg112 (0x338C, 0xA361); writeReg112 (0x3390, 0x00D2);     // AWB_TG_MIN0
-  writeReg112 (0x338C, 0xA362); writeReg112 (0x3390, 0x00E6);     // AWB_TG_MAX0
-  writeReg112 (0x338C, 0xA363); writeReg112 (0x3390, 0x0010);     // AWB_X0
-
-  writeReg112 (0x338C, 0xA364); writeReg112 (0x3390, 0x00A0);     // AWB_KR_L
-  writeReg112 (0x338C, 0xA365); writeReg112 (0x3390, 0x0096);     // AWB_KG_L
-  writeReg112 (0x338C, 0xA366); writeReg112 (0x3390, 0x0080);     // AWB_KB_L
-  writeReg112 (0x338C, 0xA367); writeReg112 (0x3390, 0x0080);     // AWB_KR_R
-  writeReg112 (0x338C, 0xA368); writeReg112 (0x3390, 0x0080);     // AWB_KG_R
-  writeReg112 (0x338C, 0xA369); writeReg112 (0x3390, 0x0080);     // AWB_KB_R
-
-  writeReg112 (0x32A2, 0x3640);     // RESERVED_SOC1_32A2  // fine tune color setting
-
-  writeReg112 (0x338C, 0x2306); writeReg112 (0x3390, 0x02FF);     // AWB_CCM_L_0
-  writeReg112 (0x338C, 0x2308); writeReg112 (0x3390, 0xFE6E);     // AWB_CCM_L_1
-  writeReg112 (0x338C, 0x230A); writeReg112 (0x3390, 0xFFC2);     // AWB_CCM_L_2
-  writeReg112 (0x338C, 0x230C); writeReg112 (0x3390, 0xFF4A);     // AWB_CCM_L_3
-  writeReg112 (0x338C, 0x230E); writeReg112 (0x3390, 0x02D7);     // AWB_CCM_L_4
-  writeReg112 (0x338C, 0x2310); writeReg112 (0x3390, 0xFF30);     // AWB_CCM_L_5
-  writeReg112 (0x338C, 0x2312); writeReg112 (0x3390, 0xFF6E);     // AWB_CCM_L_6
-  writeReg112 (0x338C, 0x2314); writeReg112 (0x3390, 0xFDEE);     // AWB_CCM_L_7
-  writeReg112 (0x338C, 0x2316); writeReg112 (0x3390, 0x03CF);     // AWB_CCM_L_8
-  writeReg112 (0x338C, 0x2318); writeReg112 (0x3390, 0x0020);     // AWB_CCM_L_9
-  writeReg112 (0x338C, 0x231A); writeReg112 (0x3390, 0x003C);     // AWB_CCM_L_10
-
-  writeReg112 (0x338C, 0x231C); writeReg112 (0x3390, 0x002C);     // AWB_CCM_RL_0
-  writeReg112 (0x338C, 0x231E); writeReg112 (0x3390, 0xFFBC);     // AWB_CCM_RL_1
-  writeReg112 (0x338C, 0x2320); writeReg112 (0x3390, 0x0016);     // AWB_CCM_RL_2
-  writeReg112 (0x338C, 0x2322); writeReg112 (0x3390, 0x0037);     // AWB_CCM_RL_3
-  writeReg112 (0x338C, 0x2324); writeReg112 (0x3390, 0xFFCD);     // AWB_CCM_RL_4
-  writeReg112 (0x338C, 0x2326); writeReg112 (0x3390, 0xFFF3);     // AWB_CCM_RL_5
-  writeReg112 (0x338C, 0x2328); writeReg112 (0x3390, 0x0077);     // AWB_CCM_RL_6
-  writeReg112 (0x338C, 0x232A); writeReg112 (0x3390, 0x00F4);     // AWB_CCM_RL_7
-  writeReg112 (0x338C, 0x232C); writeReg112 (0x3390, 0xFE95);     // AWB_CCM_RL_8
-  writeReg112 (0x338C, 0x232E); writeReg112 (0x3390, 0x0014);     // AWB_CCM_RL_9
-  writeReg112 (0x338C, 0x2330); writeReg112 (0x3390, 0xFFE8);     // AWB_CCM_RL_10  //end
-
-  writeReg112 (0x338C, 0xA348); writeReg112 (0x3390, 0x0008);     // AWB_GAIN_BUFFER_SPEED
-  writeReg112 (0x338C, 0xA349); writeReg112 (0x3390, 0x0002);     // AWB_JUMP_DIVISOR
-  writeReg112 (0x338C, 0xA34A); writeReg112 (0x3390, 0x0059);     // AWB_GAIN_MIN
-  writeReg112 (0x338C, 0xA34B); writeReg112 (0x3390, 0x00A6);     // AWB_GAIN_MAX
-  writeReg112 (0x338C, 0xA34F); writeReg112 (0x3390, 0x0000);     // AWB_CCM_POSITION_MIN
-  writeReg112 (0x338C, 0xA350); writeReg112 (0x3390, 0x007F);     // AWB_CCM_POSITION_MAX
-  writeReg112 (0x338C, 0xA352); writeReg112 (0x3390, 0x001E);     // AWB_SATURATION
-  writeReg112 (0x338C, 0xA353); writeReg112 (0x3390, 0x0002);     // AWB_MODE
-
-  writeReg112 (0x338C, 0xA35B); writeReg112 (0x3390, 0x007E);     // AWB_STEADY_BGAIN_OUT_MIN
-  writeReg112 (0x338C, 0xA35C); writeReg112 (0x3390, 0x0086);     // AWB_STEADY_BGAIN_OUT_MAX
-  writeReg112 (0x338C, 0xA35D); writeReg112 (0x3390, 0x007F);     // AWB_STEADY_BGAIN_IN_MIN
-  writeReg112 (0x338C, 0xA35E); writeReg112 (0x3390, 0x0082);     // AWB_STEADY_BGAIN_IN_MAX
-
-  writeReg112 (0x338C, 0xA302); writeReg112 (0x3390, 0x0000);     // AWB_WINDOW_POS
-  writeReg112 (0x338C, 0xA303); writeReg112 (0x3390, 0x00EF);     // AWB_WINDOW_SIZE
-  writeReg112 (0x338C, 0xAB05); writeReg112 (0x3390, 0x0000);     // HG_PERCENT
+  { 0x338C, 0xA34A }, { 0x3390, 0x0059 },     // AWB_GAIN_MIN
+  { 0x338C, 0xA34B }, { 0x3390, 0x00A6 },     // AWB_GAIN_MAX
+
+  { 0x338C, 0x235F }, { 0x3390, 0x0040 },     // AWB_CNT_PXL_TH
+
+  { 0x338C, 0xA361 }, { 0x3390, 0x00D2 },     // AWB_TG_MIN0
+  { 0x338C, 0xA362 }, { 0x3390, 0x00E6 },     // AWB_TG_MAX0
+  { 0x338C, 0xA363 }, { 0x3390, 0x0010 },     // AWB_X0
+
+  { 0x338C, 0xA364 }, { 0x3390, 0x00A0 },     // AWB_KR_L
+  { 0x338C, 0xA365 }, { 0x3390, 0x0096 },     // AWB_KG_L
+  { 0x338C, 0xA366 }, { 0x3390, 0x0080 },     // AWB_KB_L
+  { 0x338C, 0xA367 }, { 0x3390, 0x0080 },     // AWB_KR_R
+  { 0x338C, 0xA368 }, { 0x3390, 0x0080 },     // AWB_KG_R
+  { 0x338C, 0xA369 }, { 0x3390, 0x0080 },     // AWB_KB_R
+
+  { 0x32A2, 0x3640 },     // RESERVED_SOC1_32A2  // fine tune color setting
+
+  { 0x338C, 0x2306 }, { 0x3390, 0x02FF },     // AWB_CCM_L_0
+  { 0x338C, 0x2308 }, { 0x3390, 0xFE6E },     // AWB_CCM_L_1
+  { 0x338C, 0x230A }, { 0x3390, 0xFFC2 },     // AWB_CCM_L_2
+  { 0x338C, 0x230C }, { 0x3390, 0xFF4A },     // AWB_CCM_L_3
+  { 0x338C, 0x230E }, { 0x3390, 0x02D7 },     // AWB_CCM_L_4
+  { 0x338C, 0x2310 }, { 0x3390, 0xFF30 },     // AWB_CCM_L_5
+  { 0x338C, 0x2312 }, { 0x3390, 0xFF6E },     // AWB_CCM_L_6
+  { 0x338C, 0x2314 }, { 0x3390, 0xFDEE },     // AWB_CCM_L_7
+  { 0x338C, 0x2316 }, { 0x3390, 0x03CF },     // AWB_CCM_L_8
+  { 0x338C, 0x2318 }, { 0x3390, 0x0020 },     // AWB_CCM_L_9
+  { 0x338C, 0x231A }, { 0x3390, 0x003C },     // AWB_CCM_L_10
+
+  { 0x338C, 0x231C }, { 0x3390, 0x002C },     // AWB_CCM_RL_0
+  { 0x338C, 0x231E }, { 0x3390, 0xFFBC },     // AWB_CCM_RL_1
+  { 0x338C, 0x2320 }, { 0x3390, 0x0016 },     // AWB_CCM_RL_2
+  { 0x338C, 0x2322 }, { 0x3390, 0x0037 },     // AWB_CCM_RL_3
+  { 0x338C, 0x2324 }, { 0x3390, 0xFFCD },     // AWB_CCM_RL_4
+  { 0x338C, 0x2326 }, { 0x3390, 0xFFF3 },     // AWB_CCM_RL_5
+  { 0x338C, 0x2328 }, { 0x3390, 0x0077 },     // AWB_CCM_RL_6
+  { 0x338C, 0x232A }, { 0x3390, 0x00F4 },     // AWB_CCM_RL_7
+  { 0x338C, 0x232C }, { 0x3390, 0xFE95 },     // AWB_CCM_RL_8
+  { 0x338C, 0x232E }, { 0x3390, 0x0014 },     // AWB_CCM_RL_9
+  { 0x338C, 0x2330 }, { 0x3390, 0xFFE8 },     // AWB_CCM_RL_10  //end
+
+  { 0x338C, 0xA348 }, { 0x3390, 0x0008 },     // AWB_GAIN_BUFFER_SPEED
+  { 0x338C, 0xA349 }, { 0x3390, 0x0002 },     // AWB_JUMP_DIVISOR
+  { 0x338C, 0xA34A }, { 0x3390, 0x0059 },     // AWB_GAIN_MIN
+  { 0x338C, 0xA34B }, { 0x3390, 0x00A6 },     // AWB_GAIN_MAX
+  { 0x338C, 0xA34F }, { 0x3390, 0x0000 },     // AWB_CCM_POSITION_MIN
+  { 0x338C, 0xA350 }, { 0x3390, 0x007F },     // AWB_CCM_POSITION_MAX
+  { 0x338C, 0xA352 }, { 0x3390, 0x001E },     // AWB_SATURATION
+  { 0x338C, 0xA353 }, { 0x3390, 0x0002 },     // AWB_MODE
+
+  { 0x338C, 0xA35B }, { 0x3390, 0x007E },     // AWB_STEADY_BGAIN_OUT_MIN
+  { 0x338C, 0xA35C }, { 0x3390, 0x0086 },     // AWB_STEADY_BGAIN_OUT_MAX
+  { 0x338C, 0xA35D }, { 0x3390, 0x007F },     // AWB_STEADY_BGAIN_IN_MIN
+  { 0x338C, 0xA35E }, { 0x3390, 0x0082 },     // AWB_STEADY_BGAIN_IN_MAX
+
+  { 0x338C, 0xA302 }, { 0x3390, 0x0000 },     // AWB_WINDOW_POS
+  { 0x338C, 0xA303 }, { 0x3390, 0x00EF },     // AWB_WINDOW_SIZE
+  { 0x338C, 0xAB05 }, { 0x3390, 0x0000 },     // HG_PERCENT
   //}}}
-  writeReg112 (0x35A4, 0x0596); // BRIGHT_COLOR_KILL_CONTROLS
+  { 0x35A4, 0x0596 }, // BRIGHT_COLOR_KILL_CONTROLS
 
   //{{{  SEQ_LL
-  writeReg112 (0x338C, 0xA118); writeReg112 (0x3390, 0x001E); // SEQ_LLSAT1
-  //writeReg112 (0x338c, 0xa118); writeReg112 (0x3390, 0x0026); // sequencer.saturation = 26
-  writeReg112 (0x338C, 0xA119); writeReg112 (0x3390, 0x0004); // SEQ_LLSAT2
+  { 0x338C, 0xA118 }, { 0x3390, 0x001E }, // SEQ_LLSAT1
+  //{ 0x338c, 0xa118 }, { 0x3390, 0x0026 }, // sequencer.saturation = 26
+  { 0x338C, 0xA119 }, { 0x3390, 0x0004 }, // SEQ_LLSAT2
 
-  writeReg112 (0x338C, 0xA11A); writeReg112 (0x3390, 0x000A); // SEQ_LLINTERPTHRESH1
-  writeReg112 (0x338C, 0xA11B); writeReg112 (0x3390, 0x0020); // SEQ_LLINTERPTHRESH2
+  { 0x338C, 0xA11A }, { 0x3390, 0x000A }, // SEQ_LLINTERPTHRESH1
+  { 0x338C, 0xA11B }, { 0x3390, 0x0020 }, // SEQ_LLINTERPTHRESH2
   //}}}
   //{{{  SEQ_NR
-  writeReg112 (0x338C, 0xA13E); writeReg112 (0x3390, 0x0004); // SEQ_NR_TH1_R
-  writeReg112 (0x338C, 0xA13F); writeReg112 (0x3390, 0x000E); // SEQ_NR_TH1_G
-  writeReg112 (0x338C, 0xA140); writeReg112 (0x3390, 0x0004); // SEQ_NR_TH1_B
-  writeReg112 (0x338C, 0xA141); writeReg112 (0x3390, 0x0004); // SEQ_NR_TH1_OL
-  writeReg112 (0x338C, 0xA142); writeReg112 (0x3390, 0x0032); // SEQ_NR_TH2_R
-  writeReg112 (0x338C, 0xA143); writeReg112 (0x3390, 0x000F); // SEQ_NR_TH2_G
-  writeReg112 (0x338C, 0xA144); writeReg112 (0x3390, 0x0032); // SEQ_NR_TH2_B
-  writeReg112 (0x338C, 0xA145); writeReg112 (0x3390, 0x0032); // SEQ_NR_TH2_OL
-
-  writeReg112 (0x338C, 0xA146); writeReg112 (0x3390, 0x0005); // SEQ_NR_GAINTH1
-  writeReg112 (0x338C, 0xA147); writeReg112 (0x3390, 0x003A); // SEQ_NR_GAINTH2
+  { 0x338C, 0xA13E }, { 0x3390, 0x0004 }, // SEQ_NR_TH1_R
+  { 0x338C, 0xA13F }, { 0x3390, 0x000E }, // SEQ_NR_TH1_G
+  { 0x338C, 0xA140 }, { 0x3390, 0x0004 }, // SEQ_NR_TH1_B
+  { 0x338C, 0xA141 }, { 0x3390, 0x0004 }, // SEQ_NR_TH1_OL
+  { 0x338C, 0xA142 }, { 0x3390, 0x0032 }, // SEQ_NR_TH2_R
+  { 0x338C, 0xA143 }, { 0x3390, 0x000F }, // SEQ_NR_TH2_G
+  { 0x338C, 0xA144 }, { 0x3390, 0x0032 }, // SEQ_NR_TH2_B
+  { 0x338C, 0xA145 }, { 0x3390, 0x0032 }, // SEQ_NR_TH2_OL
+
+  { 0x338C, 0xA146 }, { 0x3390, 0x0005 }, // SEQ_NR_GAINTH1
+  { 0x338C, 0xA147 }, { 0x3390, 0x003A }, // SEQ_NR_GAINTH2
   //}}}
   //{{{  flicker R9 step
-  writeReg112 (0x338C, 0x222E); writeReg112 (0x3390, 0x0090); // R9 Step = 144
+  { 0x338C, 0x222E }, { 0x3390, 0x0090 }, // R9 Step = 144
 
-  writeReg112 (0x338C, 0xA408); writeReg112 (0x3390, 0x001A); // search_f1_50 = 26
-  writeReg112 (0x338C, 0xA409); writeReg112 (0x3390, 0x001D); // search_f2_50 = 29
-  writeReg112 (0x338C, 0xA40A); writeReg112 (0x3390, 0x0020); // search_f1_60 = 32
-  writeReg112 (0x338C, 0xA40B); writeReg112 (0x3390, 0x0023); // search_f2_60 = 35
+  { 0x338C, 0xA408 }, { 0x3390, 0x001A }, // search_f1_50 = 26
+  { 0x338C, 0xA409 }, { 0x3390, 0x001D }, // search_f2_50 = 29
+  { 0x338C, 0xA40A }, { 0x3390, 0x0020 }, // search_f1_60 = 32
+  { 0x338C, 0xA40B }, { 0x3390, 0x0023 }, // search_f2_60 = 35
 
-  writeReg112 (0x338C, 0xA40D); writeReg112 (0x3390, 0x0002); // Stat_min = 2
-  writeReg112 (0x338C, 0xA410); writeReg112 (0x3390, 0x0001); // Min_amplitude = 1
+  { 0x338C, 0xA40D }, { 0x3390, 0x0002 }, // Stat_min = 2
+  { 0x338C, 0xA410 }, { 0x3390, 0x0001 }, // Min_amplitude = 1
 
-  writeReg112 (0x338C, 0x2411); writeReg112 (0x3390, 0x0090); // R9_Step_60_A = 144
-  writeReg112 (0x338C, 0x2413); writeReg112 (0x3390, 0x00AD); // R9_Step_50_A = 173
-  writeReg112 (0x338C, 0x2415); writeReg112 (0x3390, 0x0055); // R9_Step_60_B = 85
-  writeReg112 (0x338C, 0x2417); writeReg112 (0x3390, 0x0066); // R9_Step_50_B = 102
+  { 0x338C, 0x2411 }, { 0x3390, 0x0090 }, // R9_Step_60_A = 144
+  { 0x338C, 0x2413 }, { 0x3390, 0x00AD }, // R9_Step_50_A = 173
+  { 0x338C, 0x2415 }, { 0x3390, 0x0055 }, // R9_Step_60_B = 85
+  { 0x338C, 0x2417 }, { 0x3390, 0x0066 }, // R9_Step_50_B = 102
   //}}}
 
-  writeReg112 (0x338C, 0xA103); writeReg112 (0x3390, 0x0006); // sequencer.cmd = 6 = refresh mode
-  CyU3PThreadSleep (100);
+  { 0x338C, 0xA103 }, { 0x3390, 0x0006 }, // sequencer.cmd = 6 = refresh mode
+  { SENSOR_SEQ_WAIT, 500 },
 
-  writeReg112 (0x338C, 0xA103); writeReg112 (0x3390, 0x0005); // sequencer.cmd = 5 = refresh
-  CyU3PThreadSleep (100);
+  { 0x338C, 0xA103 }, { 0x3390, 0x0005 }, // sequencer.cmd = 5 = refresh
+  { SENSOR_SEQ_WAIT, 500 },
 
-  writeReg112 (0x33f4, 0x031d); // defect - undocumented
+  { 0x33f4, 0x031d }, // defect - undocumented
+  };
+//}}}
+//{{{
+static void sensorInit112() {
+
+  sensorWriteTable (init112, sizeof(init112) / sizeof(sensorReg_t));
+  }
+//}}}
+//{{{
+uint32_t sensorInitMs() {
+  return initMs;
+  }
+//}}}
+//{{{
+void sensorShadowCounters (uint32_t* hits, uint32_t* misses) {
+
+  *hits = shadowHits;
+  *misses = shadowMisses;
   }
 //}}}
 //{{{
 void sensorInit() {
 
+  uint32_t start = CyU3PGetTime();
   I2Cinit (400000);
+  shadowInvalidate();
 
   //uint16_t value = readReg112 (0x3000);
   //mt9d111 = (value == 0x1519);
@@ -760,6 +1208,7 @@ void sensorInit() {
   mt9d111 = (value == 0x1519);
   //mt9d111 = 1;
   if (mt9d111) {
+    chipId = value;
     line3 ("9d111.48.", value);
     sensorInit111();
     }
@@ -767,9 +1216,13 @@ void sensorInit() {
     uint16_t value = readReg112 (0x3000);
     line3 ("try 112", value);
     if (value == 0x1580) {
+      chipId = value;
       line3 ("9d112.50.", value);
       sensorInit112();
       }
     }
+
+  initMs = CyU3PGetTime() - start;
+  CyU3PDebugPrint (4, "sensorInit %d ms\r\n", initMs);
   }
 //}}}
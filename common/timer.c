@@ -0,0 +1,46 @@
+// free running 32bit timestamp counter on a complex gpio timer
+// - gpio block must be clocked with gpioClock.fastClkDiv = TIMER_FAST_CLK_DIV
+// - TIMER_GPIO must be enabled in io_cfg.gpioComplexEn
+//{{{  includes
+#include <cyu3system.h>
+#include <cyu3gpio.h>
+
+#include "timer.h"
+//}}}
+
+//{{{
+void timerInit() {
+
+  // pin not driven, timer counts fastClk, wraps at period
+  CyU3PGpioComplexConfig_t gpioConfig;
+  CyU3PMemSet ((uint8_t*)&gpioConfig, 0, sizeof(gpioConfig));
+  gpioConfig.outValue    = CyFalse;
+  gpioConfig.inputEn     = CyFalse;
+  gpioConfig.driveLowEn  = CyFalse;
+  gpioConfig.driveHighEn = CyFalse;
+  gpioConfig.pinMode     = CY_U3P_GPIO_MODE_STATIC;
+  gpioConfig.intrMode    = CY_U3P_GPIO_NO_INTR;
+  gpioConfig.timerMode   = CY_U3P_GPIO_TIMER_HIGH_FREQ;
+  gpioConfig.timer       = 0;
+  gpioConfig.period      = 0xFFFFFFFF;
+  gpioConfig.threshold   = 0xFFFFFFFF;
+  CyU3PGpioSetComplexConfig (TIMER_GPIO, &gpioConfig);
+  }
+//}}}
+//{{{
+uint32_t timerTicks() {
+// sample timer, register access only, safe from callbacks
+
+  uint32_t ticks = 0;
+  CyU3PGpioComplexSampleNow (TIMER_GPIO, &ticks);
+  return ticks;
+  }
+//}}}
+//{{{
+uint32_t timerFrequency() {
+
+  uint32_t sysClk = 0;
+  CyU3PDeviceGetSysClkFreq (&sysClk);
+  return sysClk / TIMER_FAST_CLK_DIV;
+  }
+//}}}
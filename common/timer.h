@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cyu3types.h>
+
+#define TIMER_GPIO         50  // complex gpio, I2S_CLK pin unused, free running counter
+#define TIMER_FAST_CLK_DIV 8   // gpio fastClk = sysClk 384MHz / 8 = 48MHz, UVC dwClockFrequency
+
+extern void timerInit();
+extern uint32_t timerTicks();
+extern uint32_t timerFrequency();
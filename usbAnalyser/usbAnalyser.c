@@ -15,15 +15,26 @@
 
 #include "../common/display.h"
 #include "../common/sensor.h"
+#include "../common/bufferPlan.h"
+#include "../common/timer.h"
+#include "../common/analyser.h"
 /*}}}*/
 /*{{{  defines*/
 #define RESET_GPIO 22  // CTL 5 pin
 #define BUTTON_GPIO 45
 
 #define CY_FX_EP_CONSUMER  0x81 // EP1 in
+#define CY_FX_EP_EVENTS    0x82 // EP2 in, decoded events
 
 #define CY_FX_USB_BUTTON_DOWN_EVENT   (1 << 0)
 #define CY_FX_USB_BUTTON_UP_EVENT     (1 << 1)
+#define CY_FX_USB_CAPTURE_EVENT       (1 << 2)  // gpif buffer produced or window buffer consumed
+#define CY_FX_USB_TRIGGER_EVENT       (1 << 3)  // trigger, encoding, sample rate or decoders programmed, app thread recreates capture
+#define CY_FX_USB_EVENTS_EVENT        (1 << 4)  // ep2 halt cleared, app thread resets event channel
+
+#define CAPTURE_SIZE    16384  // dma buffer bytes, analyserHeader_t then 8184 16 bit samples
+#define CAPTURE_COUNT   4
+#define CAPTURE_PAYLOAD (CAPTURE_SIZE - ANALYSER_HEADER_SIZE)
 /*}}}*/
 /*{{{  descriptors*/
 /*{{{*/
@@ -106,7 +117,7 @@ const uint8_t CyFxUSBFSConfigDscr[] __attribute__ ((aligned (32))) = {
   /* Configuration descriptor */
   0x09,                           /* Descriptor size */
   CY_U3P_USB_CONFIG_DESCR,        /* Configuration descriptor type */
-  0x19,0x00,                      /* Length of this descriptor and all sub descriptors */
+  0x20,0x00,                      /* Length of this descriptor and all sub descriptors */
   0x01,                           /* Number of interfaces */
   0x01,                           /* Configuration number */
   0x00,                           /* COnfiguration string index */
@@ -118,7 +129,7 @@ const uint8_t CyFxUSBFSConfigDscr[] __attribute__ ((aligned (32))) = {
   CY_U3P_USB_INTRFC_DESCR,        /* Interface descriptor type */
   0x00,                           /* Interface number */
   0x00,                           /* Alternate setting number */
-  0x01,                           /* Number of endpoints */
+  0x02,                           /* Number of endpoints */
   0xFF,                           /* Interface class */
   0x00,                           /* Interface sub class */
   0x00,                           /* Interface protocol code */
@@ -130,6 +141,14 @@ const uint8_t CyFxUSBFSConfigDscr[] __attribute__ ((aligned (32))) = {
   CY_FX_EP_CONSUMER,              /* Endpoint address and description */
   CY_U3P_USB_EP_BULK,             /* Bulk endpoint type */
   0x40,0x00,                      /* Max packet size = 64 bytes */
+  0x00,                           /* Servicing interval for data transfers : 0 for bulk */
+
+  /* Endpoint descriptor for decoded events EP */
+  0x07,                           /* Descriptor size */
+  CY_U3P_USB_ENDPNT_DESCR,        /* Endpoint descriptor type */
+  CY_FX_EP_EVENTS,                /* Endpoint address and description */
+  CY_U3P_USB_EP_BULK,             /* Bulk endpoint type */
+  0x40,0x00,                      /* Max packet size = 64 bytes */
   0x00                            /* Servicing interval for data transfers : 0 for bulk */
   };
 /*}}}*/
@@ -138,7 +157,7 @@ const uint8_t CyFxUSBHSConfigDscr[] __attribute__ ((aligned (32))) = {
   /* Configuration descriptor */
   0x09,                           /* Descriptor size */
   CY_U3P_USB_CONFIG_DESCR,        /* Configuration descriptor type */
-  0x19,0x00,                      /* Length of this descriptor and all sub descriptors */
+  0x20,0x00,                      /* Length of this descriptor and all sub descriptors */
   0x01,                           /* Number of interfaces */
   0x01,                           /* Configuration number */
   0x00,                           /* COnfiguration string index */
@@ -150,7 +169,7 @@ const uint8_t CyFxUSBHSConfigDscr[] __attribute__ ((aligned (32))) = {
   CY_U3P_USB_INTRFC_DESCR,        /* Interface Descriptor type */
   0x00,                           /* Interface number */
   0x00,                           /* Alternate setting number */
-  0x01,                           /* Number of endpoints */
+  0x02,                           /* Number of endpoints */
   0xFF,                           /* Interface class */
   0x00,                           /* Interface sub class */
   0x00,                           /* Interface protocol code */
@@ -162,6 +181,14 @@ const uint8_t CyFxUSBHSConfigDscr[] __attribute__ ((aligned (32))) = {
   CY_FX_EP_CONSUMER,              /* Endpoint address and description */
   CY_U3P_USB_EP_BULK,             /* Bulk endpoint type */
   0x00,0x02,                      /* Max packet size = 512 bytes */
+  0x00,                           /* Servicing interval for data transfers : 0 for bulk */
+
+  /* Endpoint descriptor for decoded events EP */
+  0x07,                           /* Descriptor size */
+  CY_U3P_USB_ENDPNT_DESCR,        /* Endpoint descriptor type */
+  CY_FX_EP_EVENTS,                /* Endpoint address and description */
+  CY_U3P_USB_EP_BULK,             /* Bulk endpoint type */
+  0x00,0x02,                      /* Max packet size = 512 bytes */
   0x00                            /* Servicing interval for data transfers : 0 for bulk */
   };
 /*}}}*/
@@ -170,7 +197,7 @@ const uint8_t CyFxUSBSSConfigDscr[] __attribute__ ((aligned (32))) = {
   /* Configuration descriptor */
   0x09,                           /* Descriptor size */
   CY_U3P_USB_CONFIG_DESCR,        /* Configuration descriptor type */
-  0x1F,0x00,                      /* Length of this descriptor and all sub descriptors */
+  0x2C,0x00,                      /* Length of this descriptor and all sub descriptors */
   0x01,                           /* Number of interfaces */
   0x01,                           /* Configuration number */
   0x00,                           /* Configuration string index */
@@ -182,7 +209,7 @@ const uint8_t CyFxUSBSSConfigDscr[] __attribute__ ((aligned (32))) = {
   CY_U3P_USB_INTRFC_DESCR,        /* Interface Descriptor type */
   0x00,                           /* Interface number */
   0x00,                           /* Alternate setting number */
-  0x01,                           /* Number of end points */
+  0x02,                           /* Number of end points */
   0xFF,                           /* Interface class */
   0x00,                           /* Interface sub class */
   0x00,                           /* Interface protocol code */
@@ -202,6 +229,21 @@ const uint8_t CyFxUSBSSConfigDscr[] __attribute__ ((aligned (32))) = {
   15,                             /* Max no. of packets in a burst(0-15) - 0: burst 1 packet at a time */
   0x00,                           /* Max streams for bulk EP = 0 (No streams) */
   0x00,0x00,                      /* Service interval for the EP : 0 for bulk */
+
+  // Endpoint descriptor for decoded events in EP2
+  0x07,                           /* Descriptor size */
+  CY_U3P_USB_ENDPNT_DESCR,        /* Endpoint descriptor type */
+  CY_FX_EP_EVENTS,                /* Endpoint address and description */
+  CY_U3P_USB_EP_BULK,             /* Bulk endpoint type */
+  0x00,0x04,                      /* Max packet size = 1024 bytes */
+  0x00,                           /* Servicing interval for data transfers : 0 for Bulk */
+
+  // Super speed endpoint companion descriptor for events in EP2
+  0x06,                           /* Descriptor size */
+  CY_U3P_SS_EP_COMPN_DESCR,       /* SS endpoint companion descriptor type */
+  0,                              /* Max no. of packets in a burst(0-15) - 0: burst 1 packet at a time */
+  0x00,                           /* Max streams for bulk EP = 0 (No streams) */
+  0x00,0x00,                      /* Service interval for the EP : 0 for bulk */
   };
 /*}}}*/
 
@@ -244,6 +286,7 @@ static CyU3PEvent appEvent;
 static CyU3PDmaChannel dmaChannel;
 
 static CyBool_t appActive = CyFalse;     // Whether the source sink application is active or not. */
+static CyU3PMutex captureMutex;          // capture channels, usb event callback start stop against app thread
 static CyBool_t glForceLinkU2 = CyFalse; // Whether the device should try to initiate U2 mode. */
 
 volatile static CyBool_t hitFV = CyFalse;       // Whether end of frame (FV) signal has been hit
@@ -251,6 +294,159 @@ volatile static CyBool_t gotPartial = CyFalse;  // track last partial buffer ens
 
 uint8_t glEp0Buffer[4096] __attribute__ ((aligned (32)));
 /*}}}*/
+/*{{{  trigger, vendor 0xB0 programs and arms, 0xB1 reads status*/
+// no stages, free running, see capture
+// stages, gpif to cpu manual channel, each buffer scanned then copied into a history slot from spare buffer heap,
+// cpu to ep1 manual out channel sends the window round the trigger from the history slots, one outstanding
+// - each piece sent has its analyserHeader_t written in front of it, in the slot
+// - stage matches when masked sample equals value and its rise, fall bits all changed that way on that sample
+// - stages match in sequence, last stage match is the trigger sample
+// - scan and copy run at cpu speed, gpif waits in DMAWAIT when they fall behind, history then has gaps
+#define TRIG_STAGES    4
+#define TRIG_SLOTS_MAX 32
+
+#define TRIG_OFF   0  // free running, no trigger programmed
+#define TRIG_ARMED 1  // scanning, history holds the samples before the trigger
+#define TRIG_POST  2  // triggered, window sent from history while post trigger samples arrive
+#define TRIG_DONE  3  // window sent, gpif stopped until armed again
+
+typedef struct trigStage {
+  uint16_t mask;   // sample bits compared with value
+  uint16_t value;
+  uint16_t rise;   // bits which must go 0 to 1 on the matching sample
+  uint16_t fall;   // bits which must go 1 to 0 on the matching sample
+} trigStage_t;
+
+typedef struct trigger {
+  uint8_t  stages;      // stages in sequence, 0 free running
+  uint8_t  reserved[3];
+  uint32_t preSamples;  // samples sent before the trigger sample, capped by history held
+  uint32_t postSamples; // samples sent from the trigger sample on
+  trigStage_t stage[TRIG_STAGES];
+} trigger_t;
+
+typedef struct trigStatus {
+  uint8_t  state;         // TRIG_
+  uint8_t  stage;         // stages matched so far
+  uint16_t slots;         // history slots allocated
+  uint32_t scanned;       // samples received since armed
+  uint32_t triggerSample; // sample index of the trigger since armed
+  uint32_t windowStart;   // sample index window starts at, pre trigger samples held may be less than asked
+  uint32_t windowEnd;     // sample index window ends before
+  uint32_t stalls;        // gpif buffers held back, history full of unsent window
+} trigStatus_t;
+
+static trigger_t trigger;             // app thread copy, taken from trigNext when channels are created
+static trigger_t trigNext;            // vendor 0xB0 data, setup callback
+static trigStatus_t trigStatus;
+
+static CyU3PDmaChannel sendChannel;
+static uint8_t* histSlot[TRIG_SLOTS_MAX];
+static uint32_t histStart[TRIG_SLOTS_MAX];  // sample index of first sample in slot
+static uint16_t histCount[TRIG_SLOTS_MAX];  // samples in slot
+static uint32_t histTicks[TRIG_SLOTS_MAX];  // timerTicks gpif completed slot
+static uint8_t histFlags[TRIG_SLOTS_MAX];   // ANALYSER_FLAG_ of slot
+static uint32_t histIn = 0;                 // slots filled, app thread
+static uint32_t histSent = 0;               // slots handed to usb, app thread
+volatile static uint32_t histOut = 0;       // slots consumed by usb, send dma callback
+static uint32_t windowNext = 0;             // sample index next sent
+static uint16_t lastSample = 0;             // edges across buffers
+/*}}}*/
+/*{{{  capture, free running, vendor 0xB2 wValue selects encoding, 0xB3 reads encodeStats*/
+// gpif to ep1 manual channel, cpu writes analyserHeader_t in front of each buffer, encodes it in place, commits
+// - gpif completion timestamped in the dma callback, app thread may get to the buffer later
+// - ANALYSER_RLE, run length, raw if that would not be smaller
+// - trigger mode ignores the encoding, its window is sent raw
+typedef struct encodeStats {
+  uint32_t buffers;   // buffers committed
+  uint32_t rle;       // buffers sent run length encoded, rest raw
+  uint32_t bytesIn;   // sample bytes captured
+  uint32_t bytesOut;  // payload bytes sent, headers excluded
+} encodeStats_t;
+
+static uint8_t encodeNext = ANALYSER_RAW;   // vendor 0xB2, setup callback
+static uint8_t encoding = ANALYSER_RAW;     // app thread copy, taken when channels are created
+static uint8_t* encodeBuffer = NULL;        // scratch, run records built here, copied over samples if smaller
+static encodeStats_t encodeStats;
+
+static uint32_t prodTicks[CAPTURE_COUNT];   // timerTicks gpif completed buffer, dma callback
+volatile static uint32_t prodIn = 0;        // buffers produced, dma callback
+static uint32_t prodOut = 0;                // buffers taken, app thread
+static uint32_t sequence = 0;               // next header sequence
+volatile static CyBool_t pibError = CyFalse;    // pib error since last header, pib callback
+volatile static CyBool_t pibOverrun = CyFalse;  // gpif thread write overrun since last header, samples dropped
+/*}}}*/
+/*{{{  decode, vendor 0xB6 programs analyserDecode_t, 0xB7 reads decodeStats*/
+// free running buffers run through each decoder before encoding, analyserEvent_t records to ep2 manual out channel
+// - decoder state carries across buffers, events carry the sample index since capture start
+// - eventsOnly discards the samples once decoded, long bus monitoring within usb 2.0 bandwidth
+// - decode runs at cpu speed, lower the sample rate with 0xB4 until gpif no longer reports GAP
+#define EVENT_SIZE  1024
+#define EVENT_COUNT 4
+
+#define UART_IDLE  0
+#define UART_START 1
+#define UART_DATA  2
+#define UART_STOP  3
+
+#define I2C_IDLE 0
+#define I2C_ADDR 1
+#define I2C_DATA 2
+
+typedef struct decodeState {
+  uint8_t  state;
+  uint8_t  bits;       // bits shifted in
+  uint8_t  shift;      // uart rx, spi mosi, i2c sda
+  uint8_t  shift1;     // spi miso
+  int32_t  countdown;  // uart, 1/256 samples to next bit sample point
+  uint16_t last;       // previous sample
+} decodeState_t;
+
+typedef struct decodeStats {
+  uint32_t events;     // events sent
+  uint32_t lost;       // events dropped, no free ep2 buffer
+  uint32_t buffers;    // event buffers committed
+} decodeStats_t;
+
+static analyserDecode_t decodeNext;         // vendor 0xB6, setup callback
+static analyserDecode_t decode;             // app thread copy, taken when channels are created
+static decodeState_t decodeState[ANALYSER_DECODERS];
+static CyBool_t decoding = CyFalse;         // any decoder programmed
+static uint32_t decodeSample = 0;           // sample index of next buffer since capture start
+static decodeStats_t decodeStats;
+
+static CyU3PDmaChannel eventChannel;
+static CyU3PDmaBuffer_t eventBuffer;        // buffer being filled, buffer NULL none
+static uint16_t eventBytes = 0;
+static uint32_t eventLost = 0;              // events dropped since the last ANALYSER_EVENT_LOST
+/*}}}*/
+/*{{{  sample rate, vendor 0xB4 sets pib clock divider, 0xB5 reads sampleRate_t*/
+// gpif READDATA takes a 16 bit sample every pib clock, pib clock is sysClk / clkDiv, clkDiv + 0.5 with halfDiv
+// - divider changed between captures, pib re-initialised with gpif stopped
+// - maxRate is what ep1 sustains raw at the current usb speed, run length encoding may sustain more
+#define SYS_CLK     403200000  // setSysClk400, 19.2MHz crystal
+#define PIB_DIV_MIN 4          // 100.8MHz, gpif II limit
+#define PIB_DIV_MAX 1024
+
+#define CAPTURE_BANDWIDTH_SS 200000000  // bytes/s ep1 sustains at super speed
+#define CAPTURE_BANDWIDTH_HS  24000000  // bytes/s ep1 sustains at high speed
+#define CAPTURE_BANDWIDTH_FS    800000  // bytes/s ep1 sustains at full speed
+
+typedef struct sampleRate {
+  uint16_t clkDiv;     // pib clock divider
+  uint8_t  halfDiv;    // divider is clkDiv + 0.5
+  uint8_t  reserved;
+  uint32_t rate;       // samples/s
+  uint32_t maxRate;    // samples/s ep1 sustains raw at current usb speed
+  uint16_t minClkDiv;  // smallest whole divider at or under maxRate
+  uint16_t reserved2;
+} sampleRate_t;
+
+static uint16_t pibDiv = 4;           // pib clock divider in use
+static CyBool_t pibHalf = CyFalse;
+static uint16_t pibDivNext = 4;       // vendor 0xB4, setup callback
+static CyBool_t pibHalfNext = CyFalse;
+/*}}}*/
 
 // button interrupt
 /*{{{*/
@@ -266,6 +462,653 @@ static void gpioInterruptCallback (uint8_t gpioId) {
 /*}}}*/
 
 // vid thread
+/*{{{*/
+static void captureDmaCallback (CyU3PDmaChannel* handle, CyU3PDmaCbType_t type, CyU3PDmaCBInput_t* input) {
+// gpif buffer produced, or window buffer consumed by usb, app thread scans, sends
+
+  if (type == CY_U3P_DMA_CB_PROD_EVENT)
+    prodTicks[prodIn++ % CAPTURE_COUNT] = timerTicks();
+  else if (type == CY_U3P_DMA_CB_CONS_EVENT)
+    histOut++;
+  CyU3PEventSet (&appEvent, CY_FX_USB_CAPTURE_EVENT, CYU3P_EVENT_OR);
+  }
+/*}}}*/
+/*{{{*/
+static void pibCallback (CyU3PPibIntrType cbType, uint16_t cbArg) {
+
+  if (cbType == CYU3P_PIB_INTR_ERROR) {
+    pibError = CyTrue;
+    uint16_t type = CYU3P_GET_PIB_ERROR_TYPE (cbArg);
+    if ((type >= CYU3P_PIB_ERR_THR0_WR_OVERRUN) && (type <= CYU3P_PIB_ERR_THR3_WR_OVERRUN))
+      pibOverrun = CyTrue;
+    }
+  }
+/*}}}*/
+/*{{{*/
+static uint32_t sampleRateHz() {
+// pib clock, one 16 bit sample each
+
+  return pibHalf ? (uint32_t)(((uint64_t)SYS_CLK * 2) / (pibDiv * 2 + 1)) : SYS_CLK / pibDiv;
+  }
+/*}}}*/
+/*{{{*/
+static uint8_t captureTake (uint32_t* ticks) {
+// completion ticks and flags of next gpif buffer taken, in production order
+// - GAP from the gpif thread overrun, not completion spacing, at 100MS/s a buffer fills in
+//   about 80us and callback jitter alone exceeds any tolerance that would still catch a short gap
+
+  uint8_t flags = 0;
+  *ticks = prodTicks[prodOut++ % CAPTURE_COUNT];
+
+  if (prodOut == 1)
+    flags |= ANALYSER_FLAG_FIRST;
+
+  if (pibOverrun) {
+    pibOverrun = CyFalse;
+    flags |= ANALYSER_FLAG_GAP;
+    }
+
+  if (pibError) {
+    pibError = CyFalse;
+    flags |= ANALYSER_FLAG_PIB;
+    }
+
+  return flags;
+  }
+/*}}}*/
+/*{{{*/
+static void pibInit() {
+// pib clock from pibDiv, pibHalf
+
+  CyU3PPibClock_t pibClock;
+  pibClock.clkDiv = pibDiv;
+  pibClock.clkSrc = CY_U3P_SYS_CLK;
+  pibClock.isDllEnable = CyFalse;
+  pibClock.isHalfDiv = pibHalf;
+  CyU3PPibInit (CyTrue, &pibClock);
+  }
+/*}}}*/
+/*{{{*/
+static void captureCreate() {
+// gpif to ep1 channel, free running, or through history slots when a trigger is programmed
+
+  // divider programmed since last capture, gpif stopped
+  if ((pibDivNext != pibDiv) || (pibHalfNext != pibHalf)) {
+    pibDiv = pibDivNext;
+    pibHalf = pibHalfNext;
+    CyU3PPibDeInit();
+    pibInit();
+    }
+
+  trigger = trigNext;
+  if (trigger.stages > TRIG_STAGES)
+    trigger.stages = TRIG_STAGES;
+  encoding = trigger.stages ? ANALYSER_RAW : encodeNext;
+  if (encoding != ANALYSER_RAW) {
+    encodeBuffer = (uint8_t*)CyU3PDmaBufferAlloc (CAPTURE_SIZE);
+    if (!encodeBuffer)
+      encoding = ANALYSER_RAW;
+    }
+
+  // decoders on free running capture only
+  decode = decodeNext;
+  decoding = CyFalse;
+  for (uint8_t i = 0; i < ANALYSER_DECODERS; i++) {
+    // host supplied bit numbers, a decoder using one past the 16 sample bits is turned off
+    analyserDecoder_t* decoder = &decode.decoder[i];
+    uint8_t maxBit = decoder->bit0;
+    if (decoder->type != ANALYSER_DECODE_UART)
+      maxBit = (decoder->bit1 > maxBit) ? decoder->bit1 : maxBit;
+    if (decoder->type == ANALYSER_DECODE_SPI) {
+      maxBit = (decoder->bit2 > maxBit) ? decoder->bit2 : maxBit;
+      if (decoder->bit3 != 0xFF)
+        maxBit = (decoder->bit3 > maxBit) ? decoder->bit3 : maxBit;
+      }
+    if ((decoder->type > ANALYSER_DECODE_I2C) || (maxBit >= 16))
+      decoder->type = ANALYSER_DECODE_NONE;
+
+    if (!trigger.stages && (decoder->type != ANALYSER_DECODE_NONE))
+      decoding = CyTrue;
+    }
+  CyU3PMemSet ((uint8_t*)decodeState, 0, sizeof(decodeState));
+  decodeSample = 0;
+  eventBuffer.buffer = NULL;
+  eventLost = 0;
+
+  prodIn = 0;
+  prodOut = 0;
+  sequence = 0;
+  pibError = CyFalse;
+  pibOverrun = CyFalse;
+
+  CyU3PMemSet ((uint8_t*)&trigStatus, 0, sizeof(trigStatus));
+  histIn = 0;
+  histSent = 0;
+  histOut = 0;
+  windowNext = 0;
+
+  CyU3PDmaChannelConfig_t dmaChannelConfig;
+  CyU3PMemSet ((uint8_t*)&dmaChannelConfig, 0, sizeof(dmaChannelConfig));
+  dmaChannelConfig.size  = CAPTURE_SIZE;
+  dmaChannelConfig.count = CAPTURE_COUNT;
+  dmaChannelConfig.prodSckId = CY_U3P_PIB_SOCKET_0;      // gpif pib0 producer
+  dmaChannelConfig.consSckId = CY_U3P_UIB_SOCKET_CONS_1; // ep1 consumer
+  dmaChannelConfig.dmaMode = CY_U3P_DMA_MODE_BYTE;
+  dmaChannelConfig.prodHeader = ANALYSER_HEADER_SIZE;
+  dmaChannelConfig.notification = CY_U3P_DMA_CB_PROD_EVENT;
+  dmaChannelConfig.cb = captureDmaCallback;
+
+  if (!trigger.stages) {
+    // header written, payload encoded in place by app thread
+    CyU3PDmaChannelCreate (&dmaChannel, CY_U3P_DMA_TYPE_MANUAL, &dmaChannelConfig);
+
+    if (decoding) {
+      // cpu fills event buffers, no callback, committed as decoded
+      CyU3PDmaChannelConfig_t eventConfig;
+      CyU3PMemSet ((uint8_t*)&eventConfig, 0, sizeof(eventConfig));
+      eventConfig.size  = EVENT_SIZE;
+      eventConfig.count = EVENT_COUNT;
+      eventConfig.prodSckId = CY_U3P_CPU_SOCKET_PROD;
+      eventConfig.consSckId = CY_U3P_UIB_SOCKET_CONS_2; // ep2 consumer
+      eventConfig.dmaMode = CY_U3P_DMA_MODE_BYTE;
+      CyU3PDmaChannelCreate (&eventChannel, CY_U3P_DMA_TYPE_MANUAL_OUT, &eventConfig);
+      CyU3PDmaChannelSetXfer (&eventChannel, 0);
+      }
+    }
+
+  else {
+    dmaChannelConfig.consSckId = CY_U3P_CPU_SOCKET_CONS;
+    CyU3PDmaChannelCreate (&dmaChannel, CY_U3P_DMA_TYPE_MANUAL_IN, &dmaChannelConfig);
+
+    // history slots from spare buffer heap, after the gpif channel took its buffers
+    uint32_t slots = bufferPlanSpare (CAPTURE_SIZE);
+    if (slots > TRIG_SLOTS_MAX)
+      slots = TRIG_SLOTS_MAX;
+    for (trigStatus.slots = 0; trigStatus.slots < slots; trigStatus.slots++) {
+      histSlot[trigStatus.slots] = (uint8_t*)CyU3PDmaBufferAlloc (CAPTURE_SIZE);
+      if (!histSlot[trigStatus.slots])
+        break;
+      }
+
+    // no buffers of its own, sends history slots with SetupSendBuffer
+    dmaChannelConfig.count = 0;
+    dmaChannelConfig.prodHeader = 0;
+    dmaChannelConfig.prodSckId = CY_U3P_CPU_SOCKET_PROD;
+    dmaChannelConfig.consSckId = CY_U3P_UIB_SOCKET_CONS_1;
+    dmaChannelConfig.notification = CY_U3P_DMA_CB_CONS_EVENT;
+    CyU3PDmaChannelCreate (&sendChannel, CY_U3P_DMA_TYPE_MANUAL_OUT, &dmaChannelConfig);
+
+    // two slots minimum, one filling while the oldest sends
+    trigStatus.state = (trigStatus.slots >= 2) ? TRIG_ARMED : TRIG_DONE;
+    }
+
+  CyU3PDmaChannelSetXfer (&dmaChannel, 0);
+
+  if (trigStatus.state != TRIG_DONE) {
+    CyU3PGpifLoad (&CyFxGpifConfig);
+    CyU3PGpifSMStart (START, ALPHA_START);
+    }
+  }
+/*}}}*/
+/*{{{*/
+static void captureDestroy() {
+
+  CyU3PDmaChannelDestroy (&dmaChannel);
+
+  if (decoding) {
+    CyU3PDmaChannelDestroy (&eventChannel);
+    decoding = CyFalse;
+    }
+
+  if (encodeBuffer) {
+    CyU3PDmaBufferFree (encodeBuffer);
+    encodeBuffer = NULL;
+    }
+
+  if (trigger.stages) {
+    CyU3PDmaChannelDestroy (&sendChannel);
+    for (uint32_t i = 0; i < trigStatus.slots; i++)
+      CyU3PDmaBufferFree (histSlot[i]);
+    trigStatus.slots = 0;
+    }
+  }
+/*}}}*/
+/*{{{*/
+static int32_t trigScan (const uint16_t* samples, uint32_t count) {
+// index of trigger sample in samples, -1 none yet, stage matched and last sample carry across buffers
+
+  const trigStage_t* stage = &trigger.stage[trigStatus.stage];
+  uint16_t last = lastSample;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t sample = samples[i];
+    uint16_t rose = sample & ~last;
+    uint16_t fell = last & ~sample;
+    last = sample;
+
+    if (((sample & stage->mask) == stage->value) &&
+        ((rose & stage->rise) == stage->rise) && ((fell & stage->fall) == stage->fall)) {
+      if (++trigStatus.stage == trigger.stages) {
+        lastSample = last;
+        return i;
+        }
+      stage++;
+      }
+    }
+
+  lastSample = last;
+  return -1;
+  }
+/*}}}*/
+/*{{{*/
+static void trigWindow (uint32_t triggerSample) {
+// window round trigger sample, pre trigger samples limited to the oldest history slot still held
+
+  uint32_t oldest = (histIn > trigStatus.slots) ? histIn - trigStatus.slots : 0;
+  uint32_t held = triggerSample - histStart[oldest % trigStatus.slots];
+
+  trigStatus.triggerSample = triggerSample;
+  uint32_t start = triggerSample - ((trigger.preSamples < held) ? trigger.preSamples : held);
+
+  // send from the slot holding the window start, slots after it are kept until sent
+  histSent = oldest;
+  while ((histSent < histIn - 1) && (histStart[(histSent + 1) % trigStatus.slots] <= start))
+    histSent++;
+  histOut = histSent;
+
+  // header in front of first send piece 32 byte aligned in its slot, like the dma buffers
+  uint32_t slotStart = histStart[histSent % trigStatus.slots];
+  windowNext = slotStart + ((start - slotStart) & ~0xF);
+  trigStatus.windowStart = windowNext;
+  trigStatus.windowEnd = triggerSample + trigger.postSamples;
+
+  trigStatus.state = TRIG_POST;
+  }
+/*}}}*/
+/*{{{*/
+static void trigSend() {
+// hand the next window piece of a history slot to usb, one outstanding
+
+  if ((histSent == histOut) && (histSent != histIn) && (windowNext < trigStatus.windowEnd)) {
+    uint32_t slot = histSent % trigStatus.slots;
+    uint32_t end = histStart[slot] + histCount[slot];
+    if (end > trigStatus.windowEnd)
+      end = trigStatus.windowEnd;
+
+    // header over samples before windowNext, or the header space at the slot start
+    analyserHeader_t* header = (analyserHeader_t*)(histSlot[slot] + (windowNext - histStart[slot]) * 2);
+    header->encoding = ANALYSER_RAW;
+    header->flags = histFlags[slot] | ((windowNext == trigStatus.windowStart) ? ANALYSER_FLAG_FIRST : 0);
+    header->length = (end - windowNext) * 2;
+    header->sequence = sequence;
+    header->timestamp = histTicks[slot];
+    header->samples = end - windowNext;
+
+    CyU3PDmaBuffer_t buffer;
+    buffer.buffer = (uint8_t*)header;
+    buffer.count  = header->length + ANALYSER_HEADER_SIZE;
+    buffer.size   = (buffer.count + 15) & ~15;
+    buffer.status = 0;
+    if (CyU3PDmaChannelSetupSendBuffer (&sendChannel, &buffer) == CY_U3P_SUCCESS) {
+      histSent++;
+      sequence++;
+      windowNext = end;
+      }
+    }
+  }
+/*}}}*/
+/*{{{*/
+static void trigCapture() {
+// gpif buffers copied into history slots, scanned while armed, window sent once triggered
+// - after the trigger a slot is only refilled once usb has consumed it, else the gpif buffer is held
+
+  while ((trigStatus.state == TRIG_ARMED) || (trigStatus.state == TRIG_POST)) {
+    if ((trigStatus.state == TRIG_POST) && (histIn - histOut >= trigStatus.slots)) {
+      trigStatus.stalls++;
+      break;
+      }
+
+    CyU3PDmaBuffer_t buffer;
+    if (CyU3PDmaChannelGetBuffer (&dmaChannel, &buffer, CYU3P_NO_WAIT) != CY_U3P_SUCCESS)
+      break;
+
+    uint32_t count = buffer.count / 2;
+    uint32_t ticks;
+    uint8_t flags = captureTake (&ticks);
+    int32_t hit = -1;
+    if (trigStatus.state == TRIG_ARMED) {
+      if (trigStatus.scanned == 0)
+        lastSample = ((uint16_t*)buffer.buffer)[0];
+      hit = trigScan ((uint16_t*)buffer.buffer, count);
+      }
+
+    // armed with no pre trigger samples, only the trigger buffer is kept
+    uint32_t slot = histIn % trigStatus.slots;
+    if ((trigStatus.state == TRIG_POST) || trigger.preSamples || (hit >= 0))
+      CyU3PMemCopy (histSlot[slot] + ANALYSER_HEADER_SIZE, buffer.buffer, buffer.count);
+    histStart[slot] = trigStatus.scanned;
+    histCount[slot] = count;
+    histTicks[slot] = ticks;
+    histFlags[slot] = flags & ~ANALYSER_FLAG_FIRST;
+    histIn++;
+
+    if (hit >= 0)
+      trigWindow (trigStatus.scanned + hit);
+
+    trigStatus.scanned += count;
+    CyU3PDmaChannelDiscardBuffer (&dmaChannel);
+
+    if ((trigStatus.state == TRIG_POST) && (trigStatus.scanned >= trigStatus.windowEnd))
+      // window complete, no more samples needed
+      break;
+    }
+
+  if (trigStatus.state == TRIG_POST) {
+    trigSend();
+    if ((windowNext >= trigStatus.windowEnd) && (histOut == histSent)) {
+      trigStatus.state = TRIG_DONE;
+      CyU3PGpifDisable (CyFalse);
+      line2 ("triggered");
+      }
+    }
+  }
+/*}}}*/
+
+/*{{{*/
+static void sampleRateFill (sampleRate_t* sampleRate) {
+// actual sample rate of pib clock divider, fastest rate usb speed sustains
+
+  uint32_t bandwidth = CAPTURE_BANDWIDTH_FS;
+  switch (CyU3PUsbGetSpeed()) {
+    case CY_U3P_SUPER_SPEED: bandwidth = CAPTURE_BANDWIDTH_SS; break;
+    case CY_U3P_HIGH_SPEED:  bandwidth = CAPTURE_BANDWIDTH_HS; break;
+    default: break;
+    }
+
+  CyU3PMemSet ((uint8_t*)sampleRate, 0, sizeof(sampleRate_t));
+  sampleRate->clkDiv = pibDiv;
+  sampleRate->halfDiv = pibHalf;
+  sampleRate->rate = sampleRateHz();
+  sampleRate->maxRate = bandwidth / 2;
+
+  uint32_t minClkDiv = (SYS_CLK + sampleRate->maxRate - 1) / sampleRate->maxRate;
+  sampleRate->minClkDiv = (minClkDiv < PIB_DIV_MIN) ? PIB_DIV_MIN : (minClkDiv > PIB_DIV_MAX) ? PIB_DIV_MAX : minClkDiv;
+  }
+/*}}}*/
+/*{{{*/
+static uint32_t encodeRle (const uint16_t* samples, uint32_t count, analyserRun_t* runs, uint32_t maxBytes) {
+// run records of samples, bytes written, 0 once they would not fit under maxBytes
+
+  uint32_t maxRuns = maxBytes / sizeof(analyserRun_t);
+  uint32_t used = 0;
+
+  uint32_t i = 0;
+  while (i < count) {
+    if (used == maxRuns)
+      return 0;
+
+    uint16_t value = samples[i];
+    uint32_t run = 1;
+    while ((i + run < count) && (samples[i + run] == value) && (run < 0xFFFF))
+      run++;
+
+    runs[used].value = value;
+    runs[used].run = run;
+    used++;
+    i += run;
+    }
+
+  return used * sizeof(analyserRun_t);
+  }
+/*}}}*/
+/*{{{*/
+static void eventFlush() {
+// commit filled event buffer to ep2
+
+  if (eventBuffer.buffer && eventBytes) {
+    CyU3PDmaChannelCommitBuffer (&eventChannel, eventBytes, 0);
+    decodeStats.buffers++;
+    }
+  eventBuffer.buffer = NULL;
+  }
+/*}}}*/
+/*{{{*/
+static void eventReset() {
+// drop queued events after ep2 halt cleared, decoders and sample count carry on
+
+  if (decoding) {
+    CyU3PDmaChannelReset (&eventChannel);
+    CyU3PDmaChannelSetXfer (&eventChannel, 0);
+    eventBuffer.buffer = NULL;
+    }
+  }
+/*}}}*/
+/*{{{*/
+static void eventPut (uint8_t decoder, uint8_t type, uint16_t data, uint32_t sample) {
+// add event record, dropped and counted if host is not reading ep2
+
+  if (!eventBuffer.buffer) {
+    if (CyU3PDmaChannelGetBuffer (&eventChannel, &eventBuffer, CYU3P_NO_WAIT) != CY_U3P_SUCCESS) {
+      eventBuffer.buffer = NULL;
+      eventLost++;
+      decodeStats.lost++;
+      return;
+      }
+    eventBytes = 0;
+
+    if (eventLost) {
+      analyserEvent_t* lost = (analyserEvent_t*)eventBuffer.buffer;
+      lost->sample = sample;
+      lost->decoder = decoder;
+      lost->type = ANALYSER_EVENT_LOST;
+      lost->data = (eventLost > 0xFFFF) ? 0xFFFF : eventLost;
+      eventBytes = sizeof(analyserEvent_t);
+      eventLost = 0;
+      }
+    }
+
+  analyserEvent_t* event = (analyserEvent_t*)(eventBuffer.buffer + eventBytes);
+  event->sample = sample;
+  event->decoder = decoder;
+  event->type = type;
+  event->data = data;
+  eventBytes += sizeof(analyserEvent_t);
+  decodeStats.events++;
+
+  if (eventBytes + sizeof(analyserEvent_t) > EVENT_SIZE)
+    eventFlush();
+  }
+/*}}}*/
+/*{{{*/
+static void decodeUart (uint8_t index, const uint16_t* samples, uint32_t count) {
+// 8N1, falling edge starts, each bit sampled at its middle
+
+  const analyserDecoder_t* decoder = &decode.decoder[index];
+  decodeState_t* st = &decodeState[index];
+  uint16_t rx = 1 << decoder->bit0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t sample = samples[i];
+
+    if (st->state == UART_IDLE) {
+      if ((st->last & rx) && !(sample & rx)) {
+        st->state = UART_START;
+        st->countdown = decoder->bitSamples / 2;
+        }
+      }
+
+    else {
+      st->countdown -= 256;
+      if (st->countdown <= 0) {
+        st->countdown += decoder->bitSamples;
+        uint8_t bit = (sample & rx) != 0;
+
+        if (st->state == UART_START) {
+          // glitch, not a start bit
+          st->state = bit ? UART_IDLE : UART_DATA;
+          st->bits = 0;
+          st->shift = 0;
+          }
+        else if (st->state == UART_DATA) {
+          st->shift |= bit << st->bits;
+          if (++st->bits == 8)
+            st->state = UART_STOP;
+          }
+        else {
+          eventPut (index, bit ? ANALYSER_EVENT_UART : ANALYSER_EVENT_UART_ERR, st->shift, decodeSample + i);
+          st->state = UART_IDLE;
+          }
+        }
+      }
+
+    st->last = sample;
+    }
+  }
+/*}}}*/
+/*{{{*/
+static void decodeSpi (uint8_t index, const uint16_t* samples, uint32_t count) {
+// bits shifted on the clock edge the mode samples on, cs high resets the byte
+
+  const analyserDecoder_t* decoder = &decode.decoder[index];
+  decodeState_t* st = &decodeState[index];
+  uint16_t clk = 1 << decoder->bit0;
+  uint16_t mosi = 1 << decoder->bit1;
+  uint16_t miso = 1 << decoder->bit2;
+  uint16_t cs = (decoder->bit3 < 16) ? 1 << decoder->bit3 : 0;
+
+  // modes 0, 3 sample on rising clock, 1, 2 on falling
+  CyBool_t rising = ((decoder->mode >> 1) & 1) == (decoder->mode & 1);
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t sample = samples[i];
+    uint16_t last = st->last;
+    st->last = sample;
+
+    if (sample & cs) {
+      if (!(last & cs)) {
+        eventPut (index, ANALYSER_EVENT_SPI_END, st->bits, decodeSample + i);
+        st->bits = 0;
+        }
+      continue;
+      }
+
+    if (rising ? (sample & ~last & clk) : (last & ~sample & clk)) {
+      st->shift = (st->shift << 1) | ((sample & mosi) != 0);
+      st->shift1 = (st->shift1 << 1) | ((sample & miso) != 0);
+      if (++st->bits == 8) {
+        eventPut (index, ANALYSER_EVENT_SPI, st->shift | (st->shift1 << 8), decodeSample + i);
+        st->bits = 0;
+        }
+      }
+    }
+  }
+/*}}}*/
+/*{{{*/
+static void decodeI2c (uint8_t index, const uint16_t* samples, uint32_t count) {
+// sda edges with scl high are start, stop, sda sampled on scl rising, ninth bit ack
+
+  const analyserDecoder_t* decoder = &decode.decoder[index];
+  decodeState_t* st = &decodeState[index];
+  uint16_t scl = 1 << decoder->bit0;
+  uint16_t sda = 1 << decoder->bit1;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t sample = samples[i];
+    uint16_t last = st->last;
+    st->last = sample;
+
+    if (sample & last & scl) {
+      if ((last & sda) && !(sample & sda)) {
+        eventPut (index, ANALYSER_EVENT_I2C_START, 0, decodeSample + i);
+        st->state = I2C_ADDR;
+        st->bits = 0;
+        }
+      else if (!(last & sda) && (sample & sda) && (st->state != I2C_IDLE)) {
+        eventPut (index, ANALYSER_EVENT_I2C_STOP, 0, decodeSample + i);
+        st->state = I2C_IDLE;
+        }
+      }
+
+    else if ((sample & ~last & scl) && (st->state != I2C_IDLE)) {
+      if (st->bits < 8) {
+        st->shift = (st->shift << 1) | ((sample & sda) != 0);
+        st->bits++;
+        }
+      else {
+        eventPut (index, (st->state == I2C_ADDR) ? ANALYSER_EVENT_I2C_ADDR : ANALYSER_EVENT_I2C_DATA,
+                  st->shift | ((sample & sda) ? 0x100 : 0), decodeSample + i);
+        st->state = I2C_DATA;
+        st->bits = 0;
+        }
+      }
+    }
+  }
+/*}}}*/
+/*{{{*/
+static void decodeBuffer (const uint16_t* samples, uint32_t count) {
+// run each programmed decoder over buffer, flush events so they reach the host with the buffer
+
+  if (decodeSample == 0)
+    for (uint8_t i = 0; i < ANALYSER_DECODERS; i++)
+      decodeState[i].last = samples[0];
+
+  for (uint8_t i = 0; i < ANALYSER_DECODERS; i++)
+    switch (decode.decoder[i].type) {
+      case ANALYSER_DECODE_UART: decodeUart (i, samples, count); break;
+      case ANALYSER_DECODE_SPI:  decodeSpi (i, samples, count); break;
+      case ANALYSER_DECODE_I2C:  decodeI2c (i, samples, count); break;
+      default: break;
+      }
+
+  decodeSample += count;
+  eventFlush();
+  }
+/*}}}*/
+
+/*{{{*/
+static void captureCommit() {
+// header in front of each gpif buffer, payload encoded in place if that pays, commit to ep1
+
+  CyU3PDmaBuffer_t buffer;
+  while (CyU3PDmaChannelGetBuffer (&dmaChannel, &buffer, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
+    if (decoding) {
+      decodeBuffer ((uint16_t*)buffer.buffer, buffer.count / 2);
+      if (decode.eventsOnly) {
+        // keep timestamp and gap bookkeeping in step, samples not sent
+        uint32_t ticks;
+        captureTake (&ticks);
+        sequence++;
+        CyU3PDmaChannelDiscardBuffer (&dmaChannel);
+        continue;
+        }
+      }
+
+    analyserHeader_t* header = (analyserHeader_t*)(buffer.buffer - ANALYSER_HEADER_SIZE);
+    header->encoding = ANALYSER_RAW;
+    header->flags = captureTake (&header->timestamp);
+    header->length = buffer.count;
+    header->sequence = sequence++;
+    header->samples = buffer.count / 2;
+
+    if (encoding == ANALYSER_RLE) {
+      // must be smaller than raw to pay for the decode
+      uint32_t bytes = encodeRle ((uint16_t*)buffer.buffer, header->samples, (analyserRun_t*)encodeBuffer, buffer.count - 1);
+      if (bytes) {
+        CyU3PMemCopy (buffer.buffer, encodeBuffer, bytes);
+        header->encoding = ANALYSER_RLE;
+        header->length = bytes;
+        encodeStats.rle++;
+        }
+      }
+
+    encodeStats.buffers++;
+    encodeStats.bytesIn += buffer.count;
+    encodeStats.bytesOut += header->length;
+    CyU3PDmaChannelCommitBuffer (&dmaChannel, header->length + ANALYSER_HEADER_SIZE, 0);
+    }
+  }
+/*}}}*/
+
 /*{{{*/
 static void appStart() {
 
@@ -289,23 +1132,17 @@ static void appStart() {
   epConfig.pcktSize = size;
   CyU3PSetEpConfig (CY_FX_EP_CONSUMER, &epConfig);
 
-  CyU3PUsbFlushEp (CY_FX_EP_CONSUMER);
-
-  CyU3PDmaChannelConfig_t dmaChannelConfig;
-  CyU3PMemSet ((uint8_t*)&dmaChannelConfig, 0, sizeof(dmaChannelConfig));
-  dmaChannelConfig.size  = 16384;
-  dmaChannelConfig.count = 4;
-  dmaChannelConfig.prodSckId = CY_U3P_PIB_SOCKET_0;      // gpif pib0 producer
-  dmaChannelConfig.consSckId = CY_U3P_UIB_SOCKET_CONS_1; // ep1 consumer
-  dmaChannelConfig.dmaMode = CY_U3P_DMA_MODE_BYTE;
-  CyU3PDmaChannelCreate (&dmaChannel, CY_U3P_DMA_TYPE_AUTO, &dmaChannelConfig);
-
-  CyU3PDmaChannelSetXfer (&dmaChannel, 0);
+  // events, one packet bursts
+  epConfig.burstLen = 1;
+  CyU3PSetEpConfig (CY_FX_EP_EVENTS, &epConfig);
 
-  CyU3PGpifLoad (&CyFxGpifConfig);
-  CyU3PGpifSMStart (START, ALPHA_START);
+  CyU3PUsbFlushEp (CY_FX_EP_CONSUMER);
+  CyU3PUsbFlushEp (CY_FX_EP_EVENTS);
 
+  CyU3PMutexGet (&captureMutex, CYU3P_WAIT_FOREVER);
+  captureCreate();
   appActive = CyTrue;
+  CyU3PMutexPut (&captureMutex);
   }
 /*}}}*/
 /*{{{*/
@@ -313,18 +1150,23 @@ static void appStop() {
 // RESET or DISCONNECT event is received from the USB host
 
   line2 ("appStop");
-  appActive = CyFalse;
 
+  // app thread may be mid commit on the channels
+  CyU3PMutexGet (&captureMutex, CYU3P_WAIT_FOREVER);
+  appActive = CyFalse;
   CyU3PGpifDisable (CyTrue);
-  CyU3PDmaChannelDestroy (&dmaChannel);
+  captureDestroy();
+  CyU3PMutexPut (&captureMutex);
 
   CyU3PUsbFlushEp (CY_FX_EP_CONSUMER);
+  CyU3PUsbFlushEp (CY_FX_EP_EVENTS);
 
   // Disable endpoints
   CyU3PEpConfig_t epConfig;
   CyU3PMemSet ((uint8_t*)&epConfig, 0, sizeof (epConfig));
   epConfig.enable = CyFalse;
   CyU3PSetEpConfig (CY_FX_EP_CONSUMER, &epConfig);
+  CyU3PSetEpConfig (CY_FX_EP_EVENTS, &epConfig);
   }
 /*}}}*/
 /*{{{*/
@@ -333,12 +1175,26 @@ static void appClear() {
 
   line2 ("appClear");
 
-  CyU3PDmaChannelReset (&dmaChannel);
-
   CyU3PUsbFlushEp (CY_FX_EP_CONSUMER);
   CyU3PUsbResetEp (CY_FX_EP_CONSUMER);
+  CyU3PUsbFlushEp (CY_FX_EP_EVENTS);
+  CyU3PUsbResetEp (CY_FX_EP_EVENTS);
 
-  CyU3PDmaChannelSetXfer (&dmaChannel, 0);
+  // app thread recreates capture channels, sequence restarts, trigger rearmed
+  CyU3PEventSet (&appEvent, CY_FX_USB_TRIGGER_EVENT, CYU3P_EVENT_OR);
+  }
+/*}}}*/
+/*{{{*/
+static void appClearEvents() {
+// CLEAR FEATURE ep2, capture carries on
+
+  line2 ("appClearEvents");
+
+  CyU3PUsbFlushEp (CY_FX_EP_EVENTS);
+  CyU3PUsbResetEp (CY_FX_EP_EVENTS);
+
+  // app thread resets event channel
+  CyU3PEventSet (&appEvent, CY_FX_USB_EVENTS_EVENT, CYU3P_EVENT_OR);
   }
 /*}}}*/
 
@@ -418,6 +1274,89 @@ static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
         line2 ("vStream");
         CyU3PUsbGetEP0Data (wLength, glEp0Buffer, NULL);
 
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB0:
+        /*{{{  program trigger_t and arm, no data free running*/
+        CyU3PMemSet ((uint8_t*)&trigNext, 0, sizeof(trigNext));
+        if (wLength) {
+          CyU3PUsbGetEP0Data (wLength, glEp0Buffer, NULL);
+          CyU3PMemCopy ((uint8_t*)&trigNext, glEp0Buffer, (wLength < sizeof(trigNext)) ? wLength : sizeof(trigNext));
+          }
+        else
+          CyU3PUsbAckSetup();
+
+        CyU3PEventSet (&appEvent, CY_FX_USB_TRIGGER_EVENT, CYU3P_EVENT_OR);
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB1:
+        /*{{{  read trigStatus_t*/
+        CyU3PMemCopy (glEp0Buffer, (uint8_t*)&trigStatus, sizeof(trigStatus));
+        CyU3PUsbSendEP0Data ((wLength < sizeof(trigStatus)) ? wLength : sizeof(trigStatus), glEp0Buffer);
+
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB2:
+        /*{{{  set encoding wValue, ANALYSER_RAW, ANALYSER_RLE*/
+        encodeNext = (wValue == ANALYSER_RLE) ? ANALYSER_RLE : ANALYSER_RAW;
+        CyU3PUsbAckSetup();
+
+        CyU3PEventSet (&appEvent, CY_FX_USB_TRIGGER_EVENT, CYU3P_EVENT_OR);
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB3:
+        /*{{{  read encodeStats_t, wValue != 0 reset after read*/
+        CyU3PMemCopy (glEp0Buffer, (uint8_t*)&encodeStats, sizeof(encodeStats));
+        CyU3PUsbSendEP0Data ((wLength < sizeof(encodeStats)) ? wLength : sizeof(encodeStats), glEp0Buffer);
+        if (wValue)
+          CyU3PMemSet ((uint8_t*)&encodeStats, 0, sizeof(encodeStats));
+
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB4:
+        /*{{{  set pib clock divider wValue, wIndex 1 adds half*/
+        pibDivNext = (wValue < PIB_DIV_MIN) ? PIB_DIV_MIN : (wValue > PIB_DIV_MAX) ? PIB_DIV_MAX : wValue;
+        pibHalfNext = (wIndex & 1) && (pibDivNext < PIB_DIV_MAX);
+        CyU3PUsbAckSetup();
+
+        CyU3PEventSet (&appEvent, CY_FX_USB_TRIGGER_EVENT, CYU3P_EVENT_OR);
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB5:
+        /*{{{  read sampleRate_t*/
+        sampleRateFill ((sampleRate_t*)glEp0Buffer);
+        CyU3PUsbSendEP0Data ((wLength < sizeof(sampleRate_t)) ? wLength : sizeof(sampleRate_t), glEp0Buffer);
+
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB6:
+        /*{{{  program analyserDecode_t, no data decoders off*/
+        CyU3PMemSet ((uint8_t*)&decodeNext, 0, sizeof(decodeNext));
+        if (wLength) {
+          CyU3PUsbGetEP0Data (wLength, glEp0Buffer, NULL);
+          CyU3PMemCopy ((uint8_t*)&decodeNext, glEp0Buffer, (wLength < sizeof(decodeNext)) ? wLength : sizeof(decodeNext));
+          }
+        else
+          CyU3PUsbAckSetup();
+
+        CyU3PEventSet (&appEvent, CY_FX_USB_TRIGGER_EVENT, CYU3P_EVENT_OR);
+        isHandled = CyTrue;
+        break;
+        /*}}}*/
+      case 0xB7:
+        /*{{{  read decodeStats_t, wValue != 0 reset after read*/
+        CyU3PMemCopy (glEp0Buffer, (uint8_t*)&decodeStats, sizeof(decodeStats));
+        CyU3PUsbSendEP0Data ((wLength < sizeof(decodeStats)) ? wLength : sizeof(decodeStats), glEp0Buffer);
+        if (wValue)
+          CyU3PMemSet ((uint8_t*)&decodeStats, 0, sizeof(decodeStats));
+
         isHandled = CyTrue;
         break;
         /*}}}*/
@@ -466,8 +1405,11 @@ static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
       line2 ("clear feature");
 
       if (appActive) {
-        if (wIndex == CY_FX_EP_CONSUMER) {
-          appClear();
+        if ((wIndex == CY_FX_EP_CONSUMER) || (wIndex == CY_FX_EP_EVENTS)) {
+          if (wIndex == CY_FX_EP_CONSUMER)
+            appClear();
+          else
+            appClearEvents();
           CyU3PUsbStall (wIndex, CyFalse, CyTrue);
           CyU3PUsbAckSetup();
 
@@ -520,12 +1462,13 @@ static void debugInit() {
 static void gpioInit() {
 
   CyU3PGpioClock_t gpioClock;
-  gpioClock.fastClkDiv = 2;
+  gpioClock.fastClkDiv = TIMER_FAST_CLK_DIV;
   gpioClock.slowClkDiv = 2;
   gpioClock.simpleDiv  = CY_U3P_GPIO_SIMPLE_DIV_BY_2;
   gpioClock.clkSrc     = CY_U3P_SYS_CLK;
   gpioClock.halfDiv    = 0;
   CyU3PGpioInit (&gpioClock, gpioInterruptCallback);
+  timerInit();
 
   // Confige BUTTON_GPIO to trigger interrupt on falling edge
   CyU3PDeviceGpioOverride (BUTTON_GPIO, CyTrue);
@@ -557,14 +1500,9 @@ static void gpioInit() {
 static void appInit() {
 
   CyU3PEventCreate (&appEvent);
-  /*{{{  init P-port*/
-  CyU3PPibClock_t pibClock;
-  pibClock.clkDiv = 4;
-  pibClock.clkSrc = CY_U3P_SYS_CLK;
-  pibClock.isDllEnable = CyFalse;
-  pibClock.isHalfDiv = CyFalse;
-  CyU3PPibInit (CyTrue, &pibClock);
-  /*}}}*/
+  CyU3PMutexCreate (&captureMutex, CYU3P_INHERIT);
+  pibInit();
+  CyU3PPibRegisterCallback (pibCallback, CYU3P_PIB_INTR_ERROR);
 
   sensorInit();
 
@@ -634,12 +1572,33 @@ static void appThreadFunc (uint32_t input) {
       }
 
     uint32_t eventFlag;
-    if (CyU3PEventGet (&appEvent, CY_FX_USB_BUTTON_DOWN_EVENT | CY_FX_USB_BUTTON_UP_EVENT,
+    if (CyU3PEventGet (&appEvent, CY_FX_USB_BUTTON_DOWN_EVENT | CY_FX_USB_BUTTON_UP_EVENT |
+                                  CY_FX_USB_CAPTURE_EVENT | CY_FX_USB_TRIGGER_EVENT | CY_FX_USB_EVENTS_EVENT,
                        CYU3P_EVENT_OR_CLEAR, &eventFlag, CYU3P_WAIT_FOREVER) == CY_U3P_SUCCESS) {
       if (eventFlag & CY_FX_USB_BUTTON_DOWN_EVENT)
         sensorButton (1);
       if (eventFlag & CY_FX_USB_BUTTON_UP_EVENT)
         sensorButton (0);
+
+      CyU3PMutexGet (&captureMutex, CYU3P_WAIT_FOREVER);
+      if ((eventFlag & CY_FX_USB_TRIGGER_EVENT) && appActive) {
+        /*{{{  trigger, encoding or sample rate programmed, or rearmed, recreate capture*/
+        CyU3PGpifDisable (CyTrue);
+        captureDestroy();
+        CyU3PUsbFlushEp (CY_FX_EP_CONSUMER);
+        CyU3PUsbFlushEp (CY_FX_EP_EVENTS);
+        captureCreate();
+        }
+        /*}}}*/
+      else if ((eventFlag & CY_FX_USB_EVENTS_EVENT) && appActive)
+        eventReset();
+      if ((eventFlag & CY_FX_USB_CAPTURE_EVENT) && appActive) {
+        if (trigger.stages)
+          trigCapture();
+        else
+          captureCommit();
+        }
+      CyU3PMutexPut (&captureMutex);
       }
     }
   }
@@ -696,7 +1655,7 @@ int main() {
   io_cfg.gpioSimpleEn[0]  = 0;
   io_cfg.gpioSimpleEn[1]  = 0;
   io_cfg.gpioComplexEn[0] = 0;
-  io_cfg.gpioComplexEn[1] = 0;
+  io_cfg.gpioComplexEn[1] = 1 << (TIMER_GPIO - 32); // timestamp timer
   CyU3PDeviceConfigureIOMatrix (&io_cfg);
 
   CyU3PKernelEntry();
@@ -0,0 +1,1764 @@
+// cyu3sim.c - host model of the cyu3 sdk calls usbUVC makes, pthreads for the rtos
+// - manual many to one dma, buffers per producer socket, cpu takes them in socket order
+// - gpif producer thread, free running sensor, frame valid at each sensor frame start once armed,
+//   buffers paced at the gpif byte rate, end of frame interrupt with the designer end states,
+//   no free buffer is a pib overrun, sensor data lost till one frees
+// - host thread reads ep3 transfers in commit order at host bandwidth, latency, stalls,
+//   consumed buffers go back to their producer socket
+// - firmware dma, gpif, pib callbacks made holding the model lock, atomic against the firmware's
+//   sdk calls as an interrupt is on the device
+// - ep0 control requests from the harness through the registered setup callback
+// - sim time stops while the host vm stalls every thread at once, steal thread measures it
+//{{{  includes
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cyu3system.h>
+#include <cyu3os.h>
+#include <cyu3dma.h>
+#include <cyu3usb.h>
+#include <cyu3gpif.h>
+#include <cyu3gpio.h>
+#include <cyu3pib.h>
+
+#include "sim.h"
+//}}}
+
+simConfig_t simConfig = { CY_U3P_SUPER_SPEED, 0x38000, 0, 350000000, 20, 0, 0, 0, 0 };
+simCounters_t simCounters;
+uint32_t simFrameBytes[SIM_FRAME_TAGS];
+CyBool_t simFrameOverrun[SIM_FRAME_TAGS];
+
+extern void CyFxApplicationDefine();
+
+// time
+//{{{
+static uint64_t monoNs() {
+
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  }
+//}}}
+#define STEAL_TICK_NS 200000  // steal thread wake period
+#define STEAL_MIN_NS  300000  // later than this, the vm was not running us
+
+static uint64_t epochNs = 0;
+static uint64_t stolenNs = 0;  // vm stalls, taken out of sim time
+static uint64_t lastNs = 0;    // sim time never goes back when a stall is counted after others read the clock
+static pthread_once_t epochOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t timeMutex = PTHREAD_MUTEX_INITIALIZER;
+//{{{
+static void* stealThread (void* arg) {
+// a wake far later than asked for, with the sim using little cpu, is time no thread ran
+
+  for (;;) {
+    uint64_t deadline = monoNs() + STEAL_TICK_NS;
+    struct timespec ts = { deadline / 1000000000ull, deadline % 1000000000ull };
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+
+    uint64_t late = monoNs() - deadline;
+    if (late > STEAL_MIN_NS) {
+      pthread_mutex_lock (&timeMutex);
+      stolenNs += late;
+      simCounters.stolenNs += late;
+      pthread_mutex_unlock (&timeMutex);
+      }
+    }
+
+  return NULL;
+  }
+//}}}
+//{{{
+static void epochInit() {
+
+  epochNs = monoNs();
+
+  pthread_t id;
+  pthread_create (&id, NULL, stealThread, NULL);
+  }
+//}}}
+//{{{
+uint64_t simNowNs() {
+
+  pthread_once (&epochOnce, epochInit);
+
+  pthread_mutex_lock (&timeMutex);
+  uint64_t ns = monoNs() - epochNs - stolenNs;
+  if (ns < lastNs)
+    ns = lastNs;
+  lastNs = ns;
+  pthread_mutex_unlock (&timeMutex);
+  return ns;
+  }
+//}}}
+//{{{
+static struct timespec absTime (uint64_t ns) {
+// sim time to CLOCK_MONOTONIC timespec, for the stall time counted so far
+
+  pthread_once (&epochOnce, epochInit);
+  pthread_mutex_lock (&timeMutex);
+  ns += epochNs + stolenNs;
+  pthread_mutex_unlock (&timeMutex);
+
+  struct timespec ts;
+  ts.tv_sec = ns / 1000000000ull;
+  ts.tv_nsec = ns % 1000000000ull;
+  return ts;
+  }
+//}}}
+//{{{
+void simSleepUntil (uint64_t ns) {
+// again if a stall was counted meanwhile
+
+  while (simNowNs() < ns) {
+    struct timespec ts = absTime (ns);
+    clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+  }
+//}}}
+//{{{
+static void condInit (pthread_cond_t* cond) {
+
+  pthread_condattr_t attr;
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (cond, &attr);
+  pthread_condattr_destroy (&attr);
+  }
+//}}}
+//{{{
+static int condWaitUntil (pthread_cond_t* cond, pthread_mutex_t* mutex, uint64_t ns) {
+// 0 signalled, nonzero timed out
+
+  struct timespec ts = absTime (ns);
+  return pthread_cond_timedwait (cond, mutex, &ts);
+  }
+//}}}
+//{{{
+static uint64_t waitDeadline (uint32_t wait) {
+// os timeout in ms to sim time
+
+  return simNowNs() + (uint64_t)wait * 1000000ull;
+  }
+//}}}
+
+// os
+//{{{
+typedef struct simThread {
+  CyU3PThreadEntry_t entry;
+  uint32_t input;
+  } simThread_t;
+
+static void* threadMain (void* arg) {
+
+  simThread_t* thread = (simThread_t*)arg;
+  thread->entry (thread->input);
+  return NULL;
+  }
+//}}}
+//{{{
+uint32_t CyU3PThreadCreate (CyU3PThread* thread, char* name, CyU3PThreadEntry_t entry, uint32_t input,
+                            void* stack, uint32_t stackSize, uint32_t priority, uint32_t threshold,
+                            uint32_t timeSlice, uint32_t autoStart) {
+// priorities not modelled, every thread runs on its own host thread
+
+  simThread_t* simThread = calloc (1, sizeof(simThread_t));
+  simThread->entry = entry;
+  simThread->input = input;
+  thread->sim = simThread;
+
+  pthread_t id;
+  if (pthread_create (&id, NULL, threadMain, simThread))
+    return CY_U3P_ERROR_FAILURE;
+  pthread_detach (id);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void CyU3PThreadRelinquish() {
+  sched_yield();
+  }
+//}}}
+//{{{
+uint32_t CyU3PThreadSleep (uint32_t ms) {
+
+  simSleepUntil (waitDeadline (ms));
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+
+//{{{
+typedef struct simEvent {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint32_t flags;
+  } simEvent_t;
+//}}}
+//{{{
+uint32_t CyU3PEventCreate (CyU3PEvent* event) {
+
+  simEvent_t* simEvent = calloc (1, sizeof(simEvent_t));
+  pthread_mutex_init (&simEvent->mutex, NULL);
+  condInit (&simEvent->cond);
+  event->sim = simEvent;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+uint32_t CyU3PEventSet (CyU3PEvent* event, uint32_t flags, uint32_t option) {
+// CYU3P_EVENT_AND masks flags, CYU3P_EVENT_OR sets them
+
+  simEvent_t* simEvent = event->sim;
+  pthread_mutex_lock (&simEvent->mutex);
+  if (option & CYU3P_EVENT_AND)
+    simEvent->flags &= flags;
+  else
+    simEvent->flags |= flags;
+  pthread_cond_broadcast (&simEvent->cond);
+  pthread_mutex_unlock (&simEvent->mutex);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+uint32_t CyU3PEventGet (CyU3PEvent* event, uint32_t mask, uint32_t option, uint32_t* flags, uint32_t wait) {
+// threadx semantics, AND all mask bits, OR any, CLEAR clears the mask bits, flags gets all flags before clear
+
+  simEvent_t* simEvent = event->sim;
+  uint64_t deadline = waitDeadline (wait);
+
+  pthread_mutex_lock (&simEvent->mutex);
+  for (;;) {
+    CyBool_t got = (option & CYU3P_EVENT_AND) ? ((simEvent->flags & mask) == mask) : ((simEvent->flags & mask) != 0);
+    if (got) {
+      *flags = simEvent->flags;
+      if (option & 1)
+        simEvent->flags &= ~mask;
+      pthread_mutex_unlock (&simEvent->mutex);
+      return CY_U3P_SUCCESS;
+      }
+
+    if (wait == CYU3P_NO_WAIT)
+      break;
+    else if (wait == CYU3P_WAIT_FOREVER)
+      pthread_cond_wait (&simEvent->cond, &simEvent->mutex);
+    else if (condWaitUntil (&simEvent->cond, &simEvent->mutex, deadline))
+      break;
+    }
+
+  pthread_mutex_unlock (&simEvent->mutex);
+  return 0x07;  // TX_NO_EVENTS
+  }
+//}}}
+
+//{{{
+uint32_t CyU3PMutexCreate (CyU3PMutex* mutex, uint32_t inherit) {
+// threadx mutexes nest for their owner
+
+  pthread_mutex_t* simMutex = calloc (1, sizeof(pthread_mutex_t));
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init (&attr);
+  pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init (simMutex, &attr);
+  pthread_mutexattr_destroy (&attr);
+  mutex->sim = simMutex;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+uint32_t CyU3PMutexGet (CyU3PMutex* mutex, uint32_t wait) {
+
+  if (wait == CYU3P_NO_WAIT)
+    return pthread_mutex_trylock (mutex->sim) ? CY_U3P_ERROR_TIMEOUT : CY_U3P_SUCCESS;
+
+  pthread_mutex_lock (mutex->sim);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+uint32_t CyU3PMutexPut (CyU3PMutex* mutex) {
+
+  pthread_mutex_unlock (mutex->sim);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+uint32_t CyU3PMutexDestroy (CyU3PMutex* mutex) {
+
+  pthread_mutex_destroy (mutex->sim);
+  free (mutex->sim);
+  mutex->sim = NULL;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+
+//{{{
+typedef struct simQueue {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint8_t* mem;
+  uint32_t messageBytes;
+  uint32_t slots;
+  uint32_t in;
+  uint32_t out;
+  } simQueue_t;
+//}}}
+//{{{
+uint32_t CyU3PQueueCreate (CyU3PQueue* queue, uint32_t messageSize, void* mem, uint32_t queueSize) {
+// messageSize in 32 bit words, queueSize in bytes, threadx takes 1,2,4,8 or 16 word messages
+
+  if ((messageSize != 1) && (messageSize != 2) && (messageSize != 4) && (messageSize != 8) && (messageSize != 16))
+    return 0x05;  // TX_SIZE_ERROR
+  if (!mem || (queueSize < messageSize * 4))
+    return 0x05;
+
+  simQueue_t* simQueue = calloc (1, sizeof(simQueue_t));
+  pthread_mutex_init (&simQueue->mutex, NULL);
+  condInit (&simQueue->cond);
+  simQueue->mem = mem;
+  simQueue->messageBytes = messageSize * 4;
+  simQueue->slots = queueSize / simQueue->messageBytes;
+  queue->sim = simQueue;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+uint32_t CyU3PQueueSend (CyU3PQueue* queue, void* message, uint32_t wait) {
+
+  simQueue_t* simQueue = queue->sim;
+  uint64_t deadline = waitDeadline (wait);
+
+  pthread_mutex_lock (&simQueue->mutex);
+  while (simQueue->in - simQueue->out >= simQueue->slots) {
+    if ((wait == CYU3P_NO_WAIT) ||
+        ((wait != CYU3P_WAIT_FOREVER) && condWaitUntil (&simQueue->cond, &simQueue->mutex, deadline))) {
+      pthread_mutex_unlock (&simQueue->mutex);
+      return 0x0B;  // TX_QUEUE_FULL
+      }
+    if (wait == CYU3P_WAIT_FOREVER)
+      pthread_cond_wait (&simQueue->cond, &simQueue->mutex);
+    }
+
+  memcpy (simQueue->mem + (simQueue->in % simQueue->slots) * simQueue->messageBytes, message, simQueue->messageBytes);
+  simQueue->in++;
+  pthread_cond_broadcast (&simQueue->cond);
+  pthread_mutex_unlock (&simQueue->mutex);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+uint32_t CyU3PQueueReceive (CyU3PQueue* queue, void* message, uint32_t wait) {
+
+  simQueue_t* simQueue = queue->sim;
+  uint64_t deadline = waitDeadline (wait);
+
+  pthread_mutex_lock (&simQueue->mutex);
+  while (simQueue->in == simQueue->out) {
+    if ((wait == CYU3P_NO_WAIT) ||
+        ((wait != CYU3P_WAIT_FOREVER) && condWaitUntil (&simQueue->cond, &simQueue->mutex, deadline))) {
+      pthread_mutex_unlock (&simQueue->mutex);
+      return 0x0A;  // TX_QUEUE_EMPTY
+      }
+    if (wait == CYU3P_WAIT_FOREVER)
+      pthread_cond_wait (&simQueue->cond, &simQueue->mutex);
+    }
+
+  memcpy (message, simQueue->mem + (simQueue->out % simQueue->slots) * simQueue->messageBytes, simQueue->messageBytes);
+  simQueue->out++;
+  pthread_cond_broadcast (&simQueue->cond);
+  pthread_mutex_unlock (&simQueue->mutex);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+
+//{{{
+uint32_t CyU3PGetTime() {
+// 1ms os tick
+
+  return (uint32_t)(simNowNs() / 1000000ull);
+  }
+//}}}
+//{{{
+void CyU3PBusyWait (uint16_t us) {
+
+  simSleepUntil (simNowNs() + us * 1000ull);
+  }
+//}}}
+//{{{
+void CyU3PDebugPrint (uint8_t priority, char* message, ...) {
+
+  if (simConfig.verbose) {
+    va_list args;
+    va_start (args, message);
+    vprintf (message, args);
+    va_end (args);
+    }
+  }
+//}}}
+
+// memory
+//{{{
+void* CyU3PMemAlloc (uint32_t size) {
+  return malloc (size);
+  }
+//}}}
+//{{{
+void CyU3PMemFree (void* mem) {
+  free (mem);
+  }
+//}}}
+//{{{
+void CyU3PMemSet (uint8_t* ptr, uint8_t data, uint32_t count) {
+  memset (ptr, data, count);
+  }
+//}}}
+//{{{
+void CyU3PMemCopy (uint8_t* dest, uint8_t* src, uint32_t count) {
+  memmove (dest, src, count);
+  }
+//}}}
+//{{{
+int32_t CyU3PMemCmp (const void* s1, const void* s2, uint32_t count) {
+  return memcmp (s1, s2, count);
+  }
+//}}}
+
+//{{{  buffer heap, cache line aligned, a free cache line after each buffer as in cyfxtx.c
+#define HEAP_BLOCKS 256
+
+typedef struct heapBlock {
+  void* mem;
+  uint32_t bytes;
+  } heapBlock_t;
+
+static heapBlock_t heapBlock[HEAP_BLOCKS];
+static uint32_t heapUsed = 0;
+static pthread_mutex_t heapMutex = PTHREAD_MUTEX_INITIALIZER;
+//}}}
+//{{{
+void* CyU3PDmaBufferAlloc (uint16_t size) {
+
+  uint32_t bytes = ((size + 31) & ~31) + 32;
+
+  pthread_mutex_lock (&heapMutex);
+  void* mem = NULL;
+  if (heapUsed + bytes <= simConfig.heapBytes)
+    for (int i = 0; i < HEAP_BLOCKS; i++)
+      if (!heapBlock[i].mem) {
+        mem = aligned_alloc (32, bytes);
+        heapBlock[i].mem = mem;
+        heapBlock[i].bytes = bytes;
+        heapUsed += bytes;
+        break;
+        }
+  pthread_mutex_unlock (&heapMutex);
+
+  return mem;
+  }
+//}}}
+//{{{
+int CyU3PDmaBufferFree (void* buffer) {
+
+  pthread_mutex_lock (&heapMutex);
+  for (int i = 0; i < HEAP_BLOCKS; i++)
+    if (buffer && (heapBlock[i].mem == buffer)) {
+      heapUsed -= heapBlock[i].bytes;
+      heapBlock[i].mem = NULL;
+      free (buffer);
+      break;
+      }
+  pthread_mutex_unlock (&heapMutex);
+
+  return 0;
+  }
+//}}}
+//{{{
+void CyU3PBufGetFree (uint32_t* free_p, uint32_t* largest_p) {
+// model heap never fragments, largest block is all that is free
+
+  pthread_mutex_lock (&heapMutex);
+  *free_p = simConfig.heapBytes - heapUsed;
+  *largest_p = *free_p;
+  pthread_mutex_unlock (&heapMutex);
+  }
+//}}}
+
+// model lock, dma, gpif, ep3 state, recursive so consumer callbacks can call back into the model
+static pthread_mutex_t modelMutex;
+static pthread_cond_t modelCond;     // buffer freed, gpif armed or disabled, transfer queued
+static pthread_once_t modelOnce = PTHREAD_ONCE_INIT;
+//{{{
+static void modelInit() {
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init (&attr);
+  pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init (&modelMutex, &attr);
+  pthread_mutexattr_destroy (&attr);
+  condInit (&modelCond);
+  }
+//}}}
+//{{{
+void simLock() {
+
+  pthread_once (&modelOnce, modelInit);
+  pthread_mutex_lock (&modelMutex);
+  }
+//}}}
+//{{{
+void simUnlock() {
+  pthread_mutex_unlock (&modelMutex);
+  }
+//}}}
+
+//{{{  dma channels, static pool so a queued transfer never points at freed state
+#define CHANNELS    8
+#define BUFFERS_MAX 32
+
+#define BUFFER_FREE     0  // producer may fill
+#define BUFFER_FILLING  1  // gpif writing, partial until wrapped up
+#define BUFFER_PRODUCED 2  // waiting for cpu GetBuffer
+#define BUFFER_CPU      3  // held by cpu
+#define BUFFER_USB      4  // committed, waiting for host
+
+typedef struct simBuffer {
+  uint8_t* mem;
+  uint32_t count;
+  uint8_t state;
+  uint64_t doneNs;  // model time gpif wrote its last byte
+  uint64_t freeNs;  // model time it was freed, host bus time of its transfer's end
+  } simBuffer_t;
+
+typedef struct simChannel {
+  CyBool_t used;
+  CyBool_t multi;
+  void* handle;
+  CyU3PDmaCallback_t cb;
+  CyU3PDmaMultiCallback_t multiCb;
+  uint32_t notification;
+
+  uint32_t size;
+  uint32_t count;
+  uint32_t header;
+  uint32_t footer;
+  uint32_t sockets;                  // producer sockets
+  CyU3PDmaSocketId_t prodSck[2];
+  CyU3PDmaSocketId_t consSck;
+
+  simBuffer_t buffer[2][BUFFERS_MAX];
+  uint32_t prodIndex[2];             // next buffer producer fills, each socket
+  uint32_t cpuIndex[2];              // next buffer cpu takes, each socket
+  uint32_t next;                     // socket cpu takes its next buffer from
+  CyBool_t cpuHeld;                  // GetBuffer buffer not yet committed or discarded
+
+  uint32_t gen;                      // bumped by reset, flush, destroy, queued transfers of older gen dropped
+  uint32_t commits;                  // since reset
+  uint32_t consumed;
+  } simChannel_t;
+
+static simChannel_t channels[CHANNELS];
+//}}}
+//{{{  ep3 and ep1 transfers, in commit order
+#define XFERS 512
+
+typedef struct simXfer {
+  simChannel_t* channel;
+  uint32_t gen;
+  uint8_t* data;
+  uint32_t length;
+  uint32_t socket;
+  uint32_t index;
+  CyBool_t uvc;     // ep3, harness checks payload
+  uint64_t readyNs;  // model time the host may start reading it
+  } simXfer_t;
+
+static simXfer_t xfers[XFERS];
+static uint32_t xferIn = 0;
+static uint32_t xferOut = 0;
+//}}}
+//{{{
+static simChannel_t* channelNew (void* handle, CyBool_t multi) {
+
+  for (int i = 0; i < CHANNELS; i++)
+    if (!channels[i].used) {
+      simChannel_t* channel = &channels[i];
+      uint32_t gen = channel->gen;
+      memset (channel, 0, sizeof(simChannel_t));
+      channel->gen = gen + 1;
+      channel->used = CyTrue;
+      channel->multi = multi;
+      channel->handle = handle;
+      return channel;
+      }
+
+  return NULL;
+  }
+//}}}
+//{{{
+static CyBool_t channelAlloc (simChannel_t* channel) {
+// buffers from the heap, all or none
+
+  for (uint32_t socket = 0; socket < channel->sockets; socket++)
+    for (uint32_t i = 0; i < channel->count; i++) {
+      channel->buffer[socket][i].mem = CyU3PDmaBufferAlloc (channel->size);
+      if (!channel->buffer[socket][i].mem) {
+        for (socket = 0; socket < channel->sockets; socket++)
+          for (i = 0; i < channel->count; i++) {
+            CyU3PDmaBufferFree (channel->buffer[socket][i].mem);
+            channel->buffer[socket][i].mem = NULL;
+            }
+        return CyFalse;
+        }
+      }
+
+  return CyTrue;
+  }
+//}}}
+//{{{
+static void channelReset (simChannel_t* channel) {
+// all buffers back to producers, queued transfers dropped
+
+  for (uint32_t socket = 0; socket < 2; socket++) {
+    for (uint32_t i = 0; i < BUFFERS_MAX; i++) {
+      channel->buffer[socket][i].state = BUFFER_FREE;
+      channel->buffer[socket][i].count = 0;
+      }
+    channel->prodIndex[socket] = 0;
+    channel->cpuIndex[socket] = 0;
+    }
+
+  channel->next = 0;
+  channel->cpuHeld = CyFalse;
+  channel->gen++;
+  channel->commits = 0;
+  channel->consumed = 0;
+  pthread_cond_broadcast (&modelCond);
+  }
+//}}}
+//{{{
+static void channelFree (simChannel_t* channel) {
+
+  channelReset (channel);
+  for (uint32_t socket = 0; socket < channel->sockets; socket++)
+    for (uint32_t i = 0; i < channel->count; i++)
+      CyU3PDmaBufferFree (channel->buffer[socket][i].mem);
+  channel->used = CyFalse;
+  }
+//}}}
+//{{{
+static void xferPush (simChannel_t* channel, uint8_t* data, uint32_t length, uint32_t socket, uint32_t index,
+                      uint64_t readyNs) {
+
+  simXfer_t* xfer = &xfers[xferIn % XFERS];
+  xfer->channel = channel;
+  xfer->gen = channel->gen;
+  xfer->data = data;
+  xfer->length = length;
+  xfer->socket = socket;
+  xfer->index = index;
+  xfer->uvc = channel->consSck == CY_U3P_UIB_SOCKET_CONS_3;
+  xfer->readyNs = readyNs;
+  xferIn++;
+  pthread_cond_broadcast (&modelCond);
+  }
+//}}}
+//{{{
+static CyU3PDmaCBInput_t cbInput (simChannel_t* channel, simBuffer_t* buffer) {
+
+  CyU3PDmaCBInput_t input;
+  input.buffer_p.buffer = buffer->mem + channel->header;
+  input.buffer_p.count = buffer->count;
+  input.buffer_p.size = channel->size - channel->header - channel->footer;
+  input.buffer_p.status = 0;
+  return input;
+  }
+//}}}
+//{{{
+static void channelCallback (simChannel_t* channel, CyU3PDmaCbType_t type, CyU3PDmaCBInput_t* input) {
+
+  if (!(channel->notification & type))
+    return;
+
+  if (channel->multi && channel->multiCb)
+    channel->multiCb ((CyU3PDmaMultiChannel*)channel->handle, type, input);
+  else if (!channel->multi && channel->cb)
+    channel->cb ((CyU3PDmaChannel*)channel->handle, type, input);
+  }
+//}}}
+
+// single channels, cpu producer, status on ep2, ring slots on ep3
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelCreate (CyU3PDmaChannel* handle, CyU3PDmaType_t type, CyU3PDmaChannelConfig_t* config) {
+
+  simLock();
+  simChannel_t* channel = channelNew (handle, CyFalse);
+  if (!channel) {
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  channel->cb = config->cb;
+  channel->notification = config->notification;
+  channel->size = config->size;
+  channel->count = config->count;
+  channel->header = config->prodHeader;
+  channel->footer = config->prodFooter;
+  channel->sockets = 1;
+  channel->prodSck[0] = config->prodSckId;
+  channel->consSck = config->consSckId;
+  if (!channelAlloc (channel)) {
+    channel->used = CyFalse;
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  handle->sim = channel;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelDestroy (CyU3PDmaChannel* handle) {
+
+  simLock();
+  if (handle->sim)
+    channelFree (handle->sim);
+  handle->sim = NULL;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelReset (CyU3PDmaChannel* handle) {
+
+  simLock();
+  if (handle->sim)
+    channelReset (handle->sim);
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelSetXfer (CyU3PDmaChannel* handle, uint32_t count) {
+  return handle->sim ? CY_U3P_SUCCESS : CY_U3P_ERROR_NOT_CONFIGURED;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelGetBuffer (CyU3PDmaChannel* handle, CyU3PDmaBuffer_t* buffer, uint32_t wait) {
+// cpu producer, next buffer if free
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (!channel || !channel->count || channel->cpuHeld ||
+      (channel->buffer[0][channel->cpuIndex[0]].state != BUFFER_FREE)) {
+    simUnlock();
+    return CY_U3P_ERROR_TIMEOUT;
+    }
+
+  simBuffer_t* simBuffer = &channel->buffer[0][channel->cpuIndex[0]];
+  simBuffer->state = BUFFER_CPU;
+  channel->cpuHeld = CyTrue;
+  buffer->buffer = simBuffer->mem + channel->header;
+  buffer->count = 0;
+  buffer->size = channel->size - channel->header - channel->footer;
+  buffer->status = 0;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelCommitBuffer (CyU3PDmaChannel* handle, uint16_t count, uint16_t status) {
+// ep2 status packets read by host at once, counted
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (!channel || !channel->cpuHeld) {
+    simCounters.commitErrors++;
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  uint32_t index = channel->cpuIndex[0];
+  channel->cpuHeld = CyFalse;
+  channel->cpuIndex[0] = (index + 1) % channel->count;
+  if (channel->consSck == CY_U3P_UIB_SOCKET_CONS_2) {
+    channel->buffer[0][index].state = BUFFER_FREE;
+    simCounters.statusPackets++;
+    }
+  else {
+    channel->buffer[0][index].state = BUFFER_USB;
+    channel->buffer[0][index].count = count;
+    xferPush (channel, channel->buffer[0][index].mem, count, 0, index, simNowNs());
+    }
+
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelDiscardBuffer (CyU3PDmaChannel* handle) {
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (channel && channel->cpuHeld) {
+    channel->buffer[0][channel->cpuIndex[0]].state = BUFFER_FREE;
+    channel->cpuIndex[0] = (channel->cpuIndex[0] + 1) % channel->count;
+    channel->cpuHeld = CyFalse;
+    }
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelSetupSendBuffer (CyU3PDmaChannel* handle, CyU3PDmaBuffer_t* buffer) {
+// caller's memory queued to the consumer, CONS_EVENT once the host has read it
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (!channel) {
+    simUnlock();
+    return CY_U3P_ERROR_NOT_CONFIGURED;
+    }
+
+  simHookRingSend (channel->commits, channel->consumed);
+  channel->commits++;
+  xferPush (channel, buffer->buffer, buffer->count, 0, 0, simNowNs());
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelWaitForCompletion (CyU3PDmaChannel* handle, uint32_t wait) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaChannelSetWrapUp (CyU3PDmaChannel* handle) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+
+// many to one channel, gpif sockets producing
+static CyBool_t gpifDone();
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelCreate (CyU3PDmaMultiChannel* handle, CyU3PDmaType_t type,
+                                                CyU3PDmaMultiChannelConfig_t* config) {
+
+  if ((config->validSckCount != 2) || (config->count > BUFFERS_MAX) || !config->count)
+    return CY_U3P_ERROR_BAD_ARGUMENT;
+
+  simLock();
+  simChannel_t* channel = channelNew (handle, CyTrue);
+  if (!channel) {
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  channel->multiCb = config->cb;
+  channel->notification = config->notification;
+  channel->size = config->size;
+  channel->count = config->count;
+  channel->header = config->prodHeader;
+  channel->footer = config->prodFooter;
+  channel->sockets = 2;
+  channel->prodSck[0] = config->prodSckId[0];
+  channel->prodSck[1] = config->prodSckId[1];
+  channel->consSck = config->consSckId[0];
+  if (!channelAlloc (channel)) {
+    channel->used = CyFalse;
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  handle->sim = channel;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelDestroy (CyU3PDmaMultiChannel* handle) {
+
+  simLock();
+  if (handle->sim)
+    channelFree (handle->sim);
+  handle->sim = NULL;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelReset (CyU3PDmaMultiChannel* handle) {
+// frame restart reset with buffers still on the bus loses them, counted
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (channel) {
+    simCounters.resets++;
+    if ((gpifDone()) && (channel->commits != channel->consumed))
+      simCounters.resetsUndrained++;
+    channelReset (channel);
+    }
+  simUnlock();
+  return channel ? CY_U3P_SUCCESS : CY_U3P_ERROR_NOT_CONFIGURED;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelSetXfer (CyU3PDmaMultiChannel* handle, uint32_t count, uint16_t multiSckOffset) {
+// infinite transfer, cpu starts at producer socket multiSckOffset
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (channel)
+    channel->next = multiSckOffset & 1;
+  simUnlock();
+  return channel ? CY_U3P_SUCCESS : CY_U3P_ERROR_NOT_CONFIGURED;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelGetBuffer (CyU3PDmaMultiChannel* handle, CyU3PDmaBuffer_t* buffer, uint32_t wait) {
+// next produced buffer in socket order, none if that socket's next buffer is not produced yet
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (!channel || channel->cpuHeld) {
+    simUnlock();
+    return CY_U3P_ERROR_TIMEOUT;
+    }
+
+  simBuffer_t* simBuffer = &channel->buffer[channel->next][channel->cpuIndex[channel->next]];
+  if (simBuffer->state != BUFFER_PRODUCED) {
+    simUnlock();
+    return CY_U3P_ERROR_TIMEOUT;
+    }
+
+  simBuffer->state = BUFFER_CPU;
+  channel->cpuHeld = CyTrue;
+  *buffer = cbInput (channel, simBuffer).buffer_p;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+static simBuffer_t* multiRelease (simChannel_t* channel, uint32_t* socket, uint32_t* index) {
+// buffer held by cpu, cpu moves on to the other socket
+
+  *socket = channel->next;
+  *index = channel->cpuIndex[*socket];
+  channel->cpuIndex[*socket] = (*index + 1) % channel->count;
+  channel->next ^= 1;
+  channel->cpuHeld = CyFalse;
+  return &channel->buffer[*socket][*index];
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelCommitBuffer (CyU3PDmaMultiChannel* handle, uint16_t count, uint16_t status) {
+// count includes prodHeader, queued to the consumer endpoint
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (!channel || !channel->cpuHeld || (count > channel->size - channel->footer)) {
+    simCounters.commitErrors++;
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  uint32_t socket;
+  uint32_t index;
+  simBuffer_t* simBuffer = multiRelease (channel, &socket, &index);
+  simBuffer->state = BUFFER_USB;
+  channel->commits++;
+  simHookCommit (channel->commits, channel->consumed);
+  xferPush (channel, simBuffer->mem, count, socket, index, simBuffer->doneNs + SIM_FW_BUFFER_NS);
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelDiscardBuffer (CyU3PDmaMultiChannel* handle) {
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  if (!channel || !channel->cpuHeld) {
+    simCounters.commitErrors++;
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  uint32_t socket;
+  uint32_t index;
+  simBuffer_t* buffer = multiRelease (channel, &socket, &index);
+  buffer->state = BUFFER_FREE;
+  buffer->freeNs = buffer->doneNs + SIM_FW_BUFFER_NS + (buffer->count * 1000000000ull) / SIM_FW_COPY_BYTES_PER_SEC;
+  pthread_cond_broadcast (&modelCond);
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDmaMultiChannelSetWrapUp (CyU3PDmaMultiChannel* handle, uint16_t multiSckOffset) {
+// partial buffer gpif left in socket becomes produced
+
+  simLock();
+  simChannel_t* channel = handle->sim;
+  simBuffer_t* simBuffer = channel ? &channel->buffer[multiSckOffset & 1][channel->prodIndex[multiSckOffset & 1]] : NULL;
+  if (!simBuffer || (simBuffer->state != BUFFER_FILLING) || !simBuffer->count) {
+    simCounters.wrapUpFails++;
+    simUnlock();
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  simBuffer->state = BUFFER_PRODUCED;
+  channel->prodIndex[multiSckOffset & 1] = (channel->prodIndex[multiSckOffset & 1] + 1) % channel->count;
+  CyU3PDmaCBInput_t input = cbInput (channel, simBuffer);
+  channelCallback (channel, CY_U3P_DMA_CB_PROD_EVENT, &input);
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+
+//{{{  gpif
+#define GPIF_OFF    0  // not started, or disabled
+#define GPIF_ARMED  1  // waiting for the next sensor frame start
+#define GPIF_ACTIVE 2  // frame valid, pushing data
+#define GPIF_DONE   3  // end of frame interrupt raised, waiting for SMSwitch
+
+typedef struct gpif {
+  uint8_t state;
+  CyBool_t loaded;
+  CyBool_t streaming;              // a frame was captured since the last disable, missed frames counted
+  uint32_t armSeq;                 // bumped on every arm, disable, so a waiting producer notices
+  CyU3PDmaSocketId_t socket[2];    // gpif thread to producer socket
+  uint32_t bufferBytes;            // data counter limit + 1
+  uint64_t endNs;                  // last end of frame, for restart latency
+  uint64_t sensorStartNs;          // start of the last sensor frame
+  uint32_t sensorFrame;            // number of the last sensor frame
+  CyU3PGpifEventCb_t cb;
+  CyU3PPibIntrCb_t pibCb;
+  } gpif_t;
+
+static gpif_t gpif = { GPIF_OFF, CyFalse, CyFalse, 0, { CY_U3P_PIB_SOCKET_0, CY_U3P_PIB_SOCKET_1 } };
+//}}}
+//{{{
+static CyBool_t gpifDone() {
+// end of frame raised, not yet re-armed, a reset now is a frame restart
+  return gpif.state == GPIF_DONE;
+  }
+//}}}
+//{{{
+static simChannel_t* gpifChannel() {
+// many to one channel fed by the gpif sockets
+
+  for (int i = 0; i < CHANNELS; i++)
+    if (channels[i].used && channels[i].multi &&
+        (channels[i].prodSck[0] == CY_U3P_PIB_SOCKET_0) && (channels[i].prodSck[1] == CY_U3P_PIB_SOCKET_1))
+      return &channels[i];
+
+  return NULL;
+  }
+//}}}
+//{{{
+static CyBool_t gpifWait (uint32_t armSeq, uint64_t ns) {
+// wait till ns, CyFalse if gpif was re-armed or disabled meanwhile
+
+  while ((gpif.armSeq == armSeq) && (simNowNs() < ns))
+    condWaitUntil (&modelCond, &modelMutex, ns);
+
+  return gpif.armSeq == armSeq;
+  }
+//}}}
+//{{{
+static void gpifFill (uint8_t* data, uint32_t tag, uint32_t offset, uint32_t bytes) {
+// frame pattern words, tail bytes of the last word
+
+  uint32_t* word = (uint32_t*)data;
+  uint32_t words = bytes / 4;
+  for (uint32_t i = 0; i < words; i++)
+    word[i] = SIM_PATTERN (tag, offset + i * 4);
+
+  if (bytes & 3) {
+    uint32_t last = SIM_PATTERN (tag, offset + words * 4);
+    memcpy (data + words * 4, &last, bytes & 3);
+    }
+  }
+//}}}
+//{{{
+static void gpifFrame (uint32_t armSeq) {
+// one frame from sensor, buffers alternate gpif threads 0,1, end of frame interrupt
+// - no free buffer is a pib overrun, the sensor does not wait, bytes clocked out till a buffer
+//   frees are lost, the frame carries on short from the byte the sensor is at
+// - decided on model time, buffer free time against the time gpif needed it, the sensor timeline
+//   never moves, the firmware's speed on the sim host is not the fx3's and does not decide it
+
+  simChannel_t* channel = gpifChannel();
+  if (!channel)
+    return;
+
+  uint32_t payload = channel->size - channel->header - channel->footer;
+  uint32_t fill = gpif.bufferBytes;
+  if (!fill || (fill > payload)) {
+    simCounters.counterErrors++;
+    fill = payload;
+    }
+
+  uint32_t tag = gpif.sensorFrame % SIM_FRAME_TAGS;
+  uint32_t bytes = simSensorFrameBytes (gpif.sensorFrame, fill);
+  simFrameBytes[tag] = bytes;
+  simFrameOverrun[tag] = CyFalse;
+
+  uint32_t rate = simConfig.gpifBytesPerSec ? simConfig.gpifBytesPerSec : simSensorBytesPerSec();
+  uint32_t gen = channel->gen;
+  uint64_t startNs = gpif.sensorStartNs;
+  uint64_t endNs = startNs + ((uint64_t)bytes * 1000000000ull) / rate;  // sensor's last byte
+  uint32_t thread = 0;
+  uint32_t offset = 0;
+  uint32_t n = 0;
+
+  while (offset < bytes) {
+    uint32_t socket = (gpif.socket[thread] == channel->prodSck[0]) ? 0 : 1;
+    simBuffer_t* buffer = &channel->buffer[socket][channel->prodIndex[socket]];
+
+    // wait for a buffer still out, its model free time decides, SIM_FW_WAIT_NS bounds a firmware holding it
+    uint64_t needNs = startNs + ((uint64_t)offset * 1000000000ull) / rate;
+    uint64_t waitNs = ((endNs > needNs) ? endNs : needNs) + SIM_FW_WAIT_NS;
+    while ((buffer->state != BUFFER_FREE) && (gpif.armSeq == armSeq) && (channel->gen == gen) &&
+           (simNowNs() < waitNs))
+      condWaitUntil (&modelCond, &modelMutex, waitNs);
+    if ((gpif.armSeq != armSeq) || (channel->gen != gen))
+      return;
+
+    uint64_t freeNs = (buffer->state == BUFFER_FREE) ? buffer->freeNs : simNowNs();
+    if (freeNs > needNs) {
+      //{{{  overrun, sensor data lost till the buffer freed or the frame ends
+      simCounters.prodStalls++;
+      simCounters.prodStallNs += freeNs - needNs;
+      if (!simFrameOverrun[tag]) {
+        simFrameOverrun[tag] = CyTrue;
+        simCounters.overrunFrames++;
+        }
+      if (gpif.pibCb)
+        gpif.pibCb (CYU3P_PIB_INTR_ERROR, 0x1005 + thread);
+
+      // sensor byte at free time, word aligned as the pattern is
+      uint64_t at = ((freeNs - startNs) * rate) / 1000000000ull;
+      at = (at + 15) & ~15ull;
+      if ((at >= bytes) || (buffer->state != BUFFER_FREE)) {
+        simCounters.lostBytes += bytes - offset;
+        offset = bytes;
+        break;
+        }
+      if (at > offset) {
+        simCounters.lostBytes += at - offset;
+        offset = at;
+        }
+      }
+      //}}}
+
+    n = (bytes - offset < fill) ? bytes - offset : fill;
+    buffer->state = BUFFER_FILLING;
+    buffer->count = 0;
+    gpifFill (buffer->mem + channel->header, tag, offset, n);
+
+    // last byte of the buffer at the gpif byte rate
+    uint64_t doneNs = startNs + ((uint64_t)(offset + n) * 1000000000ull) / rate;
+    buffer->doneNs = doneNs;
+    if (!gpifWait (armSeq, doneNs) || (channel->gen != gen))
+      return;
+
+    offset += n;
+    buffer->count = n;
+    if (n == fill) {
+      // buffer full, gpif switches thread
+      buffer->state = BUFFER_PRODUCED;
+      channel->prodIndex[socket] = (channel->prodIndex[socket] + 1) % channel->count;
+      CyU3PDmaCBInput_t input = cbInput (channel, buffer);
+      channelCallback (channel, CY_U3P_DMA_CB_PROD_EVENT, &input);
+      if (gpif.armSeq != armSeq)
+        return;
+      thread ^= 1;
+      }
+    }
+
+  // end of frame, last buffer in the thread before a full buffer switch, overrun to the end as full
+  CyBool_t partial = n && (n != fill);
+  if (!partial)
+    thread ^= 1;
+  uint8_t endState = simGpifEndStates[(partial ? 0 : 2) + thread];
+
+  gpif.state = GPIF_DONE;
+  gpif.endNs = simNowNs();
+  gpif.streaming = CyTrue;
+  simCounters.sensorFrames++;
+
+  if (gpif.cb)
+    gpif.cb (CYU3P_GPIF_EVT_SM_INTERRUPT, endState);
+  }
+//}}}
+//{{{
+static void* gpifThread (void* arg) {
+// waits for arm, next sensor frame start, captures frame
+
+  simLock();
+  for (;;) {
+    while (gpif.state != GPIF_ARMED)
+      pthread_cond_wait (&modelCond, &modelMutex);
+
+    uint32_t armSeq = gpif.armSeq;
+    uint64_t period = simSensorPeriodNs();
+    uint64_t now = simNowNs();
+
+    // first sensor frame start after arming, frames the sensor sent meanwhile are missed
+    uint64_t steps = (now > gpif.sensorStartNs) ? ((now - gpif.sensorStartNs) + period - 1) / period : 1;
+    if (!steps)
+      steps = 1;
+    if (gpif.streaming)
+      simCounters.sensorMissed += steps - 1;
+    gpif.sensorStartNs += steps * period;
+    gpif.sensorFrame += steps;
+
+    if (!gpifWait (armSeq, gpif.sensorStartNs))
+      continue;
+
+    gpif.state = GPIF_ACTIVE;
+    gpifFrame (armSeq);
+    if ((gpif.armSeq == armSeq) && (gpif.state == GPIF_ACTIVE))
+      // no channel to fill, wait for the next frame
+      gpif.state = GPIF_ARMED;
+    }
+
+  return NULL;
+  }
+//}}}
+//{{{
+static void gpifArm() {
+
+  simLock();
+  if (gpif.state == GPIF_DONE) {
+    uint64_t ns = simNowNs() - gpif.endNs;
+    simCounters.restarts++;
+    simCounters.restartNsSum += ns;
+    if (ns > simCounters.restartNsMax)
+      simCounters.restartNsMax = ns;
+    }
+
+  gpif.state = GPIF_ARMED;
+  gpif.armSeq++;
+  simHookArmed();
+  pthread_cond_broadcast (&modelCond);
+  simUnlock();
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpifLoad (const CyU3PGpifConfig_t* conf) {
+
+  simLock();
+  gpif.loaded = CyTrue;
+  gpif.socket[0] = CY_U3P_PIB_SOCKET_0;
+  gpif.socket[1] = CY_U3P_PIB_SOCKET_1;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpifSMStart (uint8_t startState, uint8_t initialAlpha) {
+
+  if (!gpif.loaded)
+    return CY_U3P_ERROR_NOT_CONFIGURED;
+
+  gpifArm();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpifSMSwitch (uint16_t fromState, uint16_t toState, uint16_t endState,
+                                       uint8_t initialAlpha, uint16_t switchTimeout) {
+
+  if (!gpif.loaded)
+    return CY_U3P_ERROR_NOT_CONFIGURED;
+
+  gpifArm();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpifSMControl (CyBool_t pause) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void CyU3PGpifDisable (CyBool_t forceReload) {
+
+  simLock();
+  gpif.state = GPIF_OFF;
+  gpif.streaming = CyFalse;
+  gpif.armSeq++;
+  if (forceReload)
+    gpif.loaded = CyFalse;
+  pthread_cond_broadcast (&modelCond);
+  simUnlock();
+  }
+//}}}
+//{{{
+void CyU3PGpifRegisterCallback (CyU3PGpifEventCb_t cbFunc) {
+  gpif.cb = cbFunc;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpifSocketConfigure (uint8_t threadIndex, CyU3PDmaSocketId_t socketNum,
+                                              uint16_t watermark, CyBool_t flagOnData, uint8_t burst) {
+
+  simLock();
+  gpif.socket[threadIndex & 1] = socketNum;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpifInitDataCounter (uint32_t initValue, uint32_t limit, CyBool_t reload,
+                                              CyBool_t upCount, uint8_t increment) {
+
+  gpif.bufferBytes = (limit - initValue + 1) * increment;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpifInitAddrCounter (uint32_t initValue, uint32_t limit, CyBool_t reload,
+                                              CyBool_t upCount, uint8_t increment) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PPibInit (CyBool_t doInit, CyU3PPibClock_t* pibClock) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PPibDeInit() {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void CyU3PPibRegisterCallback (CyU3PPibIntrCb_t cb, uint32_t intMask) {
+  gpif.pibCb = cb;
+  }
+//}}}
+
+//{{{  usb
+static CyU3PUSBSetupCb_t setupCb = NULL;
+static CyU3PUSBEventCb_t eventCb = NULL;
+static CyBool_t connected = CyFalse;
+
+// ep0 request in progress, harness waits for the firmware's data stage, ack or stall
+static pthread_mutex_t ep0Mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ep0Cond;
+static CyBool_t ep0Pending = CyFalse;
+static CyBool_t ep0Done = CyFalse;
+static CyBool_t ep0Stalled = CyFalse;
+static uint8_t* ep0Data = NULL;
+static uint16_t ep0Length = 0;
+static int ep0Result = 0;
+//}}}
+//{{{
+static void* hostThread (void* arg) {
+// reads queued ep1, ep3 transfers in order, bandwidth, latency, periodic stalls
+// - transfer data copied when the host starts reading it, completes after its bus time
+// - bus time runs from the model time the transfer was ready, not from when this thread woke
+
+  static uint8_t data[0x10000];
+  uint64_t busNs = 0;
+
+  simLock();
+  for (;;) {
+    while (xferIn == xferOut)
+      pthread_cond_wait (&modelCond, &modelMutex);
+
+    simXfer_t xfer = xfers[xferOut % XFERS];
+    xferOut++;
+    if (xfer.gen != xfer.channel->gen) {
+      simCounters.hostDropped++;
+      continue;
+      }
+    uint32_t length = (xfer.length < sizeof(data)) ? xfer.length : sizeof(data);
+    memcpy (data, xfer.data, length);
+    simUnlock();
+
+    //{{{  bus time
+    uint64_t startNs = xfer.readyNs;
+    if (busNs > startNs)
+      startNs = busNs;
+    startNs += simConfig.hostLatencyUs * 1000ull;
+
+    if (simConfig.stallEveryMs && simConfig.stallMs) {
+      // host not reading during the first stallMs of each stallEveryMs window
+      uint64_t everyNs = simConfig.stallEveryMs * 1000000ull;
+      uint64_t windowNs = startNs % everyNs;
+      if (windowNs < simConfig.stallMs * 1000000ull)
+        startNs += simConfig.stallMs * 1000000ull - windowNs;
+      }
+
+    busNs = startNs + ((uint64_t)length * 1000000000ull) / simConfig.hostBytesPerSec;
+    simSleepUntil (busNs);
+    //}}}
+
+    simLock();
+    simChannel_t* channel = xfer.channel;
+    if (xfer.gen != channel->gen) {
+      // reset or flushed while on the bus
+      simCounters.hostDropped++;
+      continue;
+      }
+
+    simCounters.hostBytes += length;
+    simCounters.hostTransfers++;
+    if (xfer.uvc)
+      simHostPayload (data, length);
+
+    CyU3PDmaCBInput_t input;
+    memset (&input, 0, sizeof(input));
+    if (channel->count) {
+      simBuffer_t* buffer = &channel->buffer[xfer.socket][xfer.index];
+      buffer->state = BUFFER_FREE;
+      buffer->freeNs = busNs;
+      input = cbInput (channel, buffer);
+      pthread_cond_broadcast (&modelCond);
+      }
+    channel->consumed++;
+
+    // firmware consumer callback under the model lock, its counters move with the model's
+    channelCallback (channel, CY_U3P_DMA_CB_CONS_EVENT, &input);
+    }
+
+  return NULL;
+  }
+//}}}
+//{{{
+int simControl (uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex,
+                uint16_t wLength, uint8_t* data) {
+// setup packet to the firmware's setup callback, waits for data stage, ack or stall
+
+  pthread_mutex_lock (&ep0Mutex);
+  ep0Pending = CyTrue;
+  ep0Done = CyFalse;
+  ep0Stalled = CyFalse;
+  ep0Data = data;
+  ep0Length = wLength;
+  ep0Result = 0;
+  pthread_mutex_unlock (&ep0Mutex);
+
+  CyBool_t handled = setupCb && setupCb (bmRequestType | (bRequest << 8) | ((uint32_t)wValue << 16),
+                                         wIndex | ((uint32_t)wLength << 16));
+
+  pthread_mutex_lock (&ep0Mutex);
+  if (!handled && !ep0Done) {
+    ep0Stalled = CyTrue;
+    ep0Done = CyTrue;
+    }
+
+  uint64_t deadline = simNowNs() + 2000000000ull;
+  while (!ep0Done)
+    if (condWaitUntil (&ep0Cond, &ep0Mutex, deadline)) {
+      ep0Stalled = CyTrue;
+      break;
+      }
+
+  int result = ep0Stalled ? -1 : ep0Result;
+  ep0Pending = CyFalse;
+  pthread_mutex_unlock (&ep0Mutex);
+  return result;
+  }
+//}}}
+//{{{
+static void ep0Complete (CyBool_t stalled, int result) {
+
+  ep0Stalled = stalled;
+  ep0Result = result;
+  ep0Done = CyTrue;
+  pthread_cond_broadcast (&ep0Cond);
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbGetEP0Data (uint16_t count, uint8_t* buffer, uint16_t* readCount) {
+// host to device data stage
+
+  pthread_mutex_lock (&ep0Mutex);
+  if (!ep0Pending || ep0Done) {
+    pthread_mutex_unlock (&ep0Mutex);
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  uint16_t n = (count < ep0Length) ? count : ep0Length;
+  if (n && ep0Data)
+    memcpy (buffer, ep0Data, n);
+  if (readCount)
+    *readCount = n;
+  ep0Complete (CyFalse, n);
+  pthread_mutex_unlock (&ep0Mutex);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbSendEP0Data (uint16_t count, uint8_t* buffer) {
+// device to host data stage
+
+  pthread_mutex_lock (&ep0Mutex);
+  if (!ep0Pending || ep0Done) {
+    pthread_mutex_unlock (&ep0Mutex);
+    return CY_U3P_ERROR_FAILURE;
+    }
+
+  uint16_t n = (count < ep0Length) ? count : ep0Length;
+  if (n && ep0Data)
+    memcpy (ep0Data, buffer, n);
+  ep0Complete (CyFalse, n);
+  pthread_mutex_unlock (&ep0Mutex);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void CyU3PUsbAckSetup() {
+
+  pthread_mutex_lock (&ep0Mutex);
+  if (ep0Pending && !ep0Done)
+    ep0Complete (CyFalse, 0);
+  pthread_mutex_unlock (&ep0Mutex);
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbStall (uint8_t ep, CyBool_t stall, CyBool_t toggle) {
+
+  if (((ep & 0x7F) == 0) && stall) {
+    pthread_mutex_lock (&ep0Mutex);
+    if (ep0Pending && !ep0Done)
+      ep0Complete (CyTrue, -1);
+    pthread_mutex_unlock (&ep0Mutex);
+    }
+
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbFlushEp (uint8_t ep) {
+// queued transfers of channels feeding ep dropped
+
+  CyU3PDmaSocketId_t socket = CY_U3P_UIB_SOCKET_CONS_0 + (ep & 0x0F);
+
+  simLock();
+  for (uint32_t i = xferOut; i != xferIn; i++)
+    if (xfers[i % XFERS].channel->consSck == socket)
+      xfers[i % XFERS].gen--;
+  simUnlock();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbStart() {
+
+  pthread_once (&modelOnce, modelInit);
+  condInit (&ep0Cond);
+
+  pthread_t id;
+  pthread_create (&id, NULL, gpifThread, NULL);
+  pthread_detach (id);
+  pthread_create (&id, NULL, hostThread, NULL);
+  pthread_detach (id);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void CyU3PUsbRegisterSetupCallback (CyU3PUSBSetupCb_t callback, CyBool_t fastEnum) {
+  setupCb = callback;
+  }
+//}}}
+//{{{
+void CyU3PUsbRegisterEventCallback (CyU3PUSBEventCb_t callback) {
+  eventCb = callback;
+  }
+//}}}
+//{{{
+void CyU3PUsbRegisterLPMRequestCallback (CyU3PUsbLPMReqCb_t callback) {
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PConnectState (CyBool_t connect, CyBool_t ssEnable) {
+
+  connected = connect;
+  if (!ssEnable && (simConfig.speed == CY_U3P_SUPER_SPEED))
+    simConfig.speed = CY_U3P_HIGH_SPEED;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PUSBSpeed_t CyU3PUsbGetSpeed() {
+  return connected ? simConfig.speed : CY_U3P_NOT_CONNECTED;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbSetDesc (int descType, uint8_t descIndex, uint8_t* desc) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PSetEpConfig (uint8_t ep, CyU3PEpConfig_t* epinfo) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbResetEp (uint8_t ep) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbSetEpNak (uint8_t ep, CyBool_t nak) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbGetLinkPowerState (CyU3PUsbLinkPowerMode* mode) {
+
+  *mode = CyU3PUsbLPM_U0;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbSetLinkPowerState (CyU3PUsbLinkPowerMode mode) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUsbSetEpPktMode (uint8_t ep, CyBool_t pktMode) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+
+// system, gpio, uart, i2c
+//{{{
+CyU3PReturnStatus_t CyU3PDeviceInit (CyU3PSysClockConfig_t* clkCfg) {
+
+  simNowNs();
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDeviceCacheControl (CyBool_t isICacheEnable, CyBool_t isDCacheEnable, CyBool_t isDmaHandleDCache) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDeviceConfigureIOMatrix (CyU3PIoMatrixConfig_t* cfg_p) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDeviceGpioOverride (uint8_t gpioId, CyBool_t isSimple) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDeviceGetSysClkFreq (uint32_t* freq) {
+
+  *freq = 384000000;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void CyU3PKernelEntry() {
+// application define creates the firmware threads, returns to the harness
+
+  CyFxApplicationDefine();
+  }
+//}}}
+
+static CyU3PGpioIntrCb_t gpioIrq = NULL;
+static uint64_t gpioLow = 0;  // input pins pulled low by the harness, others read high
+
+//{{{
+CyU3PReturnStatus_t CyU3PGpioInit (CyU3PGpioClock_t* clk_p, CyU3PGpioIntrCb_t irq) {
+
+  gpioIrq = irq;
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpioSetSimpleConfig (uint8_t gpioId, CyU3PGpioSimpleConfig_t* cfg_p) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpioSetComplexConfig (uint8_t gpioId, CyU3PGpioComplexConfig_t* cfg_p) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpioComplexSampleNow (uint8_t gpioId, uint32_t* value_p) {
+// timer gpio, fastClk 48MHz
+
+  *value_p = (uint32_t)((simNowNs() * 6) / 125);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpioGetValue (uint8_t gpioId, CyBool_t* value_p) {
+
+  *value_p = !((gpioLow >> gpioId) & 1);
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void simGpioInput (uint8_t gpioId, CyBool_t value) {
+// harness drives an input pin, interrupt callback on either edge, from the harness thread
+
+  CyBool_t old = !((gpioLow >> gpioId) & 1);
+  if (value)
+    gpioLow &= ~(1ull << gpioId);
+  else
+    gpioLow |= 1ull << gpioId;
+
+  if ((value != old) && gpioIrq)
+    gpioIrq (gpioId);
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PGpioSetValue (uint8_t gpioId, CyBool_t value) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+
+//{{{
+CyU3PReturnStatus_t CyU3PUartInit() {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUartSetConfig (CyU3PUartConfig_t* config, void* cb) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PUartTxSetBlockXfer (uint32_t txSize) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PI2cInit() {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PI2cSetConfig (CyU3PI2cConfig_t* config, void* cb) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+CyU3PReturnStatus_t CyU3PDebugInit (int destSckId, uint8_t traceLevel) {
+  return CY_U3P_SUCCESS;
+  }
+//}}}
+//{{{
+void CyU3PDebugPreamble (CyBool_t sendPreamble) {
+  }
+//}}}
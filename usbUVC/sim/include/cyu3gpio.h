@@ -0,0 +1,3 @@
+// cyu3gpio.h - host simulation stand-in, see cyu3sim.h
+#pragma once
+#include "cyu3sim.h"
@@ -0,0 +1,443 @@
+// cyu3sim.h - host stand-in for the cyu3 sdk headers, usbUVC host simulation
+// - types, constants, prototypes of the sdk calls the firmware uses, values as in the sdk
+// - os objects, dma channels hold a pointer to the simulation's own state
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//{{{  types, errors
+typedef int CyBool_t;
+#define CyTrue  1
+#define CyFalse 0
+
+typedef uint32_t CyU3PReturnStatus_t;
+#define CY_U3P_SUCCESS                  0x00
+#define CY_U3P_ERROR_FAILURE            0x01
+#define CY_U3P_ERROR_ALREADY_STARTED    0x02
+#define CY_U3P_ERROR_NO_REENUM_REQUIRED 0x03
+#define CY_U3P_ERROR_TIMEOUT            0x04
+#define CY_U3P_ERROR_BAD_ARGUMENT       0x05
+#define CY_U3P_ERROR_NOT_SUPPORTED      0x06
+#define CY_U3P_ERROR_NOT_CONFIGURED     0x07
+
+#define CY_U3P_MIN(a,b) ((a) < (b) ? (a) : (b))
+#define CY_U3P_MAX(a,b) ((a) > (b) ? (a) : (b))
+#define CY_U3P_GET_LSB(w) ((uint8_t)((w) & 0xFF))
+#define CY_U3P_GET_MSB(w) ((uint8_t)(((w) >> 8) & 0xFF))
+#define CY_U3P_DWORD_GET_BYTE0(d) ((uint8_t)((d) & 0xFF))
+#define CY_U3P_DWORD_GET_BYTE1(d) ((uint8_t)(((d) >> 8) & 0xFF))
+#define CY_U3P_DWORD_GET_BYTE2(d) ((uint8_t)(((d) >> 16) & 0xFF))
+#define CY_U3P_DWORD_GET_BYTE3(d) ((uint8_t)(((d) >> 24) & 0xFF))
+//}}}
+//{{{  os
+#define CYU3P_NO_WAIT       0
+#define CYU3P_WAIT_FOREVER  0xFFFFFFFF
+
+#define CYU3P_EVENT_OR        0
+#define CYU3P_EVENT_OR_CLEAR  1
+#define CYU3P_EVENT_AND       2
+#define CYU3P_EVENT_AND_CLEAR 3
+
+#define CYU3P_DONT_START    0
+#define CYU3P_AUTO_START    1
+#define CYU3P_NO_TIME_SLICE 0
+#define CYU3P_NO_INHERIT    0
+#define CYU3P_INHERIT       1
+
+typedef struct { void* sim; } CyU3PThread;
+typedef struct { void* sim; } CyU3PEvent;
+typedef struct { void* sim; } CyU3PMutex;
+typedef struct { void* sim; } CyU3PQueue;
+typedef struct { void* sim; } CyU3PBytePool;
+typedef struct { void* sim; } CyU3PTimer;
+
+typedef void (*CyU3PThreadEntry_t)(uint32_t);
+
+extern uint32_t CyU3PThreadCreate (CyU3PThread* thread, char* name, CyU3PThreadEntry_t entry, uint32_t input,
+                                   void* stack, uint32_t stackSize, uint32_t priority, uint32_t threshold,
+                                   uint32_t timeSlice, uint32_t autoStart);
+extern void CyU3PThreadRelinquish (void);
+extern uint32_t CyU3PThreadSleep (uint32_t ms);
+
+extern uint32_t CyU3PEventCreate (CyU3PEvent* event);
+extern uint32_t CyU3PEventSet (CyU3PEvent* event, uint32_t flags, uint32_t option);
+extern uint32_t CyU3PEventGet (CyU3PEvent* event, uint32_t mask, uint32_t option, uint32_t* flags, uint32_t wait);
+
+extern uint32_t CyU3PMutexCreate (CyU3PMutex* mutex, uint32_t inherit);
+extern uint32_t CyU3PMutexGet (CyU3PMutex* mutex, uint32_t wait);
+extern uint32_t CyU3PMutexPut (CyU3PMutex* mutex);
+extern uint32_t CyU3PMutexDestroy (CyU3PMutex* mutex);
+
+extern uint32_t CyU3PQueueCreate (CyU3PQueue* queue, uint32_t messageSize, void* mem, uint32_t queueSize);
+extern uint32_t CyU3PQueueSend (CyU3PQueue* queue, void* message, uint32_t wait);
+extern uint32_t CyU3PQueueReceive (CyU3PQueue* queue, void* message, uint32_t wait);
+
+extern uint32_t CyU3PGetTime (void);
+
+extern void* CyU3PMemAlloc (uint32_t size);
+extern void CyU3PMemFree (void* mem);
+extern void CyU3PMemSet (uint8_t* ptr, uint8_t data, uint32_t count);
+extern void CyU3PMemCopy (uint8_t* dest, uint8_t* src, uint32_t count);
+extern int32_t CyU3PMemCmp (const void* s1, const void* s2, uint32_t count);
+
+extern void* CyU3PDmaBufferAlloc (uint16_t size);
+extern int CyU3PDmaBufferFree (void* buffer);
+extern void CyU3PBufGetFree (uint32_t* free_p, uint32_t* largest_p);
+
+extern void CyU3PBusyWait (uint16_t us);
+extern void CyU3PDebugPrint (uint8_t priority, char* message, ...);
+//}}}
+//{{{  dma
+typedef enum {
+  CY_U3P_DMA_TYPE_AUTO, CY_U3P_DMA_TYPE_MANUAL, CY_U3P_DMA_TYPE_MANUAL_IN, CY_U3P_DMA_TYPE_MANUAL_OUT,
+  CY_U3P_DMA_TYPE_MANUAL_MANY_TO_ONE, CY_U3P_DMA_TYPE_AUTO_MANY_TO_ONE
+  } CyU3PDmaType_t;
+
+typedef enum {
+  CY_U3P_DMA_CB_XFER_CPLT = 1, CY_U3P_DMA_CB_SEND_CPLT = 2, CY_U3P_DMA_CB_RECV_CPLT = 4,
+  CY_U3P_DMA_CB_PROD_EVENT = 8, CY_U3P_DMA_CB_CONS_EVENT = 16, CY_U3P_DMA_CB_ABORTED = 32,
+  CY_U3P_DMA_CB_ERROR = 64
+  } CyU3PDmaCbType_t;
+
+typedef enum { CY_U3P_DMA_MODE_BYTE, CY_U3P_DMA_MODE_BUFFER } CyU3PDmaMode_t;
+
+typedef enum {
+  CY_U3P_LPP_SOCKET_UART_CONS = 0x10, CY_U3P_LPP_SOCKET_SPI_CONS, CY_U3P_LPP_SOCKET_I2C_CONS,
+  CY_U3P_PIB_SOCKET_0 = 0x100, CY_U3P_PIB_SOCKET_1, CY_U3P_PIB_SOCKET_2, CY_U3P_PIB_SOCKET_3,
+  CY_U3P_UIB_SOCKET_CONS_0 = 0x300, CY_U3P_UIB_SOCKET_CONS_1, CY_U3P_UIB_SOCKET_CONS_2, CY_U3P_UIB_SOCKET_CONS_3,
+  CY_U3P_CPU_SOCKET_CONS = 0x3F00, CY_U3P_CPU_SOCKET_PROD = 0x3F01
+  } CyU3PDmaSocketId_t;
+
+typedef struct {
+  uint8_t* buffer;
+  uint16_t count;
+  uint16_t size;
+  uint16_t status;
+  } CyU3PDmaBuffer_t;
+
+typedef union { CyU3PDmaBuffer_t buffer_p; } CyU3PDmaCBInput_t;
+
+typedef struct CyU3PDmaChannel { void* sim; } CyU3PDmaChannel;
+typedef struct CyU3PDmaMultiChannel { void* sim; } CyU3PDmaMultiChannel;
+
+typedef void (*CyU3PDmaCallback_t)(CyU3PDmaChannel* handle, CyU3PDmaCbType_t type, CyU3PDmaCBInput_t* input);
+typedef void (*CyU3PDmaMultiCallback_t)(CyU3PDmaMultiChannel* handle, CyU3PDmaCbType_t type, CyU3PDmaCBInput_t* input);
+
+typedef struct {
+  uint16_t size;
+  uint16_t count;
+  CyU3PDmaSocketId_t prodSckId;
+  CyU3PDmaSocketId_t consSckId;
+  uint32_t prodAvailCount;
+  uint16_t prodHeader;
+  uint16_t prodFooter;
+  uint16_t consHeader;
+  CyU3PDmaMode_t dmaMode;
+  uint32_t notification;
+  CyU3PDmaCallback_t cb;
+  } CyU3PDmaChannelConfig_t;
+
+typedef struct {
+  uint16_t size;
+  uint16_t count;
+  uint16_t validSckCount;
+  CyU3PDmaSocketId_t prodSckId[4];
+  CyU3PDmaSocketId_t consSckId[4];
+  uint32_t prodAvailCount;
+  uint16_t prodHeader;
+  uint16_t prodFooter;
+  uint16_t consHeader;
+  CyU3PDmaMode_t dmaMode;
+  uint32_t notification;
+  CyU3PDmaMultiCallback_t cb;
+  } CyU3PDmaMultiChannelConfig_t;
+
+extern CyU3PReturnStatus_t CyU3PDmaChannelCreate (CyU3PDmaChannel* handle, CyU3PDmaType_t type, CyU3PDmaChannelConfig_t* config);
+extern CyU3PReturnStatus_t CyU3PDmaChannelDestroy (CyU3PDmaChannel* handle);
+extern CyU3PReturnStatus_t CyU3PDmaChannelReset (CyU3PDmaChannel* handle);
+extern CyU3PReturnStatus_t CyU3PDmaChannelSetXfer (CyU3PDmaChannel* handle, uint32_t count);
+extern CyU3PReturnStatus_t CyU3PDmaChannelGetBuffer (CyU3PDmaChannel* handle, CyU3PDmaBuffer_t* buffer, uint32_t wait);
+extern CyU3PReturnStatus_t CyU3PDmaChannelCommitBuffer (CyU3PDmaChannel* handle, uint16_t count, uint16_t status);
+extern CyU3PReturnStatus_t CyU3PDmaChannelDiscardBuffer (CyU3PDmaChannel* handle);
+extern CyU3PReturnStatus_t CyU3PDmaChannelSetupSendBuffer (CyU3PDmaChannel* handle, CyU3PDmaBuffer_t* buffer);
+extern CyU3PReturnStatus_t CyU3PDmaChannelWaitForCompletion (CyU3PDmaChannel* handle, uint32_t wait);
+extern CyU3PReturnStatus_t CyU3PDmaChannelSetWrapUp (CyU3PDmaChannel* handle);
+
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelCreate (CyU3PDmaMultiChannel* handle, CyU3PDmaType_t type,
+                                                       CyU3PDmaMultiChannelConfig_t* config);
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelDestroy (CyU3PDmaMultiChannel* handle);
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelReset (CyU3PDmaMultiChannel* handle);
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelSetXfer (CyU3PDmaMultiChannel* handle, uint32_t count, uint16_t multiSckOffset);
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelGetBuffer (CyU3PDmaMultiChannel* handle, CyU3PDmaBuffer_t* buffer, uint32_t wait);
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelCommitBuffer (CyU3PDmaMultiChannel* handle, uint16_t count, uint16_t status);
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelDiscardBuffer (CyU3PDmaMultiChannel* handle);
+extern CyU3PReturnStatus_t CyU3PDmaMultiChannelSetWrapUp (CyU3PDmaMultiChannel* handle, uint16_t multiSckOffset);
+//}}}
+//{{{  usb
+typedef enum { CY_U3P_NOT_CONNECTED, CY_U3P_FULL_SPEED, CY_U3P_HIGH_SPEED, CY_U3P_SUPER_SPEED } CyU3PUSBSpeed_t;
+
+typedef enum {
+  CY_U3P_USB_EVENT_CONNECT, CY_U3P_USB_EVENT_DISCONNECT, CY_U3P_USB_EVENT_SUSPEND, CY_U3P_USB_EVENT_RESUME,
+  CY_U3P_USB_EVENT_RESET, CY_U3P_USB_EVENT_SETCONF, CY_U3P_USB_EVENT_SPEED, CY_U3P_USB_EVENT_SETINTF,
+  CY_U3P_USB_EVENT_EP_UNDERRUN
+  } CyU3PUsbEventType_t;
+
+typedef enum { CyU3PUsbLPM_U0, CyU3PUsbLPM_U1, CyU3PUsbLPM_U2, CyU3PUsbLPM_U3 } CyU3PUsbLinkPowerMode;
+typedef enum { CY_U3P_USB_EP_CONTROL, CY_U3P_USB_EP_ISO, CY_U3P_USB_EP_BULK, CY_U3P_USB_EP_INTR } CyU3PUsbEpType_t;
+
+typedef struct {
+  CyBool_t enable;
+  CyU3PUsbEpType_t epType;
+  uint16_t streams;
+  uint16_t pcktSize;
+  uint8_t burstLen;
+  uint8_t isoPkts;
+  } CyU3PEpConfig_t;
+
+enum {
+  CY_U3P_USB_DEVICE_DESCR = 1, CY_U3P_USB_CONFIG_DESCR, CY_U3P_USB_STRING_DESCR, CY_U3P_USB_INTRFC_DESCR,
+  CY_U3P_USB_ENDPNT_DESCR, CY_U3P_USB_DEVQUAL_DESCR, CY_U3P_USB_OTHERSPEED_DESCR, CY_U3P_USB_INTRFC_POWER_DESCR,
+  CY_U3P_USB_OTG_DESCR, CY_U3P_BOS_DESCR = 15, CY_U3P_DEVICE_CAPB_DESCR = 16, CY_U3P_USB_HID_DESCR = 0x21,
+  CY_U3P_USB_REPORT_DESCR = 0x22, CY_U3P_SS_EP_COMPN_DESCR = 48
+  };
+enum { CY_U3P_WIRELESS_USB_CAPB_TYPE = 1, CY_U3P_USB2_EXTN_CAPB_TYPE, CY_U3P_SS_USB_CAPB_TYPE, CY_U3P_CONTAINER_ID_CAPBD_TYPE };
+
+enum {
+  CY_U3P_USB_SET_SS_DEVICE_DESCR, CY_U3P_USB_SET_HS_DEVICE_DESCR, CY_U3P_USB_SET_DEVQUAL_DESCR,
+  CY_U3P_USB_SET_FS_CONFIG_DESCR, CY_U3P_USB_SET_HS_CONFIG_DESCR, CY_U3P_USB_SET_STRING_DESCR,
+  CY_U3P_USB_SET_SS_CONFIG_DESCR, CY_U3P_USB_SET_SS_BOS_DESCR
+  };
+
+#define CY_U3P_USB_REQUEST_TYPE_MASK 0x000000FF
+#define CY_U3P_USB_TYPE_MASK         0x60
+#define CY_U3P_USB_TARGET_MASK       0x03
+#define CY_U3P_USB_STANDARD_RQT      0x00
+#define CY_U3P_USB_CLASS_RQT         0x20
+#define CY_U3P_USB_VENDOR_RQT        0x40
+#define CY_U3P_USB_TARGET_DEVICE     0
+#define CY_U3P_USB_TARGET_INTF       1
+#define CY_U3P_USB_TARGET_ENDPT      2
+#define CY_U3P_USB_REQUEST_MASK      0x0000FF00
+#define CY_U3P_USB_REQUEST_POS       8
+#define CY_U3P_USB_VALUE_MASK        0xFFFF0000
+#define CY_U3P_USB_VALUE_POS         16
+#define CY_U3P_USB_INDEX_MASK        0x0000FFFF
+#define CY_U3P_USB_INDEX_POS         0
+#define CY_U3P_USB_LENGTH_MASK       0xFFFF0000
+#define CY_U3P_USB_LENGTH_POS        16
+
+#define CY_U3P_USB_SC_GET_STATUS     0
+#define CY_U3P_USB_SC_CLEAR_FEATURE  1
+#define CY_U3P_USB_SC_SET_FEATURE    3
+#define CY_U3P_USB_SC_SET_INTERFACE  11
+#define CY_U3P_USBX_FS_EP_HALT       0
+
+typedef CyBool_t (*CyU3PUSBSetupCb_t)(uint32_t setupdat0, uint32_t setupdat1);
+typedef void (*CyU3PUSBEventCb_t)(CyU3PUsbEventType_t evType, uint16_t evData);
+typedef CyBool_t (*CyU3PUsbLPMReqCb_t)(CyU3PUsbLinkPowerMode link_mode);
+
+extern CyU3PReturnStatus_t CyU3PUsbStart (void);
+extern void CyU3PUsbRegisterSetupCallback (CyU3PUSBSetupCb_t callback, CyBool_t fastEnum);
+extern void CyU3PUsbRegisterEventCallback (CyU3PUSBEventCb_t callback);
+extern void CyU3PUsbRegisterLPMRequestCallback (CyU3PUsbLPMReqCb_t callback);
+extern CyU3PReturnStatus_t CyU3PUsbSetDesc (int descType, uint8_t descIndex, uint8_t* desc);
+extern CyU3PReturnStatus_t CyU3PSetEpConfig (uint8_t ep, CyU3PEpConfig_t* epinfo);
+extern CyU3PReturnStatus_t CyU3PConnectState (CyBool_t connect, CyBool_t ssEnable);
+extern CyU3PUSBSpeed_t CyU3PUsbGetSpeed (void);
+extern CyU3PReturnStatus_t CyU3PUsbGetEP0Data (uint16_t count, uint8_t* buffer, uint16_t* readCount);
+extern CyU3PReturnStatus_t CyU3PUsbSendEP0Data (uint16_t count, uint8_t* buffer);
+extern CyU3PReturnStatus_t CyU3PUsbStall (uint8_t ep, CyBool_t stall, CyBool_t toggle);
+extern void CyU3PUsbAckSetup (void);
+extern CyU3PReturnStatus_t CyU3PUsbFlushEp (uint8_t ep);
+extern CyU3PReturnStatus_t CyU3PUsbResetEp (uint8_t ep);
+extern CyU3PReturnStatus_t CyU3PUsbSetEpNak (uint8_t ep, CyBool_t nak);
+extern CyU3PReturnStatus_t CyU3PUsbGetLinkPowerState (CyU3PUsbLinkPowerMode* mode);
+extern CyU3PReturnStatus_t CyU3PUsbSetLinkPowerState (CyU3PUsbLinkPowerMode mode);
+extern CyU3PReturnStatus_t CyU3PUsbSetEpPktMode (uint8_t ep, CyBool_t pktMode);
+//}}}
+//{{{  gpif, pib
+typedef enum {
+  CYU3P_GPIF_EVT_END_STATE, CYU3P_GPIF_EVT_SM_INTERRUPT, CYU3P_GPIF_EVT_SWITCH_TIMEOUT,
+  CYU3P_GPIF_EVT_ADDR_COUNTER, CYU3P_GPIF_EVT_DATA_COUNTER
+  } CyU3PGpifEventType;
+
+typedef struct {
+  uint32_t leftData[3];
+  uint32_t rightData[3];
+  } CyU3PGpifWaveData;
+
+typedef struct {
+  uint16_t stateCount;
+  CyU3PGpifWaveData* stateData;
+  uint8_t* statePosition;
+  uint16_t functionCount;
+  uint16_t* functionData;
+  uint16_t regCount;
+  uint32_t* regData;
+  } CyU3PGpifConfig_t;
+
+typedef void (*CyU3PGpifEventCb_t)(CyU3PGpifEventType event, uint8_t currentState);
+
+extern CyU3PReturnStatus_t CyU3PGpifLoad (const CyU3PGpifConfig_t* conf);
+extern CyU3PReturnStatus_t CyU3PGpifSMStart (uint8_t startState, uint8_t initialAlpha);
+extern CyU3PReturnStatus_t CyU3PGpifSMSwitch (uint16_t fromState, uint16_t toState, uint16_t endState,
+                                              uint8_t initialAlpha, uint16_t switchTimeout);
+extern CyU3PReturnStatus_t CyU3PGpifSMControl (CyBool_t pause);
+extern void CyU3PGpifDisable (CyBool_t forceReload);
+extern void CyU3PGpifRegisterCallback (CyU3PGpifEventCb_t cbFunc);
+extern CyU3PReturnStatus_t CyU3PGpifSocketConfigure (uint8_t threadIndex, CyU3PDmaSocketId_t socketNum,
+                                                     uint16_t watermark, CyBool_t flagOnData, uint8_t burst);
+extern CyU3PReturnStatus_t CyU3PGpifInitDataCounter (uint32_t initValue, uint32_t limit, CyBool_t reload,
+                                                     CyBool_t upCount, uint8_t increment);
+extern CyU3PReturnStatus_t CyU3PGpifInitAddrCounter (uint32_t initValue, uint32_t limit, CyBool_t reload,
+                                                     CyBool_t upCount, uint8_t increment);
+
+typedef struct {
+  uint16_t clkDiv;
+  CyBool_t isHalfDiv;
+  CyBool_t isDllEnable;
+  int clkSrc;
+  } CyU3PPibClock_t;
+
+typedef enum { CYU3P_PIB_INTR_DLL_UPDATE = 1, CYU3P_PIB_INTR_PPCONFIG = 2, CYU3P_PIB_INTR_ERROR = 4 } CyU3PPibIntrType;
+typedef void (*CyU3PPibIntrCb_t)(CyU3PPibIntrType cbType, uint16_t cbArg);
+
+extern CyU3PReturnStatus_t CyU3PPibInit (CyBool_t doInit, CyU3PPibClock_t* pibClock);
+extern CyU3PReturnStatus_t CyU3PPibDeInit (void);
+extern void CyU3PPibRegisterCallback (CyU3PPibIntrCb_t cb, uint32_t intMask);
+
+#define CYU3P_GET_PIB_ERROR_TYPE(n)  ((n) & 0x3F)
+#define CYU3P_GET_GPIF_ERROR_TYPE(n) (((n) & 0x7C00) >> 10)
+//}}}
+//{{{  system, io matrix
+enum { CY_U3P_SYS_CLK_BY_16, CY_U3P_SYS_CLK_BY_4, CY_U3P_SYS_CLK_BY_2, CY_U3P_SYS_CLK };
+
+typedef struct {
+  CyBool_t setSysClk400;
+  uint8_t cpuClkDiv;
+  uint8_t dmaClkDiv;
+  uint8_t mmioClkDiv;
+  CyBool_t useStandbyClk;
+  int clkSrc;
+  } CyU3PSysClockConfig_t;
+
+enum { CY_U3P_SPORT_INACTIVE };
+enum { CY_U3P_IO_MATRIX_LPP_DEFAULT };
+
+typedef struct {
+  CyBool_t isDQ32Bit;
+  int s0Mode;
+  int s1Mode;
+  CyBool_t useUart;
+  CyBool_t useI2C;
+  CyBool_t useI2S;
+  CyBool_t useSpi;
+  int lppMode;
+  uint32_t gpioSimpleEn[2];
+  uint32_t gpioComplexEn[2];
+  } CyU3PIoMatrixConfig_t;
+
+extern CyU3PReturnStatus_t CyU3PDeviceInit (CyU3PSysClockConfig_t* clkCfg);
+extern CyU3PReturnStatus_t CyU3PDeviceCacheControl (CyBool_t isICacheEnable, CyBool_t isDCacheEnable, CyBool_t isDmaHandleDCache);
+extern CyU3PReturnStatus_t CyU3PDeviceConfigureIOMatrix (CyU3PIoMatrixConfig_t* cfg_p);
+extern CyU3PReturnStatus_t CyU3PDeviceGpioOverride (uint8_t gpioId, CyBool_t isSimple);
+extern CyU3PReturnStatus_t CyU3PDeviceGetSysClkFreq (uint32_t* freq);
+extern void CyU3PKernelEntry (void);
+//}}}
+//{{{  gpio
+enum { CY_U3P_GPIO_SIMPLE_DIV_BY_2, CY_U3P_GPIO_SIMPLE_DIV_BY_4, CY_U3P_GPIO_SIMPLE_DIV_BY_16, CY_U3P_GPIO_SIMPLE_DIV_BY_64 };
+
+typedef enum {
+  CY_U3P_GPIO_NO_INTR, CY_U3P_GPIO_INTR_POS_EDGE, CY_U3P_GPIO_INTR_NEG_EDGE, CY_U3P_GPIO_INTR_BOTH_EDGE,
+  CY_U3P_GPIO_INTR_LOW_LEVEL, CY_U3P_GPIO_INTR_HIGH_LEVEL, CY_U3P_GPIO_INTR_TIMER_THRES, CY_U3P_GPIO_INTR_TIMER_ZERO
+  } CyU3PGpioIntrMode_t;
+
+typedef enum {
+  CY_U3P_GPIO_MODE_STATIC, CY_U3P_GPIO_MODE_TOGGLE, CY_U3P_GPIO_MODE_SAMPLE_NOW, CY_U3P_GPIO_MODE_PULSE_NOW
+  } CyU3PGpioComplexMode_t;
+
+typedef enum {
+  CY_U3P_GPIO_TIMER_SHUTDOWN, CY_U3P_GPIO_TIMER_HIGH_FREQ, CY_U3P_GPIO_TIMER_LOW_FREQ, CY_U3P_GPIO_TIMER_STANDBY_FREQ
+  } CyU3PGpioTimerMode_t;
+
+typedef struct {
+  uint8_t fastClkDiv;
+  uint8_t slowClkDiv;
+  CyBool_t halfDiv;
+  int simpleDiv;
+  int clkSrc;
+  } CyU3PGpioClock_t;
+
+typedef struct {
+  CyBool_t outValue;
+  CyBool_t driveLowEn;
+  CyBool_t driveHighEn;
+  CyBool_t inputEn;
+  CyU3PGpioIntrMode_t intrMode;
+  } CyU3PGpioSimpleConfig_t;
+
+typedef struct {
+  CyBool_t outValue;
+  CyBool_t driveLowEn;
+  CyBool_t driveHighEn;
+  CyBool_t inputEn;
+  CyU3PGpioComplexMode_t pinMode;
+  CyU3PGpioIntrMode_t intrMode;
+  CyU3PGpioTimerMode_t timerMode;
+  uint32_t timer;
+  uint32_t period;
+  uint32_t threshold;
+  } CyU3PGpioComplexConfig_t;
+
+typedef void (*CyU3PGpioIntrCb_t)(uint8_t gpioId);
+
+extern CyU3PReturnStatus_t CyU3PGpioInit (CyU3PGpioClock_t* clk_p, CyU3PGpioIntrCb_t irq);
+extern CyU3PReturnStatus_t CyU3PGpioSetSimpleConfig (uint8_t gpioId, CyU3PGpioSimpleConfig_t* cfg_p);
+extern CyU3PReturnStatus_t CyU3PGpioSetComplexConfig (uint8_t gpioId, CyU3PGpioComplexConfig_t* cfg_p);
+extern CyU3PReturnStatus_t CyU3PGpioComplexSampleNow (uint8_t gpioId, uint32_t* value_p);
+extern CyU3PReturnStatus_t CyU3PGpioGetValue (uint8_t gpioId, CyBool_t* value_p);
+extern CyU3PReturnStatus_t CyU3PGpioSetValue (uint8_t gpioId, CyBool_t value);
+//}}}
+//{{{  uart, i2c
+enum { CY_U3P_UART_BAUDRATE_115200 = 115200 };
+enum { CY_U3P_UART_ONE_STOP_BIT = 1 };
+enum { CY_U3P_UART_NO_PARITY };
+
+typedef struct {
+  int baudRate;
+  int stopBit;
+  int parity;
+  CyBool_t txEnable;
+  CyBool_t rxEnable;
+  CyBool_t flowCtrl;
+  CyBool_t isDma;
+  } CyU3PUartConfig_t;
+
+extern CyU3PReturnStatus_t CyU3PUartInit (void);
+extern CyU3PReturnStatus_t CyU3PUartSetConfig (CyU3PUartConfig_t* config, void* cb);
+extern CyU3PReturnStatus_t CyU3PUartTxSetBlockXfer (uint32_t txSize);
+extern CyU3PReturnStatus_t CyU3PDebugInit (int destSckId, uint8_t traceLevel);
+extern void CyU3PDebugPreamble (CyBool_t sendPreamble);
+
+typedef struct {
+  uint32_t bitRate;
+  CyBool_t isDma;
+  uint32_t busTimeout;
+  uint16_t dmaTimeout;
+  } CyU3PI2cConfig_t;
+
+typedef struct {
+  uint8_t buffer[8];
+  uint8_t length;
+  uint16_t ctrlMask;
+  } CyU3PI2cPreamble_t;
+
+extern CyU3PReturnStatus_t CyU3PI2cInit (void);
+extern CyU3PReturnStatus_t CyU3PI2cSetConfig (CyU3PI2cConfig_t* config, void* cb);
+extern CyU3PReturnStatus_t CyU3PI2cTransmitBytes (CyU3PI2cPreamble_t* preamble, uint8_t* data, uint32_t byteCount, uint32_t retryCount);
+extern CyU3PReturnStatus_t CyU3PI2cReceiveBytes (CyU3PI2cPreamble_t* preamble, uint8_t* data, uint32_t byteCount, uint32_t retryCount);
+extern CyU3PReturnStatus_t CyU3PI2cSendCommand (CyU3PI2cPreamble_t* preamble, uint32_t byteCount, CyBool_t isRead);
+extern CyU3PReturnStatus_t CyU3PI2cWaitForBlockXfer (CyBool_t isRead);
+extern CyU3PReturnStatus_t CyU3PI2cWaitForAck (CyU3PI2cPreamble_t* preamble, uint32_t retryCount);
+//}}}
@@ -0,0 +1,3 @@
+// cyu3types.h - host simulation stand-in, see cyu3sim.h
+#pragma once
+#include "cyu3sim.h"
@@ -0,0 +1,3 @@
+// cyu3usb.h - host simulation stand-in, see cyu3sim.h
+#pragma once
+#include "cyu3sim.h"
@@ -0,0 +1,191 @@
+// sensorSim.c - sensor and display stand-ins for the usbUVC host simulation
+// - mode, jpeg, frame interval as sensorMT9D.c sets them, frame period, size, pixel rate for the gpif producer
+// - jpeg frames vary in size, every 8th a whole number of dma buffers, full buffer end of frame
+//{{{  includes
+#include <stdio.h>
+
+#include <cyu3types.h>
+
+#include "../../common/sensor.h"
+#include "../../common/display.h"
+#include "sim.h"
+//}}}
+
+static int sensorLines = 600;
+static int sensorJpegOn = 0;
+static uint32_t sensorInterval = 333333;  // 100ns units
+static uint32_t sensorBaseInterval = 333333;
+
+int32_t simSensorControl[SIM_SENSOR_CONTROLS];
+uint32_t simSensorControls = 0;
+uint32_t simSensorCrops = 0;
+uint16_t simSensorCropWindow[5];
+uint32_t simSensorCropGapMin = 0xFFFFFFFF;
+static uint32_t cropFrame = 0;
+
+//{{{
+uint32_t simSensorPeriodNs() {
+// mode rate, stretched by frame interval as vblank does
+  return sensorInterval * 100;
+  }
+//}}}
+//{{{
+uint32_t simSensorBytesPerSec() {
+// pixel clock rate, yuy2 frame at mode rate in 90% of the frame, rest blanking, vblank does not change it
+
+  uint64_t bytes = (uint64_t)((sensorLines * 4) / 3) * sensorLines * 2;
+  return (bytes * 10000000ull * 10) / ((uint64_t)sensorBaseInterval * 9);
+  }
+//}}}
+//{{{
+uint32_t simSensorFrameBytes (uint32_t frame, uint32_t payload) {
+// yuy2 2 bytes a pixel, jpeg pseudo random w*h/8 to 3*w*h/8, even
+
+  uint32_t pixels = ((sensorLines * 4) / 3) * sensorLines;
+  if (!sensorJpegOn)
+    return pixels * 2;
+
+  uint32_t hash = frame * 2654435761u;
+  uint32_t bytes = (pixels / 8) + ((hash >> 8) % (pixels / 4));
+  if ((frame % 8) == 0)
+    bytes = ((bytes + payload - 1) / payload) * payload;
+  return bytes & ~1;
+  }
+//}}}
+
+//{{{
+void sensorScaling (int lines) {
+  sensorLines = lines;
+  }
+//}}}
+//{{{
+void sensorJpeg (int lines, int enable) {
+  sensorJpegOn = enable && simConfig.jpeg;
+  }
+//}}}
+//{{{
+int sensorJpegCapable() {
+  return simConfig.jpeg;
+  }
+//}}}
+//{{{
+void sensorFrameInterval (int lines, uint32_t interval) {
+// mt9d111, 30fps 600 lines, 15fps 1200 lines, slower by vblank
+
+  sensorBaseInterval = (lines == 1200) ? 666666 : 333333;
+  sensorInterval = (interval > sensorBaseInterval) ? interval : sensorBaseInterval;
+  }
+//}}}
+//{{{
+void sensorCrop (int lines, uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+
+  simLock();
+  if (simSensorCrops && (simCounters.sensorFrames - cropFrame < simSensorCropGapMin))
+    simSensorCropGapMin = simCounters.sensorFrames - cropFrame;
+  cropFrame = simCounters.sensorFrames;
+  simSensorCrops++;
+
+  simSensorCropWindow[0] = lines;
+  simSensorCropWindow[1] = x;
+  simSensorCropWindow[2] = y;
+  simSensorCropWindow[3] = width;
+  simSensorCropWindow[4] = height;
+  simUnlock();
+  }
+//}}}
+//{{{
+void sensorControl (int control, int value) {
+
+  simLock();
+  if ((control >= 0) && (control < SIM_SENSOR_CONTROLS))
+    simSensorControl[control] = value;
+  simSensorControls++;
+  simUnlock();
+  }
+//}}}
+//{{{
+void sensorStats (uint16_t* luma, uint16_t* sharpness) {
+
+  *luma = 128;
+  *sharpness = 0;
+  }
+//}}}
+//{{{
+void sensorAutoExposure (int enable) {
+  }
+//}}}
+//{{{
+int sensorExposure (uint32_t exposure) {
+  return 1;
+  }
+//}}}
+//{{{
+void sensorButton (int value) {
+  }
+//}}}
+//{{{
+void sensorFocus (int value) {
+  }
+//}}}
+//{{{
+void sensorInit() {
+  }
+//}}}
+//{{{
+uint32_t sensorInitMs() {
+  return 0;
+  }
+//}}}
+//{{{
+void sensorShadowCounters (uint32_t* hits, uint32_t* misses) {
+
+  *hits = 0;
+  *misses = 0;
+  }
+//}}}
+
+//{{{
+void I2C_Write (uint8_t hiAddr, uint8_t loAddr, uint8_t hiData, uint8_t loData) {
+  }
+//}}}
+//{{{
+void I2C_Read (uint8_t hiAddr, uint8_t loAddr, uint8_t* buf) {
+
+  buf[0] = 0;
+  buf[1] = 0;
+  }
+//}}}
+
+//{{{
+void drawRect (int16_t on, int16_t xorg, int16_t yorg, uint16_t xlen, uint16_t ylen) {
+  }
+//}}}
+//{{{
+void drawString (const char* str, int16_t xorg, int16_t yorg, uint16_t xlen, uint16_t ylen) {
+  }
+//}}}
+//{{{
+void line1 (const char* str) {
+
+  if (simConfig.verbose)
+    printf ("line1 %s\n", str);
+  }
+//}}}
+//{{{
+void line2 (const char* str) {
+
+  if (simConfig.verbose)
+    printf ("line2 %s\n", str);
+  }
+//}}}
+//{{{
+void line3 (const char* str, int32_t value) {
+
+  if (simConfig.verbose)
+    printf ("line3 %s %d\n", str, (int)value);
+  }
+//}}}
+//{{{
+void displayInit (const char* str) {
+  }
+//}}}
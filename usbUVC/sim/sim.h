@@ -0,0 +1,92 @@
+// sim.h - usbUVC host simulation, model settings, counters, host side of ep0 and ep3
+// - cyu3sim.c models the sdk, gpif producer, bulk host, sensorSim.c the sensor, simUVC.c the harness
+#pragma once
+
+#include <cyu3types.h>
+
+//{{{  settings, set by harness before fx3Main
+typedef struct simConfig {
+  CyU3PUSBSpeed_t speed;     // speed the host enumerates at
+  uint32_t heapBytes;        // dma buffer heap, cyfxtx.c 224KB
+  uint32_t gpifBytesPerSec;  // sensor pixel bus rate while frame valid, 8 bit bus, 0 from sensor mode
+  uint32_t hostBytesPerSec;  // host bulk read bandwidth
+  uint32_t hostLatencyUs;    // host scheduling gap before each transfer
+  uint32_t stallEveryMs;     // host stops reading stallMs every stallEveryMs, 0 never
+  uint32_t stallMs;
+  int jpeg;                  // sensor has a jpeg encoder
+  int verbose;               // firmware debug print, display lines
+  } simConfig_t;
+
+extern simConfig_t simConfig;
+//}}}
+//{{{  counters, model side
+typedef struct simCounters {
+  uint32_t sensorFrames;     // frames captured by gpif
+  uint32_t sensorMissed;     // sensor frames started while gpif was not armed, mid stream
+  uint64_t stolenNs;         // host vm stalls taken out of sim time
+  uint32_t prodStalls;       // gpif found its next buffer not free, pib overrun, sensor data lost till one frees
+  uint64_t prodStallNs;      // time gpif was without a buffer
+  uint64_t lostBytes;        // sensor bytes lost to overruns
+  uint32_t overrunFrames;    // frames with an overrun, data missing
+  uint32_t restarts;         // gpif re-armed after an end of frame
+  uint64_t restartNsSum;     // gpif end of frame to re-armed
+  uint64_t restartNsMax;
+  uint32_t resets;           // multi channel resets
+  uint32_t resetsUndrained;  // frame restart resets with buffers committed but not yet consumed
+  uint32_t wrapUpFails;      // SetWrapUp without a partial buffer in the socket
+  uint32_t commitErrors;     // commit or discard without a buffer from GetBuffer
+  uint32_t counterErrors;    // gpif data counter larger than the dma buffer payload
+  uint32_t statusPackets;    // ep2 status interrupt packets
+  uint64_t hostBytes;        // ep3 bytes read by host, headers included
+  uint32_t hostTransfers;
+  uint32_t hostDropped;      // transfers dropped by channel reset or flush before host read them
+  } simCounters_t;
+
+extern simCounters_t simCounters;
+//}}}
+
+// model time of firmware work, a buffer committed or copied at gpif done time plus these, so the
+// sim host's own scheduling does not decide overruns, the firmware still has to commit it
+#define SIM_FW_BUFFER_NS          10000ull      // dma callback, vid thread wake, header, commit
+#define SIM_FW_COPY_BYTES_PER_SEC 200000000ull  // ring mode cpu copy, fx3 arm9 memcpy
+
+#define SIM_FW_WAIT_NS            100000000ull  // firmware holding a gpif buffer longer, lost whatever its model time
+
+// sim time, ns since first call
+extern uint64_t simNowNs();
+extern void simSleepUntil (uint64_t ns);
+extern void simLock();
+extern void simUnlock();
+
+// sensor, sensorSim.c
+extern uint32_t simSensorPeriodNs();
+extern uint32_t simSensorBytesPerSec();
+extern uint32_t simSensorFrameBytes (uint32_t frame, uint32_t payload);
+
+// sensor calls seen, written by the firmware sensor thread under the model lock
+#define SIM_SENSOR_CONTROLS 16
+extern int32_t simSensorControl[SIM_SENSOR_CONTROLS];  // last sensorControl value by CONTROL_ id
+extern uint32_t simSensorControls;                     // sensorControl calls
+extern uint32_t simSensorCrops;                        // sensorCrop calls
+extern uint16_t simSensorCropWindow[5];                // last sensorCrop lines, x, y, width, height
+extern uint32_t simSensorCropGapMin;                   // fewest gpif frames between two sensorCrop calls
+
+// gpio input pin level, interrupt callback on change, pins read high till driven
+extern void simGpioInput (uint8_t gpioId, CyBool_t value);
+
+// frame data, one word per 4 bytes, byte offset in frame, 10 bit frame tag
+#define SIM_PATTERN(tag, offset) (((offset) & 0x3FFFFF) | (((tag) & 0x3FF) << 22))
+#define SIM_FRAME_TAGS 1024
+extern uint32_t simFrameBytes[SIM_FRAME_TAGS];     // bytes of each frame tag, written by gpif at frame start
+extern CyBool_t simFrameOverrun[SIM_FRAME_TAGS];   // frame tag lost data to an overrun, host sees it torn
+
+// host side of ep0, returns bytes of data stage, -1 stalled or no response
+extern int simControl (uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex,
+                       uint16_t wLength, uint8_t* data);
+
+// harness, simUVC.c, called with the model lock held
+extern const uint8_t simGpifEndStates[4];  // PARTIAL_BUF_IN_SCK0, SCK1, FULL_BUF_IN_SCK0, SCK1
+extern void simHostPayload (const uint8_t* data, uint32_t length);
+extern void simHookCommit (uint32_t commits, uint32_t consumed);
+extern void simHookRingSend (uint32_t sends, uint32_t consumed);
+extern void simHookArmed();
@@ -0,0 +1,875 @@
+// simUVC.c - usbUVC host simulation harness, firmware built unchanged against the cyu3sim.c sdk model
+// - host enumerates, probes, commits, reads ep3 like a bulk UVC host, checks every payload
+//   - header, frame ID toggles each frame, EOF on the last payload, nothing after it
+//   - data contiguous within a frame, frame bytes as the gpif producer sent them
+//   - a frame the model overran is expected torn, counted apart, fails unless the scenario expects it
+//   - firmware prodCount, consCount match the model's commits, consumed at every commit
+// - reports throughput, frame restart latency, gpif overruns for benchmarking pipeline changes
+// - decodes PTS, SCR, reports capture start to first and EOF payload commit latency per frame
+// - -B times the uvc header write against the byte copy it replaced
+// - -C issues control requests while streaming, each must complete, the stream must stay whole
+// - -P checks every processing unit control against puControls, SET_CUR reaches the sensor
+// - -Z checks the ptz crop window the sensor gets, and its rate limit
+// - -K presses the button, each edge a status packet the host counts on ep2, device and model agree
+// - -T triggers a still while streaming, one whole STI frame of STILL_SIZE, no still timeout
+//{{{  includes
+#define main fx3Main
+#include "../usbUVC.c"
+#undef main
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+//}}}
+
+const uint8_t simGpifEndStates[4] = { PARTIAL_BUF_IN_SCK0, PARTIAL_BUF_IN_SCK1, FULL_BUF_IN_SCK0, FULL_BUF_IN_SCK1 };
+
+//{{{  host checker state, model lock
+typedef struct hostCheck {
+  CyBool_t inFrame;
+  CyBool_t frameErr;        // ERR header bit, frame discarded by host, size not checked
+  CyBool_t frameTorn;       // data of an overrun frame broke off, size not checked
+  CyBool_t frameStill;      // STI header bit, still image frame, STILL_SIZE
+  uint8_t fid;
+  int lastFid;              // -1 none since stream start
+  uint32_t pts;
+  uint32_t tag;
+  uint32_t offset;          // frame bytes received
+
+  uint32_t frames;          // frames ended, EOF or frame ID toggle
+  uint32_t framesErr;       // frames ended with the ERR bit
+  uint32_t framesOverrun;   // frames the model overran, torn or short
+  uint32_t framesStill;     // whole still frames
+  uint64_t frameBytes;      // payload bytes of frames ended
+  uint64_t firstNs;         // first, last frame end
+  uint64_t lastNs;
+  uint64_t firstBytes;      // frameBytes at firstNs
+
+  uint32_t headerErrors;
+  uint32_t fidErrors;
+  uint32_t eofErrors;
+  uint32_t dataErrors;
+  uint32_t sizeErrors;
+  uint32_t countErrors;     // prodCount, consCount against model commits, consumed
+  uint32_t ringErrors;      // ringSent, ringOut against model sends, consumed
+
+  CyBool_t haveStc;         // SCR decode, source time clock of last payload
+  uint32_t lastStc;
+  uint32_t latencyStarts;   // frames started, PTS to SCR latency, capture start to first payload commit
+  uint32_t latencyFrames;   // frames with an EOF payload, capture start to EOF payload commit
+  uint64_t firstTicksSum;
+  uint64_t eofTicksSum;
+  uint32_t firstTicksMax;
+  uint32_t eofTicksMax;
+  } hostCheck_t;
+
+static hostCheck_t check = { CyFalse, CyFalse, CyFalse, CyFalse, 0, -1 };
+static CyBool_t quiet = CyFalse;   // stream being torn down by the harness, firmware counters settle at next arm
+static uint32_t messages = 0;
+//}}}
+//{{{
+static void fail (uint32_t* counter, const char* format, uint32_t a, uint32_t b) {
+// count, first few printed
+
+  (*counter)++;
+  if (messages++ < 10) {
+    printf ("frame %u: ", check.frames);
+    printf (format, a, b);
+    printf ("\n");
+    }
+  }
+//}}}
+
+// hooks, model lock held
+//{{{
+void simHookCommit (uint32_t commits, uint32_t consumed) {
+// vid thread counted the buffer before committing it, consumer callback counts as the model consumes
+
+  if (quiet || (channelMode != CHANNEL_UVC))
+    return;
+
+  if (prodCount != (uint16_t)commits)
+    fail (&check.countErrors, "prodCount %u, commits %u", prodCount, commits);
+  if (consCount != (uint16_t)consumed)
+    fail (&check.countErrors, "consCount %u, consumed %u", consCount, consumed);
+  }
+//}}}
+//{{{
+void simHookRingSend (uint32_t sends, uint32_t consumed) {
+
+  if (quiet)
+    return;
+
+  if (ringSent != sends)
+    fail (&check.ringErrors, "ringSent %u, sends %u", ringSent, sends);
+  if (ringOut != consumed)
+    fail (&check.ringErrors, "ringOut %u, consumed %u", ringOut, consumed);
+  }
+//}}}
+//{{{
+void simHookArmed() {
+  quiet = CyFalse;
+  }
+//}}}
+
+//{{{
+static void frameEnd (CyBool_t eof, uint32_t payload) {
+// frame ended by EOF, or by the next frame's ID toggle
+
+  uint32_t sent = simFrameBytes[check.tag];
+
+  if (check.frameErr)
+    check.framesErr++;
+  else if (check.frameTorn || simFrameOverrun[check.tag])
+    check.framesOverrun++;
+  else {
+    if (!eof && ((curFormat != FORMAT_MJPEG) || (check.offset != sent) || (check.offset % payload)))
+      // only a jpeg frame ending on a full buffer has no EOF payload
+      fail (&check.eofErrors, "frame without EOF, %u of %u bytes", check.offset, sent);
+    else if (check.offset != sent)
+      fail (&check.sizeErrors, "frame %u bytes, gpif sent %u", check.offset, sent);
+    else if ((curFormat == FORMAT_YUY2) && (sent != (check.frameStill ? STILL_SIZE : channelFrameSize)))
+      fail (&check.sizeErrors, "frame %u bytes, committed frame %u", sent, check.frameStill ? STILL_SIZE : channelFrameSize);
+    else if (check.frameStill)
+      check.framesStill++;
+    }
+
+  check.frames++;
+  check.frameBytes += check.offset;
+  check.lastNs = simNowNs();
+  if (!check.firstNs) {
+    check.firstNs = check.lastNs;
+    check.firstBytes = check.frameBytes;
+    }
+
+  check.lastFid = check.fid;
+  check.inFrame = CyFalse;
+  }
+//}}}
+//{{{
+void simHostPayload (const uint8_t* data, uint32_t length) {
+// one ep3 bulk transfer, one dma buffer, UVC header first
+
+  if ((length < CY_FX_UVC_MAX_HEADER) || (data[0] != CY_FX_UVC_MAX_HEADER) || !(data[1] & 0x80)) {
+    fail (&check.headerErrors, "bad header, length %u, bHeaderLength %u", length, length ? data[0] : 0);
+    check.inFrame = CyFalse;
+    return;
+    }
+
+  uint8_t bfh = data[1];
+  uint8_t fid = bfh & CY_FX_UVC_HEADER_FRAME_ID;
+  uint32_t pts = data[2] | (data[3] << 8) | (data[4] << 16) | ((uint32_t)data[5] << 24);
+  uint32_t stc = data[6] | (data[7] << 8) | (data[8] << 16) | ((uint32_t)data[9] << 24);
+  const uint8_t* payload = data + CY_FX_UVC_MAX_HEADER;
+
+  //{{{  SCR, source time clock never goes back, commit after capture start, sof 11 bits
+  if ((bfh & 0x0C) != 0x0C)
+    fail (&check.headerErrors, "PTS SCR bits not set, bfh %02x", bfh, 0);
+  if (check.haveStc && ((int32_t)(stc - check.lastStc) < 0))
+    fail (&check.headerErrors, "SCR went back, %u to %u", check.lastStc, stc);
+  if ((int32_t)(stc - pts) < 0)
+    fail (&check.headerErrors, "SCR %u before PTS %u", stc, pts);
+  if (data[11] & 0xF8)
+    fail (&check.headerErrors, "SCR sof %u over 11 bits", data[10] | (data[11] << 8), 0);
+  check.haveStc = CyTrue;
+  check.lastStc = stc;
+  //}}}
+  uint32_t bytes = length - CY_FX_UVC_MAX_HEADER;
+
+  if (check.inFrame && (fid != check.fid))
+    // frame ID toggled without an EOF on the previous frame
+    frameEnd (CyFalse, vidPlan.payload);
+
+  if (!check.inFrame) {
+    //{{{  first payload of frame
+    if ((check.lastFid >= 0) && (fid == check.lastFid))
+      fail (&check.fidErrors, "frame ID %u not toggled", fid, 0);
+
+    check.inFrame = CyTrue;
+    check.frameErr = CyFalse;
+    check.frameTorn = CyFalse;
+    check.frameStill = (bfh & CY_FX_UVC_HEADER_STILL) != 0;
+    check.fid = fid;
+    check.pts = pts;
+    check.offset = 0;
+
+    uint32_t ticks = stc - pts;
+    check.latencyStarts++;
+    check.firstTicksSum += ticks;
+    if (ticks > check.firstTicksMax)
+      check.firstTicksMax = ticks;
+    if (bytes >= 4) {
+      uint32_t word;
+      memcpy (&word, payload, 4);
+      check.tag = word >> 22;
+      if ((word & 0x3FFFFF) && simFrameOverrun[check.tag])
+        check.frameTorn = CyTrue;
+      else if (word & 0x3FFFFF)
+        fail (&check.dataErrors, "frame starts at byte %u of frame tag %u", word & 0x3FFFFF, word >> 22);
+      }
+    }
+    //}}}
+  else if (pts != check.pts)
+    fail (&check.headerErrors, "PTS changed within frame, %u to %u", check.pts, pts);
+  else if (((bfh & CY_FX_UVC_HEADER_STILL) != 0) != check.frameStill)
+    fail (&check.headerErrors, "STI bit changed within frame, bfh %02x", bfh, 0);
+
+  if (bfh & CY_FX_UVC_HEADER_ERR)
+    check.frameErr = CyTrue;
+
+  //{{{  data, frame pattern continues from last payload
+  if (!check.frameErr && !check.frameTorn) {
+    uint32_t words = bytes / 4;
+    for (uint32_t i = 0; i < words; i++) {
+      uint32_t word;
+      memcpy (&word, payload + i * 4, 4);
+      if (word != SIM_PATTERN (check.tag, check.offset + i * 4)) {
+        if (simFrameOverrun[check.tag])
+          check.frameTorn = CyTrue;
+        else {
+          fail (&check.dataErrors, "data at byte %u, tag %u", check.offset + i * 4, word >> 22);
+          check.frameErr = CyTrue;
+          }
+        break;
+        }
+      }
+    }
+
+  check.offset += bytes;
+  //}}}
+
+  if (bfh & CY_FX_UVC_HEADER_EOF) {
+    uint32_t ticks = stc - pts;
+    check.latencyFrames++;
+    check.eofTicksSum += ticks;
+    if (ticks > check.eofTicksMax)
+      check.eofTicksMax = ticks;
+    frameEnd (CyTrue, vidPlan.payload);
+    }
+  }
+//}}}
+//{{{
+static void hostResync() {
+// stream stopped by host, next frame starts fresh, firmware forgets its last frame ID
+
+  simLock();
+  quiet = CyTrue;
+  check.inFrame = CyFalse;
+  check.lastFid = -1;
+  simUnlock();
+  }
+//}}}
+
+// host requests
+//{{{
+static int vendor (uint8_t request, uint16_t value, uint16_t length, void* data) {
+
+  return simControl ((length && data) ? 0xC0 : 0x40, request, value, 0, length, data);
+  }
+//}}}
+//{{{
+static int unitControl (uint8_t request, uint8_t unit, uint16_t selector, uint16_t length, void* data) {
+// videoControl interface request to a unit, GET requests have bit 7 set
+
+  return simControl ((request & 0x80) ? CY_FX_USB_UVC_GET_REQ_TYPE : CY_FX_USB_UVC_SET_REQ_TYPE, request, selector,
+                     (unit << 8) | CY_FX_UVC_CONTROL_INTERFACE, length, data);
+  }
+//}}}
+//{{{
+static int commit (uint8_t format, uint8_t frameIndex, uint32_t interval, uint8_t* probe) {
+// probe SET_CUR, GET_CUR, commit SET_CUR with what the device settled on
+
+  CyU3PMemSet (probe, 0, CY_FX_UVC_MAX_PROBE_SETTING);
+  probe[2] = format;
+  probe[3] = frameIndex;
+  probe[4] = interval;
+  probe[5] = interval >> 8;
+  probe[6] = interval >> 16;
+  probe[7] = interval >> 24;
+
+  if ((simControl (CY_FX_USB_UVC_SET_REQ_TYPE, CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_PROBE_CTRL,
+                   CY_FX_UVC_STREAM_INTERFACE, CY_FX_UVC_MAX_PROBE_SETTING, probe) < 0) ||
+      (simControl (CY_FX_USB_UVC_GET_REQ_TYPE, CY_FX_USB_UVC_GET_CUR_REQ, CY_FX_UVC_PROBE_CTRL,
+                   CY_FX_UVC_STREAM_INTERFACE, CY_FX_UVC_MAX_PROBE_SETTING, probe) != CY_FX_UVC_MAX_PROBE_SETTING))
+    return -1;
+
+  return simControl (CY_FX_USB_UVC_SET_REQ_TYPE, CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_COMMIT_CTRL,
+                     CY_FX_UVC_STREAM_INTERFACE, CY_FX_UVC_MAX_PROBE_SETTING, probe);
+  }
+//}}}
+//{{{
+static int clearFeature() {
+// host stops streaming, CLEAR_FEATURE ENDPOINT_HALT on the video endpoint
+
+  hostResync();
+  return simControl (CY_U3P_USB_TARGET_ENDPT, CY_U3P_USB_SC_CLEAR_FEATURE, CY_U3P_USBX_FS_EP_HALT,
+                     CY_FX_EP_BULK_VID, 0, NULL);
+  }
+//}}}
+//{{{
+static CyBool_t waitFrames (uint32_t frames, uint64_t timeoutNs) {
+
+  uint64_t deadline = simNowNs() + timeoutNs;
+  for (;;) {
+    simLock();
+    uint32_t got = check.frames;
+    simUnlock();
+    if (got >= frames)
+      return CyTrue;
+    if (simNowNs() > deadline)
+      return CyFalse;
+    usleep (10000);
+    }
+  }
+//}}}
+
+//{{{  control traffic, host thread issues control requests while the stream runs
+typedef struct controlTraffic {
+  volatile int stop;
+  uint32_t requests;
+  uint32_t errors;          // stalled, short, or GET_CUR not what SET_CUR set
+  uint64_t maxNs;           // longest request, setup to status stage
+  } controlTraffic_t;
+
+static controlTraffic_t traffic;
+//}}}
+//{{{
+static void* controlTrafficThread (void* arg) {
+// brightness SET_CUR then GET_CUR must read it back, zoom GET_CUR, a round each ms like a host control panel
+
+  uint16_t brightness = 0;
+  while (!traffic.stop) {
+    uint64_t startNs = simNowNs();
+
+    uint8_t set[2] = { brightness & 0xFF, brightness >> 8 };
+    uint8_t get[2] = { 0xFF, 0xFF };
+    uint8_t zoom[2];
+    if ((unitControl (CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_PROCESSING_UNIT_ID,
+                      CY_FX_UVC_PU_BRIGHTNESS_CONTROL, 2, set) != 2) ||
+        (unitControl (CY_FX_USB_UVC_GET_CUR_REQ, CY_FX_UVC_PROCESSING_UNIT_ID,
+                      CY_FX_UVC_PU_BRIGHTNESS_CONTROL, 2, get) != 2) ||
+        (memcmp (set, get, 2) != 0) ||
+        (unitControl (CY_FX_USB_UVC_GET_CUR_REQ, CY_FX_UVC_CAMERA_TERMINAL_ID,
+                      CY_FX_UVC_CT_ZOOM_ABSOLUTE_CONTROL, 2, zoom) != 2))
+      traffic.errors++;
+    traffic.requests += 3;
+
+    uint64_t ns = (simNowNs() - startNs) / 3;
+    if (ns > traffic.maxNs)
+      traffic.maxNs = ns;
+
+    brightness = (brightness + 1) % 256;
+    usleep (1000);
+    }
+
+  return NULL;
+  }
+//}}}
+//{{{
+static CyBool_t sensorApplied (int control, int16_t value) {
+// sensor thread applies SET_CUR after the status stage, wait for it
+
+  uint64_t deadline = simNowNs() + 200000000ull;
+  for (;;) {
+    simLock();
+    CyBool_t applied = simSensorControl[control] == value;
+    simUnlock();
+    if (applied)
+      return CyTrue;
+    if (simNowNs() > deadline)
+      return CyFalse;
+    usleep (1000);
+    }
+  }
+//}}}
+//{{{
+static uint32_t puRoundTrip() {
+// every puControls entry, GET_LEN, GET_INFO, MIN MAX RES DEF as the table has them, SET_CUR GET_CUR round trip,
+// sensorControl applied, unlisted selector stalls
+// - out of range SET_CUR, white balance temperature SET_CUR while auto, dropped, GET_CUR unchanged
+
+  uint32_t errors = 0;
+  uint16_t wbTemp = CY_FX_UVC_PU_WHITE_BALANCE_TEMPERATURE_CONTROL;
+
+  for (int pass = 0; pass < 2; pass++) {
+    // second pass, the first left white balance auto on its min, off, temperature settable
+    for (uint32_t index = 1; index < PU_CONTROLS; index++) {
+      const puControl_t* control = &puControls[index];
+      uint16_t selector = index << 8;
+      uint8_t data[2] = { 0, 0 };
+      if (!control->length) {
+        if (unitControl (CY_FX_USB_UVC_GET_CUR_REQ, CY_FX_UVC_PROCESSING_UNIT_ID, selector, 2, data) >= 0)
+          fail (&errors, "pu %u not listed, GET_CUR not stalled", index, 0);
+        continue;
+        }
+
+      CyBool_t disabled = (pass == 0) && (selector == wbTemp);
+      int16_t limits[4] = { control->min, control->max, control->res, control->def };
+      uint8_t limitReqs[4] = { CY_FX_USB_UVC_GET_MIN_REQ, CY_FX_USB_UVC_GET_MAX_REQ,
+                               CY_FX_USB_UVC_GET_RES_REQ, CY_FX_USB_UVC_GET_DEF_REQ };
+      for (int i = 0; i < 4; i++) {
+        data[0] = data[1] = 0;
+        if ((unitControl (limitReqs[i], CY_FX_UVC_PROCESSING_UNIT_ID, selector, control->length, data) != control->length) ||
+            ((int16_t)(data[0] | (data[1] << 8)) != limits[i]))
+          fail (&errors, "pu %u request %02x", index, limitReqs[i]);
+        }
+
+      if ((unitControl (CY_FX_USB_UVC_GET_LEN_REQ, CY_FX_UVC_PROCESSING_UNIT_ID, selector, 2, data) != 2) ||
+          (data[0] != control->length))
+        fail (&errors, "pu %u GET_LEN %u", index, data[0]);
+      if ((unitControl (CY_FX_USB_UVC_GET_INFO_REQ, CY_FX_UVC_PROCESSING_UNIT_ID, selector, 1, data) != 1) ||
+          (data[0] != (disabled ? 0x07 : 0x03)))
+        fail (&errors, "pu %u GET_INFO %02x", index, data[0]);
+
+      int16_t value = (control->def == control->max) ? control->min : control->max;
+      int16_t expect = disabled ? control->def : value;
+      for (int over = 0; over < 2; over++) {
+        // then over max, dropped
+        int16_t set = over ? control->max + 1 : value;
+        data[0] = set & 0xFF;
+        data[1] = (set >> 8) & 0xFF;
+        if (unitControl (CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_PROCESSING_UNIT_ID, selector, control->length, data) != control->length)
+          fail (&errors, "pu %u SET_CUR %d", index, set);
+
+        data[0] = data[1] = 0;
+        if ((unitControl (CY_FX_USB_UVC_GET_CUR_REQ, CY_FX_UVC_PROCESSING_UNIT_ID, selector, control->length, data) != control->length) ||
+            ((int16_t)(data[0] | ((control->length == 2) ? (data[1] << 8) : 0)) != expect))
+          fail (&errors, "pu %u GET_CUR not %d", index, expect);
+        }
+      if (!disabled && !sensorApplied (control->control, value))
+        fail (&errors, "pu %u sensorControl not %d", index, value);
+      }
+    }
+
+  return errors;
+  }
+//}}}
+//{{{
+static uint32_t ptzCrop (uint64_t timeoutNs) {
+// zoom 4x, pan half right, tilt full down, then a burst of zoom SET_CURs ending on 4x
+// - window applied at most every PTZ_RATE_FRAMES gpif frames, last window is the 4x one
+// - 800x600 mode, 200x150 crop, x 300 + half of 300, y 225 + 225
+
+  uint32_t errors = 0;
+  simLock();
+  uint32_t frames = check.frames;
+  simUnlock();
+  waitFrames (frames + 2 * PTZ_RATE_FRAMES, timeoutNs);
+
+  uint8_t zoom[2] = { 255, 0 };
+  int32_t pantilt[2] = { PANTILT_MAX / 2, PANTILT_MIN };
+  if ((unitControl (CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_CAMERA_TERMINAL_ID, CY_FX_UVC_CT_ZOOM_ABSOLUTE_CONTROL, 2, zoom) != 2) ||
+      (unitControl (CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_CAMERA_TERMINAL_ID, CY_FX_UVC_CT_PANTILT_ABSOLUTE_CONTROL, 8, pantilt) != 8))
+    fail (&errors, "ptz SET_CUR", 0, 0);
+  for (int i = 0; i < 20; i++) {
+    zoom[0] = 255 - (i & 1);
+    unitControl (CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_CAMERA_TERMINAL_ID, CY_FX_UVC_CT_ZOOM_ABSOLUTE_CONTROL, 2, zoom);
+    usleep (2000);
+    }
+  zoom[0] = 255;
+  unitControl (CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_CAMERA_TERMINAL_ID, CY_FX_UVC_CT_ZOOM_ABSOLUTE_CONTROL, 2, zoom);
+
+  simLock();
+  frames = check.frames;
+  simUnlock();
+  waitFrames (frames + 3 * PTZ_RATE_FRAMES, timeoutNs);
+
+  zoom[0] = zoom[1] = 0;
+  if ((unitControl (CY_FX_USB_UVC_GET_CUR_REQ, CY_FX_UVC_CAMERA_TERMINAL_ID, CY_FX_UVC_CT_ZOOM_ABSOLUTE_CONTROL, 2, zoom) != 2) ||
+      (zoom[0] != 255))
+    fail (&errors, "ptz zoom GET_CUR %u", zoom[0], 0);
+
+  simLock();
+  uint16_t window[5];
+  memcpy (window, simSensorCropWindow, sizeof(window));
+  uint32_t crops = simSensorCrops;
+  uint32_t gapMin = simSensorCropGapMin;
+  simUnlock();
+
+  printf ("  ptz crops %u, min gap %u frames, window %u lines %u,%u %ux%u\n",
+          crops, gapMin, window[0], window[1], window[2], window[3], window[4]);
+  if ((window[0] != 600) || (window[1] != 450) || (window[2] != 450) || (window[3] != 200) || (window[4] != 150))
+    fail (&errors, "ptz window %u,%u", window[1], window[2]);
+  if ((crops < 2) || (gapMin < PTZ_RATE_FRAMES))
+    fail (&errors, "ptz %u crops, min gap %u frames", crops, gapMin);
+
+  return errors;
+  }
+//}}}
+//{{{
+static uint32_t buttonStatus() {
+// button press, release before streaming, a VS button status packet on ep2 for each edge
+// - press posts a still, no stream so stillCapture returns without one
+
+  uint32_t errors = 0;
+  simLock();
+  uint32_t packets = simCounters.statusPackets;
+  simUnlock();
+
+  for (int edge = 0; edge < 2; edge++) {
+    simGpioInput (BUTTON_GPIO, edge ? CyTrue : CyFalse);
+    uint64_t deadline = simNowNs() + 1000000000ull;
+    for (;;) {
+      simLock();
+      uint32_t got = simCounters.statusPackets;
+      simUnlock();
+      if (got >= packets + edge + 1)
+        break;
+      if (simNowNs() > deadline) {
+        fail (&errors, "button edge %u, no status packet", edge, 0);
+        break;
+        }
+      usleep (1000);
+      }
+    }
+
+  telemetry_t device;
+  CyU3PMemSet ((uint8_t*)&device, 0, sizeof(device));
+  vendor (0xB2, 0, sizeof(device), &device);
+  simLock();
+  uint32_t sent = simCounters.statusPackets - packets;
+  simUnlock();
+
+  printf ("  button status packets %u, device sent %u drops %u\n", sent, device.statusSent, device.statusDrops);
+  if ((sent != 2) || (device.statusSent != 2) || device.statusDrops)
+    fail (&errors, "button status packets %u, device sent %u", sent, device.statusSent);
+
+  return errors;
+  }
+//}}}
+//{{{
+static uint32_t stillTrigger (uint64_t timeoutNs) {
+// VS still trigger while streaming yuy2 bulk, one whole STI frame of STILL_SIZE, then preview again
+// - frames around the mode switches carry ERR, the host drops them
+
+  uint32_t errors = 0;
+  simLock();
+  uint32_t frames = check.frames;
+  simUnlock();
+  waitFrames (frames + 10, timeoutNs);
+
+  uint8_t trigger[1] = { 1 };
+  if (simControl (CY_FX_USB_UVC_SET_REQ_TYPE, CY_FX_USB_UVC_SET_CUR_REQ, CY_FX_UVC_STILL_TRIGGER_CTRL, CY_FX_UVC_STREAM_INTERFACE, 1, trigger) != 1)
+    fail (&errors, "still trigger SET_CUR", 0, 0);
+
+  // GET_CUR 1 while the still is in progress, back to 0 once preview resumes
+  uint64_t deadline = simNowNs() + 2000000000ull;
+  usleep (10000);
+  for (;;) {
+    trigger[0] = 0xFF;
+    if (simControl (CY_FX_USB_UVC_GET_REQ_TYPE, CY_FX_USB_UVC_GET_CUR_REQ, CY_FX_UVC_STILL_TRIGGER_CTRL, CY_FX_UVC_STREAM_INTERFACE, 1, trigger) != 1) {
+      fail (&errors, "still trigger GET_CUR", 0, 0);
+      break;
+      }
+    if (!trigger[0])
+      break;
+    if (simNowNs() > deadline) {
+      fail (&errors, "still in progress after 2s", 0, 0);
+      break;
+      }
+    usleep (10000);
+    }
+
+  simLock();
+  frames = check.frames;
+  simUnlock();
+  waitFrames (frames + 4, timeoutNs);
+
+  telemetry_t device;
+  CyU3PMemSet ((uint8_t*)&device, 0, sizeof(device));
+  vendor (0xB2, 0, sizeof(device), &device);
+  simLock();
+  uint32_t stills = check.framesStill;
+  uint32_t framesErr = check.framesErr;
+  simUnlock();
+
+  printf ("  still frames %u, device stills %u timeouts %u gap ms %u, err frames %u\n",
+          stills, device.stills, device.stillTimeouts, device.stillGapMsLast, framesErr);
+  if ((stills != 1) || (device.stills != 1) || device.stillTimeouts)
+    fail (&errors, "still frames %u, timeouts %u", stills, device.stillTimeouts);
+
+  return errors;
+  }
+//}}}
+//{{{
+static uint64_t benchNs() {
+// thread cpu time, host scheduling and vm stalls not counted
+
+  struct timespec ts;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  }
+//}}}
+//{{{
+static int headerBench (uint32_t count) {
+// microbenchmark, ns per committed buffer header, host cpu, not fx3 cycles
+// - copy, 12 byte header copied a byte at a time like the sdk CyU3PMemCopy, the header before uvcHeaderWrite
+// - write, uvcHeaderWrite word stores in place, including its two timer samples
+// - timers, the two samples alone, a clock read here, a gpio register read on the fx3
+// - best of 5 rounds each, host noise only adds
+// - checks the header uvcHeaderWrite left in front of the buffer
+
+  static const uint8_t header[CY_FX_UVC_MAX_HEADER] = { CY_FX_UVC_MAX_HEADER, CY_FX_UVC_HEADER_DEFAULT_BFH };
+  static uint32_t words[16];
+  uint8_t* buffer = (uint8_t*)&words[4];   // header area word aligned in front, as in a dma buffer
+
+  volatile uint8_t* dest = buffer - CY_FX_UVC_MAX_HEADER;
+  volatile uint32_t sink = 0;
+  uint64_t copyNs = ~0ull;
+  uint64_t writeNs = ~0ull;
+  uint64_t timerNs = ~0ull;
+  for (int round = 0; round < 5; round++) {
+    uint64_t startNs = benchNs();
+    for (uint32_t i = 0; i < count; i++)
+      for (uint32_t j = 0; j < CY_FX_UVC_MAX_HEADER; j++)
+        dest[j] = header[j];
+    uint64_t ns = benchNs() - startNs;
+    copyNs = (ns < copyNs) ? ns : copyNs;
+
+    startNs = benchNs();
+    for (uint32_t i = 0; i < count; i++)
+      uvcHeaderWrite (buffer, (i & 1) ? CY_FX_UVC_HEADER_EOF : CY_FX_UVC_HEADER_FRAME);
+    ns = benchNs() - startNs;
+    writeNs = (ns < writeNs) ? ns : writeNs;
+
+    startNs = benchNs();
+    for (uint32_t i = 0; i < count; i++)
+      sink += timerTicks() + CyU3PGetTime();
+    ns = benchNs() - startNs;
+    timerNs = (ns < timerNs) ? ns : timerNs;
+    }
+
+  printf ("header bench %u buffers, ns per buffer copy %.2f, write %.2f, timers %.2f, write less timers %.2f\n",
+          count, (double)copyNs / count, (double)writeNs / count, (double)timerNs / count,
+          ((double)writeNs - (double)timerNs) / count);
+
+  uint8_t eof = ((count - 1) & 1) ? CY_FX_UVC_HEADER_EOF : CY_FX_UVC_HEADER_FRAME;
+  if ((buffer[-CY_FX_UVC_MAX_HEADER] != CY_FX_UVC_MAX_HEADER) ||
+      (buffer[-CY_FX_UVC_MAX_HEADER + 1] != (uvcHeaderBFH | uvcFrameFlags | eof))) {
+    printf ("FAIL header %02x %02x\n", buffer[-CY_FX_UVC_MAX_HEADER], buffer[-CY_FX_UVC_MAX_HEADER + 1]);
+    return 1;
+    }
+  return 0;
+  }
+//}}}
+//{{{
+static void usage() {
+
+  printf ("simUVC [options]\n"
+          "  -s hs|ss      usb speed, default ss\n"
+          "  -f index      frame index, default 1\n"
+          "  -i interval   frame interval 100ns units, default fastest\n"
+          "  -n frames     frames to check, default 60\n"
+          "  -g MB/s       gpif rate while frame valid, default yuy2 frame in 90%% of the sensor frame\n"
+          "  -b MB/s       host bulk bandwidth, default 350 ss, 40 hs\n"
+          "  -l us         host latency before each transfer, default 20\n"
+          "  -S every:ms   host stops reading ms every every ms\n"
+          "  -H KB         dma buffer heap, default 224\n"
+          "  -e            overruns and error frames expected, not a failure\n"
+          "  -c            continuous gpif, vendor 0xB4\n"
+          "  -r            ring mode, vendor 0xB3\n"
+          "  -j            mjpeg, sensor with jpeg encoder\n"
+          "  -a            clear feature stop, recommit halfway\n"
+          "  -B            uvc header microbenchmark, no stream\n"
+          "  -C            control requests while streaming, PU brightness SET GET, CT zoom GET\n"
+          "  -P            processing unit round trip while streaming, every control\n"
+          "  -Z            ptz while streaming, crop window and its rate limit, frame index 1\n"
+          "  -K            button press, release before streaming, ep2 status packets\n"
+          "  -T            still trigger while streaming, one STI frame, ERR frames around it expected\n"
+          "  -v            firmware debug print\n");
+  exit (2);
+  }
+//}}}
+//{{{
+int main (int argc, char** argv) {
+
+  uint8_t frameIndex = 1;
+  uint32_t interval = 0;
+  uint32_t frames = 60;
+  uint32_t hostMBs = 0;
+  int continuous = 0;
+  int ring = 0;
+  int abortHalfway = 0;
+  int expectLoss = 0;
+  int bench = 0;
+  int controls = 0;
+  int puCheck = 0;
+  int ptz = 0;
+  int button = 0;
+  int still = 0;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "s:f:i:n:g:b:l:S:H:ecrjaBCPZKTv")) != -1) {
+    switch (opt) {
+      case 's': simConfig.speed = strcmp (optarg, "hs") ? CY_U3P_SUPER_SPEED : CY_U3P_HIGH_SPEED; break;
+      case 'f': frameIndex = atoi (optarg); break;
+      case 'i': interval = strtoul (optarg, NULL, 0); break;
+      case 'n': frames = atoi (optarg); break;
+      case 'g': simConfig.gpifBytesPerSec = atoi (optarg) * 1000000; break;
+      case 'b': hostMBs = atoi (optarg); break;
+      case 'l': simConfig.hostLatencyUs = atoi (optarg); break;
+      case 'S': if (sscanf (optarg, "%u:%u", &simConfig.stallEveryMs, &simConfig.stallMs) != 2) usage(); break;
+      case 'H': simConfig.heapBytes = atoi (optarg) * 1024; break;
+      case 'e': expectLoss = 1; break;
+      case 'c': continuous = 1; break;
+      case 'r': ring = 1; break;
+      case 'j': simConfig.jpeg = 1; break;
+      case 'a': abortHalfway = 1; break;
+      case 'B': bench = 1; break;
+      case 'C': controls = 1; break;
+      case 'P': puCheck = 1; break;
+      case 'Z': ptz = 1; break;
+      case 'K': button = 1; break;
+      case 'T': still = 1; break;
+      case 'v': simConfig.verbose = 1; break;
+      default: usage();
+      }
+    }
+  simConfig.hostBytesPerSec = (hostMBs ? hostMBs : (simConfig.speed == CY_U3P_SUPER_SPEED) ? 350 : 40) * 1000000;
+  if (bench)
+    return headerBench (200000);
+
+  fx3Main();
+  uint32_t buttonErrors = button ? buttonStatus() : 0;
+
+  //{{{  stream
+  uint8_t probe[CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED];
+  vendor (0xB3, ring, 0, NULL);
+  vendor (0xB4, continuous, 0, NULL);
+  if (commit (simConfig.jpeg ? FORMAT_MJPEG : FORMAT_YUY2, frameIndex, interval, probe) < 0) {
+    printf ("commit failed\n");
+    return 1;
+    }
+
+  uint32_t committed = probe[4] | (probe[5] << 8) | (probe[6] << 16) | ((uint32_t)probe[7] << 24);
+  uint64_t timeoutNs = (uint64_t)frames * committed * 100 * 4 + 2000000000ull;
+
+  uint32_t puErrors = puCheck ? puRoundTrip() : 0;
+  uint32_t ptzErrors = ptz ? ptzCrop (timeoutNs) : 0;
+  uint32_t stillErrors = still ? stillTrigger (timeoutNs) : 0;
+
+  pthread_t trafficThread;
+  if (controls)
+    pthread_create (&trafficThread, NULL, controlTrafficThread, NULL);
+
+  CyBool_t ok = CyTrue;
+  if (abortHalfway) {
+    ok = waitFrames (frames / 2, timeoutNs);
+    clearFeature();
+    usleep (50000);
+    if (commit (simConfig.jpeg ? FORMAT_MJPEG : FORMAT_YUY2, frameIndex, interval, probe) < 0) {
+      printf ("recommit failed\n");
+      return 1;
+      }
+    }
+  ok = waitFrames (frames, timeoutNs) && ok;
+
+  if (controls) {
+    traffic.stop = 1;
+    pthread_join (trafficThread, NULL);
+    }
+  //}}}
+  //{{{  read device counters
+  telemetry_t deviceTelemetry;
+  bufferPlan_t devicePlan;
+  startStats_t deviceStart;
+  CyU3PMemSet ((uint8_t*)&deviceTelemetry, 0, sizeof(deviceTelemetry));
+  CyU3PMemSet ((uint8_t*)&devicePlan, 0, sizeof(devicePlan));
+  CyU3PMemSet ((uint8_t*)&deviceStart, 0, sizeof(deviceStart));
+  vendor (0xB2, 0, sizeof(deviceTelemetry), &deviceTelemetry);
+  vendor (0xB1, 0, sizeof(devicePlan), &devicePlan);
+  vendor (0xB0, 0, sizeof(deviceStart), &deviceStart);
+  //}}}
+
+  simLock();
+  hostCheck_t result = check;
+  simCounters_t model = simCounters;
+  simUnlock();
+
+  //{{{  report
+  double seconds = (result.lastNs - result.firstNs) / 1e9;
+  double mbs = seconds > 0 ? (result.frameBytes - result.firstBytes) / seconds / 1e6 : 0;
+  double fps = seconds > 0 ? (result.frames - 1) / seconds : 0;
+
+  printf ("%s %s frame %u %u bytes, interval %u, %s%s, buffers %u x %u bytes, payload %u\n",
+          (simConfig.speed == CY_U3P_SUPER_SPEED) ? "ss" : "hs",
+          (curFormat == FORMAT_MJPEG) ? "mjpeg" : "yuy2", curFrameIndex, channelFrameSize, committed,
+          (channelMode == CHANNEL_RING) ? "ring" : "uvc", vidContinuous ? " continuous" : "",
+          devicePlan.count, devicePlan.size, devicePlan.payload);
+  printf ("  frames %u, err %u, overrun %u, %.1f fps, %.1f MB/s, device %u B/s, vid busy %u/1000\n",
+          result.frames, result.framesErr, result.framesOverrun, fps, mbs, deviceTelemetry.bytesPerSec, deviceTelemetry.vidBusyPerMille);
+  printf ("  restart us device last %u max %u, model avg %.1f max %.1f over %u\n",
+          deviceTelemetry.restartUsLast, deviceTelemetry.restartUsMax,
+          model.restarts ? model.restartNsSum / 1e3 / model.restarts : 0.0, model.restartNsMax / 1e3, model.restarts);
+  printf ("  sensor frames %u missed %u, gpif overruns %u in %u frames %.1f ms %llu bytes lost, maxLag %u, pib overruns %u %u\n",
+          model.sensorFrames, model.sensorMissed, model.prodStalls, model.overrunFrames,
+          model.prodStallNs / 1e6, (unsigned long long)model.lostBytes,
+          deviceTelemetry.maxLag, deviceTelemetry.pibErrors[5], deviceTelemetry.pibErrors[6]);
+  printf ("  host %u transfers %llu bytes, dropped %u, ring drops %u torn %u maxUsed %u, stream start us %u\n",
+          model.hostTransfers, (unsigned long long)model.hostBytes, model.hostDropped,
+          deviceTelemetry.ringDrops, deviceTelemetry.ringTorn, deviceTelemetry.ringMaxUsed, deviceStart.firstConsUs);
+  double usPerTick = 1e6 / timerFrequency();
+  printf ("  latency us capture start to first commit avg %.1f max %.1f, to eof commit avg %.1f max %.1f, %u frames\n",
+          result.latencyStarts ? result.firstTicksSum * usPerTick / result.latencyStarts : 0.0, result.firstTicksMax * usPerTick,
+          result.latencyFrames ? result.eofTicksSum * usPerTick / result.latencyFrames : 0.0, result.eofTicksMax * usPerTick,
+          result.latencyFrames);
+  if (controls)
+    printf ("  controls %u requests, %u errors, max %.1f us, setup drops %u, sensor drops %u\n",
+            traffic.requests, traffic.errors, traffic.maxNs / 1e3, deviceTelemetry.setupDrops, deviceTelemetry.sensorDrops);
+  printf ("  errors header %u fid %u eof %u data %u size %u count %u ring %u\n",
+          result.headerErrors, result.fidErrors, result.eofErrors, result.dataErrors, result.sizeErrors,
+          result.countErrors, result.ringErrors);
+  printf ("  model resets %u undrained %u, wrapUp fails %u, commit errors %u device %u, counter errors %u, vm stalls %.1f ms\n",
+          model.resets, model.resetsUndrained, model.wrapUpFails, model.commitErrors,
+          deviceTelemetry.commitFails, model.counterErrors, model.stolenNs / 1e6);
+  printf ("  status packets %u, device sent %u drops %u\n",
+          model.statusPackets, deviceTelemetry.statusSent, deviceTelemetry.statusDrops);
+  //}}}
+
+  // commit after a clear feature reset fails on the device too, counted by both
+  // status packets read after the device counters, ae may send one in between
+  if (!ok)
+    printf ("FAIL timeout, %u of %u frames\n", result.frames, frames);
+  if (result.headerErrors || result.fidErrors || result.eofErrors || result.dataErrors || result.sizeErrors ||
+      result.countErrors || result.ringErrors ||
+      model.resetsUndrained || model.wrapUpFails || model.counterErrors ||
+      (model.commitErrors != deviceTelemetry.commitFails) ||
+      (model.statusPackets < deviceTelemetry.statusSent) || deviceTelemetry.statusDrops) {
+    printf ("FAIL\n");
+    ok = CyFalse;
+    }
+  if (stillErrors) {
+    printf ("FAIL still, %u errors\n", stillErrors);
+    ok = CyFalse;
+    }
+  if (buttonErrors) {
+    printf ("FAIL button, %u errors\n", buttonErrors);
+    ok = CyFalse;
+    }
+  if (ptzErrors) {
+    printf ("FAIL ptz, %u errors\n", ptzErrors);
+    ok = CyFalse;
+    }
+  if (puErrors) {
+    printf ("FAIL processing unit, %u errors\n", puErrors);
+    ok = CyFalse;
+    }
+  if (controls && (!traffic.requests || traffic.errors || deviceTelemetry.setupDrops || deviceTelemetry.sensorDrops)) {
+    printf ("FAIL controls, %u errors in %u requests\n", traffic.errors, traffic.requests);
+    ok = CyFalse;
+    }
+  // a still switches the sensor mode, frames around it carry ERR
+  if (!expectLoss && ((result.framesErr && !still) || result.framesOverrun || model.overrunFrames ||
+                      deviceTelemetry.pibErrors[5] || deviceTelemetry.pibErrors[6])) {
+    printf ("FAIL frames lost, err %u overrun %u\n", result.framesErr, model.overrunFrames);
+    ok = CyFalse;
+    }
+
+  return ok ? 0 : 1;
+  }
+//}}}
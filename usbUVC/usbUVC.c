@@ -16,17 +16,25 @@
 #include "../common/display.h"
 #include "../common/sensor.h"
 #include "../common/ptz.h"
+#include "../common/timer.h"
+#include "../common/bufferPlan.h"
+#include "../common/analyser.h"
 #include "cyfxgpif2config.h"
 //}}}
-//#define lines1200
 //{{{  defines
 #define RESET_GPIO  22  // CTL 5 pin
 #define BUTTON_GPIO 45
 
+// CyFxGpifRegValue index of the designer's CY_U3P_PIB_GPIF_THREAD_CONFIG words, threads 0..3
+// - socket bits 0..4, watermark 8..15, burst 16..19, flag on data bit 30, enable bit 31
+#define GPIF_THREAD_CONFIG 63
+
 // endpoints
 #define CY_FX_EP_CONSUMER       0x81 // EP1 in
 #define CY_FX_EP_CONTROL_STATUS 0x82 // EP2 IN
-#define CY_FX_EP_BULK_VID       0x83 // EP3 IN
+#define CY_FX_EP_BULK_VID       0x83 // EP3 IN, bulk or isochronous with UVC_ISOC
+
+#define UVC_ISOC 0 // 1 stream on isochronous alt settings 1..n of the VS interface, 0 bulk in alt 0
 
 //{{{  BOS for SS codes
 #define CY_FX_BOS_DSCR_TYPE             15
@@ -40,13 +48,161 @@
 #define CY_FX_CONTAINER_ID_CAPBD_TYPE   4
 //}}}
 
+//{{{  format, frame tables
+// X (frame index, width, height, 3 frame intervals in 100ns units fastest first)
+// - descriptors and probe negotiation generated from these tables
+// - mt9d111 mode A 800x600 30fps, mode B 1600x1200 15fps, slower intervals stretch VBLANK
+// - YUY2 16 bits per pixel, high speed intervals kept under FRAME_BANDWIDTH_HS
+// - MJPEG from the mt9d111 jpeg encoder, same table both speeds
+#define FORMAT_YUY2  1
+#define FORMAT_MJPEG 2
+
+#define FRAMES_SS(X) \
+  X (1,  800,  600,  333333,  666666, 1000000) \
+  X (2, 1600, 1200,  666666, 1000000, 1333333)
+
+#define FRAMES_HS(X) \
+  X (1,  800,  600,  666666, 1000000, 1333333) \
+  X (2, 1600, 1200, 2000000, 2666666, 4000000)
+
+#define FRAMES_MJPEG(X) \
+  X (1,  800,  600,  333333,  666666, 1000000) \
+  X (2, 1600, 1200,  666666, 1000000, 1333333)
+
+#define FRAME_BANDWIDTH_SS 200000000  // bytes/s the pipeline sustains at super speed
+#define FRAME_BANDWIDTH_HS  24000000  // bytes/s the pipeline sustains at high speed, shared 480Mbit bus
+
+#define FRAME_SIZE_YUY2(width, height)  ((width) * (height) * 2)
+#define FRAME_SIZE_MJPEG(width, height) ((width) * (height))      // max, jpeg qscale keeps under 8 bits per pixel
+#define FRAME_AVERAGE_MJPEG(width, height) ((width) * (height) / 4) // typical, 2 bits per pixel, for bandwidth
+
+#define FRAME_ONE(index, width, height, i0, i1, i2) + 1
+#define FRAME_COUNT_SS    (0 FRAMES_SS(FRAME_ONE))
+#define FRAME_COUNT_HS    (0 FRAMES_HS(FRAME_ONE))
+#define FRAME_COUNT_MJPEG (0 FRAMES_MJPEG(FRAME_ONE))
+
+#define FRAME_BITRATE(frameSize, interval) (uint32_t)((uint64_t)(frameSize) * 8 * 10000000 / (interval))
+#define DW(value) (uint8_t)(value), (uint8_t)((value) >> 8), (uint8_t)((value) >> 16), (uint8_t)((value) >> 24)
+
+#define FRAME_DESCR_SIZE 0x26
+#define FRAME_DESCR(subtype, caps, frameSize, index, width, height, i0, i1, i2) \
+  FRAME_DESCR_SIZE,               /* Descriptor size */ \
+  0x24,                           /* Descriptor type */ \
+  subtype,                        /* Subtype: uncompressed or mjpeg frame I/F */ \
+  index,                          /* Frame Descriptor Index */ \
+  caps,                           /* bmCapabilities: 0x01 still image supported, 0x02 fixed frame rate */ \
+  (uint8_t)(width), (uint8_t)((width) >> 8),   /* Width in pixel */ \
+  (uint8_t)(height), (uint8_t)((height) >> 8), /* Height in pixel */ \
+  DW (FRAME_BITRATE (frameSize, i2)),          /* Min bit rate bits/s */ \
+  DW (FRAME_BITRATE (frameSize, i0)),          /* Max bit rate bits/s */ \
+  DW (frameSize),                 /* Maximum video frame size in bytes */ \
+  DW (i0),                        /* Default frame interval */ \
+  0x03,                           /* Frame interval types: 3 discrete intervals */ \
+  DW (i0), DW (i1), DW (i2),
+
+// yuy2 frames carry the still, mjpeg frames do not
+#define FRAME_DESCR_YUY2(index, width, height, i0, i1, i2) \
+  FRAME_DESCR (0x05, 0x03, FRAME_SIZE_YUY2 (width, height), index, width, height, i0, i1, i2)
+#define FRAME_DESCR_MJPEG(index, width, height, i0, i1, i2) \
+  FRAME_DESCR (0x07, 0x02, FRAME_SIZE_MJPEG (width, height), index, width, height, i0, i1, i2)
+
+// still image method 2, YUY2 only, mt9d111 mode B frame sent in the preview stream, STI header bit
+#define STILL_WIDTH  1600
+#define STILL_HEIGHT 1200
+#define STILL_SIZE   FRAME_SIZE_YUY2 (STILL_WIDTH, STILL_HEIGHT)
+
+#define STILL_DESCR_SIZE 0x0A
+#define STILL_DESCR \
+  STILL_DESCR_SIZE,               /* Descriptor size */ \
+  0x24,                           /* Descriptor type */ \
+  0x03,                           /* Subtype: still image frame */ \
+  0x00,                           /* No still endpoint, method 2 */ \
+  0x01,                           /* One still image size */ \
+  (uint8_t)(STILL_WIDTH), (uint8_t)((STILL_WIDTH) >> 8),   /* Width in pixel */ \
+  (uint8_t)(STILL_HEIGHT), (uint8_t)((STILL_HEIGHT) >> 8), /* Height in pixel */ \
+  0x00,                           /* No compression patterns */
+
+// VS format descriptors and their frame descriptors, config descriptor bytes other than these
+#define VS_MJPEG_SIZE      (0x0B + FRAME_COUNT_MJPEG * FRAME_DESCR_SIZE)
+#define VS_FORMATS_SIZE_HS (0x1B + FRAME_COUNT_HS * FRAME_DESCR_SIZE + STILL_DESCR_SIZE + VS_MJPEG_SIZE)
+#define VS_FORMATS_SIZE_SS (0x1B + FRAME_COUNT_SS * FRAME_DESCR_SIZE + STILL_DESCR_SIZE + VS_MJPEG_SIZE)
+#define CONFIG_SIZE_HS     (158 + VS_FORMATS_SIZE_HS + VS_ENDPOINTS_SIZE_HS)
+#define CONFIG_SIZE_SS     (170 + VS_FORMATS_SIZE_SS + VS_ENDPOINTS_SIZE_SS)
+//}}}
+//{{{  isochronous alt setting tiers
+// X (alt setting, max packet bytes, burst packets, mult) bytes per 125us service interval packet * burst * mult
+// - host picks the lowest alt setting carrying the probe dwMaxPayloadTransferSize
+// - one dma buffer per service interval, each a UVC payload with its own header
+// - high speed burst always 1, mult is transactions per microframe
+#define ISOC_TIERS_SS(X) \
+  X (1, 1024,  4, 1) \
+  X (2, 1024,  8, 1) \
+  X (3, 1024, 16, 1) \
+  X (4, 1024, 16, 2)
+
+#define ISOC_TIERS_HS(X) \
+  X (1,  512, 1, 1) \
+  X (2, 1024, 1, 1) \
+  X (3, 1024, 1, 2) \
+  X (4, 1024, 1, 3)
+
+#define ISOC_ONE(alt, packet, burst, mult) + 1
+#define ISOC_COUNT_SS (0 ISOC_TIERS_SS(ISOC_ONE))
+#define ISOC_COUNT_HS (0 ISOC_TIERS_HS(ISOC_ONE))
+
+#define ISOC_ALT_INTERFACE(alt) \
+  0x09,                           /* Descriptor size */ \
+  CY_U3P_USB_INTRFC_DESCR,        /* Interface Descriptor type */ \
+  0x01,                           /* Interface number */ \
+  alt,                            /* Alternate setting number */ \
+  0x01,                           /* Number of end points */ \
+  0x0E,                           /* Interface class : CC_VIDEO */ \
+  0x02,                           /* Interface sub class : CC_VIDEOSTREAMING */ \
+  0x00,                           /* Interface protocol code : Undefined */ \
+  0x00,                           /* Interface descriptor string index */
+
+#define ISOC_ALT_HS(alt, packet, burst, mult) \
+  ISOC_ALT_INTERFACE (alt) \
+  0x07,                           /* Descriptor size */ \
+  CY_U3P_USB_ENDPNT_DESCR,        /* Endpoint Descriptor Type */ \
+  CY_FX_EP_BULK_VID,              /* Endpoint address and description */ \
+  0x05,                           /* Isochronous asynchronous End point */ \
+  (uint8_t)(packet), (uint8_t)(((packet) >> 8) | (((mult) - 1) << 3)), /* Max packet size, additional transactions */ \
+  0x01,                           /* Servicing interval : every microframe */
+
+#define ISOC_ALT_SS(alt, packet, burst, mult) \
+  ISOC_ALT_INTERFACE (alt) \
+  0x07,                           /* Descriptor size */ \
+  CY_U3P_USB_ENDPNT_DESCR,        /* Endpoint Descriptor Type */ \
+  CY_FX_EP_BULK_VID,              /* Endpoint address and description */ \
+  0x05,                           /* Isochronous asynchronous End point */ \
+  (uint8_t)(packet), (uint8_t)((packet) >> 8), /* Max packet size */ \
+  0x01,                           /* Servicing interval : every microframe */ \
+  0x06,                           /* Descriptor size */ \
+  CY_U3P_SS_EP_COMPN_DESCR,       /* SS Endpoint Companion Descriptor Type */ \
+  (burst) - 1,                    /* Max number of packets per burst */ \
+  (mult) - 1,                     /* Mult : bursts per service interval */ \
+  (uint8_t)((packet) * (burst) * (mult)), (uint8_t)(((packet) * (burst) * (mult)) >> 8), /* Bytes per interval */
+
+#if UVC_ISOC
+  #define VS_ENDPOINTS_SIZE_HS (ISOC_COUNT_HS * (0x09 + 0x07))
+  #define VS_ENDPOINTS_SIZE_SS (ISOC_COUNT_SS * (0x09 + 0x07 + 0x06))
+#else
+  #define VS_ENDPOINTS_SIZE_HS 0x07
+  #define VS_ENDPOINTS_SIZE_SS (0x07 + 0x06)
+#endif
+//}}}
+
 // events
 #define STREAM_EVENT        (1 << 0)
 #define STREAM_ABORT_EVENT  (1 << 1)
-#define VIDEO_CONTROL_EVENT (1 << 2)
-#define VIDEO_STREAM_EVENT  (1 << 3)
+#define SETUP_EVENT         (1 << 2)  // UVC class requests queued for control thread
 #define BUTTON_DOWN_EVENT   (1 << 4)
 #define BUTTON_UP_EVENT     (1 << 5)
+#define VID_EVENT           (1 << 6)  // dma prod, cons or gpif end of frame, vid thread work pending
+#define FRAME_EVENT         (1 << 7)  // gpif end of frame, ae af thread reads statistics, applies ptz window
+#define STATUS_EVENT        (1 << 8)  // status packets queued for the control thread to send on ep2
+#define STILL_EVENT         (1 << 9)  // still frame sent, sensor thread switches back to preview
 
 //{{{  USB and UVC defines
 #define CY_FX_INTF_ASSN_DSCR_TYPE       (0x0B)          // Type code for Interface Association Descriptor (IAD)
@@ -68,6 +224,8 @@
 #define CY_FX_UVC_HEADER_FRAME          (0)                     // UVC header normal frame indication
 #define CY_FX_UVC_HEADER_EOF            (uint8_t)(1 << 1)       // UVC header end of frame indication
 #define CY_FX_UVC_HEADER_FRAME_ID       (uint8_t)(1 << 0)       // Frame ID toggle bit in UVC header.
+#define CY_FX_UVC_HEADER_STILL          (uint8_t)(1 << 5)       // UVC header still image frame
+#define CY_FX_UVC_HEADER_ERR            (uint8_t)(1 << 6)       // UVC header error, host discards the frame
 
 #define CY_FX_USB_UVC_SET_REQ_TYPE      (uint8_t)(0x21)         // UVC Interface SET Request Type
 #define CY_FX_USB_UVC_GET_REQ_TYPE      (uint8_t)(0xA1)         // UVC Interface GET Request Type
@@ -84,6 +242,10 @@
 #define CY_FX_UVC_CONTROL_INTERFACE     (uint8_t)(0)            // Control Interface
 #define CY_FX_UVC_PROBE_CTRL            (uint16_t)(0x0100)      // wValue PROBE control.
 #define CY_FX_UVC_COMMIT_CTRL           (uint16_t)(0x0200)      // wValue COMMIT control.
+#define CY_FX_UVC_STILL_PROBE_CTRL      (uint16_t)(0x0300)      // wValue still PROBE control.
+#define CY_FX_UVC_STILL_COMMIT_CTRL     (uint16_t)(0x0400)      // wValue still COMMIT control.
+#define CY_FX_UVC_STILL_TRIGGER_CTRL    (uint16_t)(0x0500)      // wValue still image TRIGGER control.
+#define CY_FX_UVC_MAX_STILL_PROBE       (11)                    // bytes in still probe, commit control
 
 #define CY_FX_UVC_INTERFACE_CTRL        (uint8_t)(0)            // wIndex value UVC interface control.
 #define CY_FX_UVC_CAMERA_TERMINAL_ID    (uint8_t)(1)            // wIndex value Camera terminal.
@@ -252,7 +414,7 @@ static const uint8_t HighSpeedConfigurationDescriptor[] = {
   //{{{  Configuration Descriptor Type
   0x09,                           /* Descriptor Size */
   CY_U3P_USB_CONFIG_DESCR,        /* Configuration Descriptor Type */
-  0xDD,0x00,                      /* Length of this descriptor and all sub descriptors */
+  (uint8_t)CONFIG_SIZE_HS, (uint8_t)(CONFIG_SIZE_HS >> 8), /* Length of this descriptor and all sub descriptors */
   0x03,                           /* Number of interfaces */
   0x01,                           /* Configuration number */
   0x00,                           /* Configuration string index */
@@ -331,7 +493,7 @@ static const uint8_t HighSpeedConfigurationDescriptor[] = {
                                    * D21: Region of Interest
                                    * D22  D23: Reserved, set to zero
                                    */
-  0x00,0x0A,0x00,                 /* bmControls field of camera terminal: PTZ supported */
+  0x0A,0x0A,0x02,                 /* bmControls field of camera terminal: AE mode, exposure, PTZ, focus auto */
   //}}}
   //{{{  Processing Unit Descriptor
   0x0C,                           /* Descriptor size */
@@ -364,7 +526,7 @@ static const uint8_t HighSpeedConfigurationDescriptor[] = {
                                    * D18: Contrast, Auto
                                    * D19  D23: Reserved. Set to zero.
                                    */
-  0x01,0x00,0x00,                 /* bmControls field of processing unit: Brightness control supported */
+  0x7B,0x16,0x00,                 /* bmControls field of processing unit: D0,1,3,4,5,6,9,10,12 - puControls */
   0x00,                           /* String desc index : Not used */
   //}}}
   //{{{  Extension Unit Descriptor
@@ -412,33 +574,34 @@ static const uint8_t HighSpeedConfigurationDescriptor[] = {
   CY_U3P_USB_INTRFC_DESCR,        /* Interface Descriptor type */
   0x01,                           /* Interface number */
   0x00,                           /* Alternate setting number */
-  0x01,                           /* Number of end points : Zero Bandwidth */
+  1 - UVC_ISOC,                   /* Number of end points : bulk, or zero bandwidth for isochronous */
   0x0E,                           /* Interface class : CC_VIDEO */
   0x02,                           /* Interface sub class : CC_VIDEOSTREAMING */
   0x00,                           /* Interface protocol code : Undefined */
   0x00,                           /* Interface descriptor string index */
   //}}}
   //{{{  Class-specific Video Streaming Input Header Descriptor
-  0x0E,                           /* Descriptor size */
+  0x0F,                           /* Descriptor size */
   0x24,                           /* Class-specific VS I/f Type */
   0x01,                           /* Descriptotor Subtype : Input Header */
-  0x01,                           /* 1 format desciptor follows */
-  0x29,0x00,                      /* Total size of Class specific VS descr: 41 Bytes */
-  CY_FX_EP_BULK_VID,              /* EP address for BULK video data */
+  0x02,                           /* 2 format desciptors follow */
+  (uint8_t)(0x0F + VS_FORMATS_SIZE_HS), (uint8_t)((0x0F + VS_FORMATS_SIZE_HS) >> 8), /* Total size of Class specific VS descr */
+  CY_FX_EP_BULK_VID,              /* EP address for video data */
   0x00,                           /* No dynamic format change supported */
   0x04,                           /* Output terminal ID : 4 */
-  0x01,                           /* Still image capture method 1 supported */
-  0x00,                           /* Hardware trigger NOT supported */
+  0x02,                           /* Still image capture method 2 supported */
+  0x00,                           /* Hardware trigger NOT reported, device button triggers the still itself */
   0x00,                           /* Hardware to initiate still image capture NOT supported */
   0x01,                           /* Size of controls field : 1 byte */
-  0x00,                           /* D2 : Compression quality supported */
+  0x00,                           /* YUY2 format controls : none */
+  0x00,                           /* MJPEG format controls : none */
   //}}}
   //{{{  Class specific Uncompressed VS format descriptor
   0x1B,                           /* Descriptor size */
   0x24,                           /* Class-specific VS I/f Type */
   0x04,                           /* Subtype : uncompressed format I/F */
-  0x01,                           /* Format desciptor index (only one format is supported) */
-  0x01,                           /* number of frame descriptor followed */
+  FORMAT_YUY2,                    /* Format desciptor index */
+  FRAME_COUNT_HS,                 /* number of frame descriptor followed */
   0x59,0x55,0x59,0x32, 0x00,0x00,0x10,0x00, 0x80,0x00,0x00,0xAA, 0x00,0x38,0x9B,0x71, // YUY2 guid
   0x10,                           /* Number of bits per pixel used to specify color in the decoded video frame. 0 if not applicable: 10 bit per pixel */
   0x01,                           /* Optimum Frame Index for this stream: 1 */
@@ -447,26 +610,33 @@ static const uint8_t HighSpeedConfigurationDescriptor[] = {
   0x00,                           /* Interlace Flags: Progressive scanning, no interlace */
   0x00,                           /* duplication of the video stream restriction: 0 - no restriction */
   //}}}
-  //{{{  Class specific Uncompressed VS Frame descriptor
-  0x1E,                           /* Descriptor size */
-  0x24,                           /* Descriptor type*/
-
-  0x05,                           /* Subtype: uncompressed frame I/F */
-  0x01,                           /* Frame Descriptor Index */
-  0x03,                           /* Still image capture method 1 supported, fixed frame rate */
-
-  0x20, 0x03,                     /* Width in pixel - 800 */
-  0x58, 0x02,                     /* Height in pixel- 600 */
-
-  0x00,0x50,0x97,0x31,            /* Min bit rate bits/s. Not specified, taken from MJPEG */
-  0x00,0x50,0x97,0x31,            /* Max bit rate bits/s. Not specified, taken from MJPEG */
-
-  0x00,0x60,0x09,0x00,            /* Maximum video or still frame size in bytes(Deprecated) */
-
-  0x2A,0x2C,0x0A,0x00,            /* Default Frame Interval */
-  0x01,                           /* Frame interval(Frame Rate) types: Only one frame interval supported */
-  0x2A,0x2C,0x0A,0x00,            /* Shortest Frame Interval */
+  //{{{  Class specific Uncompressed VS Frame descriptors
+  FRAMES_HS(FRAME_DESCR_YUY2)
+  //}}}
+  //{{{  Class specific Still Image Frame descriptor
+  STILL_DESCR
+  //}}}
+  //{{{  Class specific MJPEG VS format descriptor
+  0x0B,                           /* Descriptor size */
+  0x24,                           /* Class-specific VS I/f Type */
+  0x06,                           /* Subtype : MJPEG format I/F */
+  FORMAT_MJPEG,                   /* Format desciptor index */
+  FRAME_COUNT_MJPEG,              /* Number of frame descriptor followed */
+  0x00,                           /* Flags : variable size samples */
+  0x01,                           /* Default frame index */
+  0x00,                           /* X dimension of the picture aspect ratio */
+  0x00,                           /* Y dimension of the picture aspect ratio */
+  0x00,                           /* Interlace Flags: Progressive scanning, no interlace */
+  0x00,                           /* duplication of the video stream restriction: 0 - no restriction */
+  //}}}
+  //{{{  Class specific MJPEG VS frame descriptors
+  FRAMES_MJPEG(FRAME_DESCR_MJPEG)
   //}}}
+#if UVC_ISOC
+  //{{{  Video Streaming Interface Alternate Settings with Isochronous Endpoints
+  ISOC_TIERS_HS(ISOC_ALT_HS)
+  //}}}
+#else
   //{{{  Endpoint Descriptor for BULK Streaming Video Data
   0x07,                           /* Descriptor size */
   CY_U3P_USB_ENDPNT_DESCR,        /* Endpoint Descriptor Type */
@@ -476,6 +646,7 @@ static const uint8_t HighSpeedConfigurationDescriptor[] = {
   (uint8_t)((512 & 0xFF00)>>8),
   0x01,                           /* Servicing interval for data transfers */
   //}}}
+#endif
   //{{{  interface descriptor
   0x09,                           /* Descriptor size */
   CY_U3P_USB_INTRFC_DESCR,        /* Interface Descriptor type */
@@ -502,7 +673,7 @@ static const uint8_t SuperSpeedConfigurationDescriptor[] = {
   //{{{  Configuration Descriptor Type
   0x09,                           /* Descriptor Size */
   CY_U3P_USB_CONFIG_DESCR,        /* Configuration Descriptor Type */
-  0xEF,0x00,                      /* Total length of this and all sub-descriptors. */
+  (uint8_t)CONFIG_SIZE_SS, (uint8_t)(CONFIG_SIZE_SS >> 8), /* Total length of this and all sub-descriptors. */
   0x03,                           /* Number of interfaces */
   0x01,                           /* Configuration number */
   0x00,                           /* Configuration string index */
@@ -581,7 +752,7 @@ static const uint8_t SuperSpeedConfigurationDescriptor[] = {
                                    * D21: Region of Interest
                                    * D22  D23: Reserved, set to zero
                                    */
-  0x00,0x0A,0x00,                 /* bmControls field of camera terminal: PTZ supported */
+  0x0A,0x0A,0x02,                 /* bmControls field of camera terminal: AE mode, exposure, PTZ, focus auto */
   //}}}
   //{{{  Processing Unit Descriptor
   0x0C,                           /* Descriptor size */
@@ -591,7 +762,7 @@ static const uint8_t SuperSpeedConfigurationDescriptor[] = {
   0x01,                           /* Source ID : 1 : Conencted to input terminal */
   0x00,0x40,                      /* Digital multiplier */
   0x03,                           /* Size of controls field for this terminal : 3 bytes */
-  0x01,0x00,0x00,                 /* bmControls field of processing unit: Brightness control supported */
+  0x7B,0x16,0x00,                 /* bmControls field of processing unit: D0,1,3,4,5,6,9,10,12 - puControls */
   0x00,                           /* String desc index : Not used */
   //}}}
   //{{{  Extension Unit Descriptor
@@ -667,34 +838,35 @@ static const uint8_t SuperSpeedConfigurationDescriptor[] = {
   CY_U3P_USB_INTRFC_DESCR,        /* Interface Descriptor type */
   0x01,                           /* Interface number */
   0x00,                           /* Alternate setting number */
-  0x01,                           /* Number of end points */
+  1 - UVC_ISOC,                   /* Number of end points : bulk, or zero bandwidth for isochronous */
   0x0E,                           /* Interface class : CC_VIDEO */
   0x02,                           /* Interface sub class : CC_VIDEOSTREAMING */
   0x00,                           /* Interface protocol code : Undefined */
   0x00,                           /* Interface descriptor string index */
   //}}}
   //{{{  Class-specific Video Streaming Input Header Descriptor
-  0x0E,                           /* Descriptor size */
+  0x0F,                           /* Descriptor size */
   0x24,                           /* Class-specific VS I/f Type */
   0x01,                           /* Descriptotor Subtype : Input Header */
-  0x01,                           /* 1 format desciptor follows */
-  0x47,0x00,                      /* Total size of Class specific VS descr */
-  CY_FX_EP_BULK_VID,              /* EP address for BULK video data */
+  0x02,                           /* 2 format desciptors follow */
+  (uint8_t)(0x0F + VS_FORMATS_SIZE_SS), (uint8_t)((0x0F + VS_FORMATS_SIZE_SS) >> 8), /* Total size of Class specific VS descr */
+  CY_FX_EP_BULK_VID,              /* EP address for video data */
   0x00,                           /* No dynamic format change supported */
   0x04,                           /* Output terminal ID : 4 */
-  0x01,                           /* Still image capture method 1 supported */
-  0x00,                           /* Hardware trigger NOT supported */
+  0x02,                           /* Still image capture method 2 supported */
+  0x00,                           /* Hardware trigger NOT reported, device button triggers the still itself */
   0x00,                           /* Hardware to initiate still image capture NOT supported */
   0x01,                           /* Size of controls field : 1 byte */
-  0x00,                           /* D2 : Compression quality supported */
+  0x00,                           /* YUY2 format controls : none */
+  0x00,                           /* MJPEG format controls : none */
   //}}}
   //{{{  Class specific Uncompressed VS format descriptor
   0x1B,                           /* Descriptor size */
   0x24,                           /* Class-specific VS I/f Type */
   0x04,                           /* Subtype : uncompressed format I/F */
 
-  0x01,                           /* Format desciptor index */
-  0x01,                           /* Number of frame descriptor followed */
+  FORMAT_YUY2,                    /* Format desciptor index */
+  FRAME_COUNT_SS,                 /* Number of frame descriptor followed */
 
   0x59,0x55,0x59,0x32, 0x00,0x00,0x10,0x00, 0x80,0x00,0x00,0xAA, 0x00,0x38,0x9B,0x71, // YUY2 guid
   0x10,                           /* Number of bits per pixel */
@@ -706,29 +878,33 @@ static const uint8_t SuperSpeedConfigurationDescriptor[] = {
   0x00,                           /* Interlace Flags: Progressive scanning, no interlace */
   0x00,                           /* duplication of the video stream restriction: 0 - no restriction */
   //}}}
-  //{{{  Class specific Uncompressed VS frame descriptor
-  0x1E,                           /* Descriptor size */
-  0x24,                           /* Descriptor type*/
-  0x05,                           /* Subtype: uncompressed frame I/F */
-
-  0x01,                           /* Frame Descriptor Index */
-  0x03,                           /* Still image capture method 1 supported, fixed frame rate */
-
-  #ifdef lines1200
-  0x40, 0x06,                     /* Width in pixel - 1600 */
-  0xB0, 0x04,                     /* Height in pixel- 1200 */
-  #else
-  0x20, 0x03,                     /* Width in pixel - 800 */
-  0x58, 0x02,                     /* Height in pixel- 600 */
-  #endif
-
-  0x00,0x50,0x97,0x31,            /* Min bit rate bits/s. */
-  0x00,0x50,0x97,0x31,            /* Max bit rate bits/s. */
-
-  0x00,0xA4,0x1F,0x00,            /* Maximum video or still frame size in bytes(Deprecated)*/
-
-  0x15, 0x16, 0x05, 0x00, 0x01, 0x15,0x16,0x05,0x00,  /* 30fps */
+  //{{{  Class specific Uncompressed VS frame descriptors
+  FRAMES_SS(FRAME_DESCR_YUY2)
+  //}}}
+  //{{{  Class specific Still Image Frame descriptor
+  STILL_DESCR
+  //}}}
+  //{{{  Class specific MJPEG VS format descriptor
+  0x0B,                           /* Descriptor size */
+  0x24,                           /* Class-specific VS I/f Type */
+  0x06,                           /* Subtype : MJPEG format I/F */
+  FORMAT_MJPEG,                   /* Format desciptor index */
+  FRAME_COUNT_MJPEG,              /* Number of frame descriptor followed */
+  0x00,                           /* Flags : variable size samples */
+  0x01,                           /* Default frame index */
+  0x00,                           /* X dimension of the picture aspect ratio */
+  0x00,                           /* Y dimension of the picture aspect ratio */
+  0x00,                           /* Interlace Flags: Progressive scanning, no interlace */
+  0x00,                           /* duplication of the video stream restriction: 0 - no restriction */
+  //}}}
+  //{{{  Class specific MJPEG VS frame descriptors
+  FRAMES_MJPEG(FRAME_DESCR_MJPEG)
+  //}}}
+#if UVC_ISOC
+  //{{{  Video Streaming Interface Alternate Settings with Isochronous Endpoints
+  ISOC_TIERS_SS(ISOC_ALT_SS)
   //}}}
+#else
   //{{{  Endpoint Descriptor for BULK Streaming Video Data
   0x07,                           /* Descriptor size */
   CY_U3P_USB_ENDPNT_DESCR,        /* Endpoint Descriptor Type */
@@ -745,6 +921,7 @@ static const uint8_t SuperSpeedConfigurationDescriptor[] = {
   0x00,                           /* No meaning for bulk */
   0x00,
   //}}}
+#endif
   //{{{  interface descriptor - bulk endpoints
   0x09,                           /* Descriptor size */
   CY_U3P_USB_INTRFC_DESCR,        /* Interface Descriptor type */
@@ -777,10 +954,12 @@ static const uint8_t SuperSpeedConfigurationDescriptor[] = {
 //{{{  vars
 static CyU3PThread vidThread;        // UVC video streaming thread
 static CyU3PThread controlThread;    // UVC control request handling thread
+static CyU3PThread sensorThread;     // sensor i2c worker, lowest priority
+static CyU3PThread aeafThread;       // ae af controller, ptz window, frame end driven, lowest priority
 static CyU3PDmaMultiChannel dmaMultiChannel;
 static CyU3PEvent uvcEvent;          // Event group used to signal threads
 
-// Current UVC control request fields. See USB specification for definition
+// Current setup request fields, setup callback only, control thread gets a queued copy
 static uint8_t bReqType;
 static uint8_t bRequest;
 static uint8_t bType;
@@ -789,81 +968,355 @@ static uint16_t wValue;
 static uint16_t wIndex;
 static uint16_t wLength;
 
-static CyBool_t analyserMode = CyFalse;         // Whether USB host has started streaming data
+//{{{  dma channel mode, stream start latency
+// channel is only destroyed, created when the mode changes, probe, commit reuse the live channel
+#define CHANNEL_NONE     0
+#define CHANNEL_UVC      1   // ep3, 12 byte UVC prodHeader, 4 byte prodFooter
+#define CHANNEL_ANALYSER 2   // ep1, 16 byte analyserHeader_t prodHeader
+#define CHANNEL_RING     3   // UVC through ring of payload buffers, gpif to cpu, cpu to ep3
+static uint8_t channelMode = CHANNEL_NONE;
+static CyU3PUSBSpeed_t channelSpeed = CY_U3P_NOT_CONNECTED; // usb speed channel was planned for
+static uint32_t channelFrameSize = 0;                       // frame size channel was planned for
+static uint32_t channelBufferSize = 0;                      // isochronous buffer size channel was planned for, 0 bulk
+static bufferPlan_t vidPlan;                                 // channel buffer size, count
+static CyU3PMutex channelMutex;                              // channelSetMode, control thread against setup callback
+
+static uint32_t channelCreates = 0;      // count of channel creations
+static uint32_t streamStarts = 0;        // count of stream start requests
+static uint32_t startRequestTicks = 0;   // timer ticks at last stream start request
+static uint32_t startFirstProdTicks = 0; // start request to first buffer produced
+static uint32_t startFirstConsTicks = 0; // start request to first buffer consumed by USB
+static uint32_t startMaxConsTicks = 0;   // max of startFirstConsTicks
+volatile static CyBool_t startProdPending = CyFalse;
+
+// vendor 0xB0 reply, filled from the counters above at request
+typedef struct startStats {
+  uint32_t channelCreates;  // count of channel creations
+  uint32_t streamStarts;    // count of stream start requests
+  uint32_t firstProdUs;     // start request to first buffer produced
+  uint32_t firstConsUs;     // start request to first buffer consumed by USB
+  uint32_t maxConsUs;       // max of firstConsUs
+} startStats_t;
+
+static startStats_t startStats;
+
+// vendor 0xB6 reply, sensor side
+typedef struct sensorCounters {
+  uint32_t initMs;          // sensorInit duration
+  uint32_t shadowHits;      // mcu var writes skipped, shadow already held the value
+  uint32_t shadowMisses;    // mcu var writes sent to the sensor
+} sensorCounters_t;
+
+static sensorCounters_t sensorCounters;
+//}}}
+//{{{  telemetry, video pipeline counters, vendor 0xB2 read, wValue != 0 reset after read
+typedef struct telemetry {
+  uint32_t frames;          // frames completed, EOF restarts
+  uint32_t buffers;         // buffers committed to USB
+  uint32_t commitFails;     // CommitBuffer failures, buffer dropped
+  uint32_t underruns;       // CY_U3P_USB_EVENT_EP_UNDERRUN
+  uint32_t maxLag;          // max prodCount - consCount, buffers waiting on USB
+  uint32_t gpifErrors;      // pib error callbacks with a gpif error code
+  uint32_t vidBusyPerMille; // vid thread time not blocked, last 1s streaming window
+  uint32_t frameBytesLast;  // payload bytes of last frame, varies with mjpeg
+  uint32_t frameBytesMax;   // max payload bytes of a frame, mjpeg must stay under dwMaxVideoFrameSize
+  uint32_t ringDrops;       // ring mode frames dropped whole, no room for the largest frame at frame start
+  uint32_t ringTorn;        // ring mode frames cut short by a full ring, ended with an ERR payload
+  uint32_t ringMaxUsed;     // ring mode max slots waiting on USB
+  uint32_t bytesPerSec;     // payload bytes produced, last 1s streaming window
+  uint32_t restartUsLast;   // gpif end of frame to gpif restarted, last frame
+  uint32_t restartUsMax;    // max of restartUsLast
+  uint32_t setupDrops;      // UVC class requests stalled, setup queue full
+  uint32_t sensorDrops;     // sensor work items dropped, sensor queue full
+  uint32_t statusSent;      // status interrupt packets committed to ep2
+  uint32_t statusDrops;     // status packets dropped, queue full or host not polling ep2
+  uint32_t stills;          // still frames sent, STI header bit
+  uint32_t stillTimeouts;   // still captures abandoned, no still frame within STILL_TIMEOUT
+  uint32_t stillGapMsLast;  // preview gap of last still, trigger to preview resumed
+  uint32_t stillGapMsMax;   // max of stillGapMsLast
+  uint32_t pibErrors[32];   // pib error callbacks by CYU3P_GET_PIB_ERROR_TYPE, 5,6 thread 0,1 overrun
+} telemetry_t;
+
+static telemetry_t telemetry;
+//}}}
+//{{{  ring mode, vendor 0xB3 wValue enables from next channel create
+// gpif to cpu manual channel, each buffer copied with its header into a ring slot from spare buffer heap
+// cpu to usb manual out channel sends slots in order, one outstanding
+// frame sent whole or not at all, ring must hold the largest frame, stock 224KB heap never does, plain UVC then
+#define RING_SLOTS_MAX   64
+#define RING_GPIF_COUNT  4   // gpif buffers per socket, slot copy outruns gpif, these ride out vid thread latency
+#define RING_FRAME     1   // ringDrop, frame dropped whole
+#define RING_TORN      2   // ringDrop, frame torn, rest of frame discarded
+
+static CyBool_t ringEnable = CyFalse;
+static CyU3PDmaChannel ringChannel;
+static uint8_t* ringSlot[RING_SLOTS_MAX];    // payload slots, UVC header at start
+static uint16_t ringLength[RING_SLOTS_MAX];  // bytes to send from slot, header included
+static uint32_t ringSlots = 0;
+static uint32_t ringFrameSlots = 0;          // slots of the largest frame, frame starts only with this many free
+static uint32_t ringStillSlots = 0;          // slots of a still frame
+static uint32_t ringIn = 0;                  // slots filled, vid thread
+static uint32_t ringSent = 0;                // slots handed to usb, vid thread
+volatile static uint32_t ringOut = 0;        // slots consumed by usb, ring dma callback
+static uint8_t ringDrop = 0;                 // current frame RING_FRAME or RING_TORN, rest discarded
+//}}}
 static CyBool_t streamingStarted = CyFalse;         // Whether USB host has started streaming data
 static CyBool_t clearFeatureRqtReceived = CyFalse;  // Whether a CLEAR_FEATURE (stop streaming) request
 static CyU3PUSBSpeed_t usbSpeed = CY_U3P_NOT_CONNECTED; // Current USB connection speed
 static uint8_t backFlowDetected = 0;                // Whether buffer overflow error is detected
 
-// Scratch buffer used for handling UVC class requests with a data phase
-static uint8_t glEp0Buffer[32];
-//{{{
-/* UVC Header to be prefixed at the top of each 16 KB video data buffer. */
-static uint8_t volatile uvcHeader[CY_FX_UVC_MAX_HEADER] = {
-  0x0C,                               /* Header Length */
-  0x8C,                               /* Bit field header field */
-  0x00, 0x00, 0x00, 0x00,             /* Presentation time stamp field */
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00  /* Source clock reference field */
-  };
-//}}}
-//{{{
-/* UVC Header to be prefixed at the top of each 16 KB video data buffer. */
-static uint8_t volatile uvcHeaderEOF[CY_FX_UVC_MAX_HEADER] = {
-  0x0C,                               /* Header Length */
-  0x8E,                               /* Bit field header field + EOF */
-  0x00, 0x00, 0x00, 0x00,             /* Presentation time stamp field */
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00  /* Source clock reference field */
-  };
-//}}}
+// ep0 data stage buffers, one per context so a queued request never shares one with another in flight
+static uint8_t glEp0Buffer[32] __attribute__ ((aligned (32)));     // control thread, class requests, vendorRequests
+static uint8_t setupEp0Buffer[32] __attribute__ ((aligned (32)));  // setup callback, vendor requests handled inline
+static uint8_t sensorEp0Buffer[32] __attribute__ ((aligned (32))); // sensor thread, SENSOR_READ reply
+static uint8_t uvcHeaderBFH = CY_FX_UVC_HEADER_DEFAULT_BFH; // UVC header bit field, frame ID toggled each frame
+static uint32_t uvcPTS = 0;                                 // timer ticks at capture start of current frame
+static uint32_t analyserSequence = 0;                       // analyser mode header sequence, 0 at vendor 0xAF start
+volatile static CyBool_t analyserPib = CyFalse;             // pib error since last analyser header, pib callback
 
 volatile static CyBool_t gpifInitialized = CyFalse;  // Whether the GPIF init function has been called
 volatile static CyBool_t gotPartial = CyFalse;       // track last partial buffer ensure committed to USB
 volatile static CyBool_t hitFV = CyFalse;            // Whether end of frame (FV) signal has been hit
+volatile static uint32_t hitFVTicks = 0;             // timer ticks at end of frame gpif interrupt
+volatile static uint32_t vidProduced = 0;            // buffers produced since vidStart, dma prod callback
+volatile static uint32_t vidTaken = 0;               // buffers taken by vid thread since vidStart
+volatile static uint32_t fullEndProduced = 0;        // continuous, vidProduced when a frame ended on a full buffer, 0 none
+
+static CyBool_t vidContinuous = CyFalse;             // vendor 0xB4, gpif re-armed at end of frame, no dma reset
+volatile static uint8_t gpifThread0Socket = 0;       // producer socket gpif thread 0 starts frames in, thread 1 the other
 volatile static uint16_t prodCount = 0;              // Count of buffers received and committed during the current video frame
 volatile static uint16_t consCount = 0;              // Count of buffers received and committed during the current video frame
 
-// Video Probe Commit Control, filled out when the host sends down the SET_CUR request
+// Video Probe Commit Control, probe negotiated, commit starts stream
 static uint8_t commitCtrl[CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED];
-//{{{
-/* UVC Probe Control Setting for a USB 2.0 connection. */
-static uint8_t probeCtrl20[CY_FX_UVC_MAX_PROBE_SETTING] = {
-  0x00, 0x00,                 /* bmHint : no hit */
-  0x01,                       /* Use 1st Video format index */
-  0x01,                       /* Use 1st Video frame index */
-  0x2A, 0x2C, 0x0A, 0x00,     /* Desired frame interval in the unit of 100ns: 15 fps */
-  0x00, 0x00,                 /* Key frame rate in key frame/video frame units: only applicable
-                                 to video streaming with adjustable compression parameters */
-  0x00, 0x00,                 /* PFrame rate in PFrame / key frame units: only applicable to
-                                video streaming with adjustable compression parameters */
-  0x00, 0x00,                 /* Compression quality control: only applicable to video streaming
-                                 with adjustable compression parameters */
-  0x00, 0x00,                 /* Window size for average bit rate: only applicable to video
-                                 streaming with adjustable compression parameters */
-  0x00, 0x00,                 /* Internal video streaming i/f latency in ms */
-  0x00, 0x60, 0x09, 0x00,     /* Max video frame size in bytes */
-  0x00, 0x40, 0x00, 0x00      /* No. of bytes device can rx in single payload = 16 KB */
+static uint8_t probeCtrl[CY_FX_UVC_MAX_PROBE_SETTING];
+
+//{{{  frame tables
+typedef struct frame {
+  uint8_t  index;
+  uint16_t width;
+  uint16_t height;
+  uint32_t interval[3];   // 100ns units, fastest first
+} frame_t;
+
+#define FRAME_ENTRY(index, width, height, i0, i1, i2) { index, width, height, { i0, i1, i2 } },
+static const frame_t framesSS[] = { FRAMES_SS(FRAME_ENTRY) };
+static const frame_t framesHS[] = { FRAMES_HS(FRAME_ENTRY) };
+static const frame_t framesMJPEG[] = { FRAMES_MJPEG(FRAME_ENTRY) };
+
+static uint8_t curFormat = FORMAT_YUY2;  // committed format index
+static uint8_t curFrameIndex = 1;        // committed frame index
+static uint32_t curInterval = 0;         // committed frame interval, 0 default
+//}}}
+//{{{  isochronous tiers
+typedef struct isocTier {
+  uint8_t  alt;
+  uint16_t packet;
+  uint8_t  burst;
+  uint8_t  mult;
+} isocTier_t;
+
+#define ISOC_ENTRY(alt, packet, burst, mult) { alt, packet, burst, mult },
+static const isocTier_t isocTiersSS[] = { ISOC_TIERS_SS(ISOC_ENTRY) };
+static const isocTier_t isocTiersHS[] = { ISOC_TIERS_HS(ISOC_ENTRY) };
+
+static uint8_t isocAlt = 0;              // VS interface alt setting, 0 zero bandwidth
+//}}}
+//{{{  setup queue, setup callback to control thread, single producer, single consumer, lock free
+#define SETUP_QUEUE_SIZE 8   // power of 2, free running indices
+
+typedef struct setupReq {
+  uint8_t  bReqType;
+  uint8_t  bRequest;
+  uint16_t wValue;
+  uint16_t wIndex;
+  uint16_t wLength;
+} setupReq_t;
+
+static setupReq_t setupQueue[SETUP_QUEUE_SIZE];
+volatile static uint32_t setupIn = 0;    // only written by setup callback
+volatile static uint32_t setupOut = 0;   // only written by control thread
+//}}}
+//{{{  sensor worker, owns sensor i2c, below vid, control thread priority
+#define SENSOR_CONTROL    1  // arg CONTROL_ id, value
+#define SENSOR_STILL      2  // one still frame from capture mode B, button or host still trigger
+#define SENSOR_FOCUS      3  // value focus
+#define SENSOR_MODE       4  // value frame height, arg jpeg, interval, then stream start
+#define SENSOR_READ       5  // vendor 0xAD, value register, replies on ep0
+#define SENSOR_WRITE      6  // vendor 0xAE, value register, interval data bytes
+#define SENSOR_ANALYSER   7  // vendor 0xAF, analyser scaling, then stream start
+
+#define SENSOR_QUEUE_SIZE 8
+
+typedef struct sensorWork {
+  uint8_t  op;
+  uint8_t  arg;
+  uint16_t value;
+  uint32_t interval;
+} sensorWork_t;
+
+static CyU3PQueue sensorQueue;
+static uint32_t sensorQueueMem[SENSOR_QUEUE_SIZE * sizeof(sensorWork_t) / 4];
+static CyU3PMutex sensorMutex;   // sensor i2c, worker against ae af thread
+//}}}
+//{{{  still image, method 2, sensor thread switches mode, vid thread flags frames
+#define STILL_IDLE    0  // preview
+#define STILL_SWITCH  1  // sensor switching to capture mode B, frames flagged ERR
+#define STILL_ARMED   2  // sensor in capture mode B, next frame started is the still
+#define STILL_FRAME   3  // still frame in progress, STI header bit
+#define STILL_DONE    4  // still sent, sensor switching back to preview, frames flagged ERR
+
+#define STILL_TIMEOUT 1000 // ms for the still frame to arrive, before giving up
+
+volatile static uint8_t stillState = STILL_IDLE;
+static uint8_t uvcFrameFlags = 0;    // STI or ERR header bits of the current frame, vid thread
+static uint8_t stillProbe[CY_FX_UVC_MAX_STILL_PROBE];
+//}}}
+//{{{  processing unit controls, indexed by selector >> 8, length 0 not supported
+typedef struct puControl {
+  uint8_t  length;   // GET_LEN bytes
+  uint8_t  control;  // sensorControl id
+  int16_t  min;
+  int16_t  max;
+  int16_t  res;
+  int16_t  def;      // sensor init table setting
+} puControl_t;
+
+static const puControl_t puControls[] = {
+  [CY_FX_UVC_PU_BRIGHTNESS_CONTROL >> 8]                     = { 2, CONTROL_BRIGHTNESS,    0,  255,   1,   54 },
+  [CY_FX_UVC_PU_CONTRAST_CONTROL >> 8]                       = { 2, CONTROL_CONTRAST,      0,    4,   1,    0 },
+  [CY_FX_UVC_PU_GAIN_CONTROL >> 8]                           = { 2, CONTROL_GAIN,         32,  127,   1,   32 },
+  [CY_FX_UVC_PU_POWER_LINE_FREQUENCY_CONTROL >> 8]           = { 1, CONTROL_POWER_LINE,    0,    2,   1,    0 },
+  [CY_FX_UVC_PU_SATURATION_CONTROL >> 8]                     = { 2, CONTROL_SATURATION,    0,    6,   1,    5 },
+  [CY_FX_UVC_PU_SHARPNESS_CONTROL >> 8]                      = { 2, CONTROL_SHARPNESS,     0,    7,   1,    3 },
+  [CY_FX_UVC_PU_GAMMA_CONTROL >> 8]                          = { 2, CONTROL_GAMMA,         0,    4,   1,    2 },
+  [CY_FX_UVC_PU_WHITE_BALANCE_TEMPERATURE_CONTROL >> 8]      = { 2, CONTROL_WB_TEMP,    2800, 6500, 100, 5000 },
+  [CY_FX_UVC_PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL >> 8] = { 1, CONTROL_WB_AUTO,       0,    1,   1,    1 },
   };
+#define PU_CONTROLS (sizeof(puControls) / sizeof(puControl_t))
+
+static int16_t puCur[PU_CONTROLS];   // GET_CUR, set from def at init, SET_CUR before sensor thread applies it
+//}}}
+//{{{  ae af controller, CT AE_MODE, EXPOSURE_TIME_ABSOLUTE, FOCUS_AUTO, vendor 0xB5 read
+#define AE_MODE_MANUAL   0x01  // exposure from EXPOSURE_TIME_ABSOLUTE
+#define AE_MODE_APERTURE 0x08  // auto exposure time, fixed iris
+#define AE_GATE          8     // luma within brightness target +- gate is converged, 2x gate restarts
+#define AE_FRAMES_MAX    16    // frames before ae gives up and holds exposure
+
+#define AF_MIN           2     // sensorFocus pwm range
+#define AF_MAX           254
+#define AF_STEPS         16    // coarse sweep steps, each later sweep narrows to +- step around the peak
+#define AF_FINE          4     // sweep step divisor for each narrower sweep
+#define AF_FRAMES_MAX    48    // frames before af gives up and holds the best focus found
+
+#define AEAF_IDLE        0     // mode changed, applied next frame
+#define AEAF_SEARCH      1
+#define AEAF_CONVERGED   2
+#define AEAF_TIMEOUT     3     // frame bound hit, holds, restarts like converged
+
+typedef struct aeaf {
+  uint8_t  aeMode;        // CT AE_MODE
+  uint8_t  aeState;
+  uint8_t  focusAuto;     // CT FOCUS_AUTO
+  uint8_t  afState;
+  uint32_t exposure;      // CT EXPOSURE_TIME_ABSOLUTE, 100us units
+  uint16_t luma;          // last frame statistics
+  uint16_t sharpness;
+  uint16_t focus;         // focus pwm, af state
+  uint16_t aeFrames;      // frames of current or last ae search
+  uint16_t afFrames;      // frames of current or last af search
+  uint16_t sensorAe;      // sensor has no exposure control, its mcu ae runs, loop only observes
+  uint32_t aeConvergeMs;  // last ae search start to converged
+  uint32_t afConvergeMs;  // last af search start to converged
+  uint32_t aeSearches;
+  uint32_t afSearches;
+} aeaf_t;
+
+static aeaf_t aeaf = { AE_MODE_APERTURE, AEAF_IDLE, 1, AEAF_IDLE, 333 };
+
+static uint32_t aeStartMs = 0;
+static uint32_t afStartMs = 0;
+static uint16_t afLo = AF_MIN;             // current sweep range, step
+static uint16_t afHi = AF_MAX;
+static uint16_t afDelta = 1;
+static uint16_t afPeak = AF_MIN;           // sharpest focus so far, its sharpness
+static uint16_t afPeakSharpness = 0;
+//}}}
+//{{{  status interrupt, ep2, UVC control change and stream error packets, control thread sends
+#define STATUS_QUEUE_SIZE  8
+#define STATUS_PACKET_MAX  15   // vc status header 5 bytes, value up to 4, padded to a 4 word queue message
+
+typedef struct statusPacket {
+  uint8_t length;
+  uint8_t data[STATUS_PACKET_MAX];
+} statusPacket_t;
+
+static CyU3PDmaChannel statusChannel;  // cpu to ep2 manual out
+static CyU3PQueue statusQueue;         // producers in callbacks and threads, never block
+static uint32_t statusQueueMem[STATUS_QUEUE_SIZE * sizeof(statusPacket_t) / 4];
+//}}}
 //}}}
+
+// status interrupt
 //{{{
-/* UVC Probe Control Settings for a USB 3.0 connection. */
-static uint8_t probeCtrl30[CY_FX_UVC_MAX_PROBE_SETTING] = {
-  0x00, 0x00,                 /* bmHint : no hit */
-  0x01,                       /* Use 1st Video format index */
-  0x01,                       /* Use 1st Video frame index */
-  0x15, 0x16, 0x05, 0x00,     /* Desired frame interval in the unit of 100ns: 30 fps */
-  0x00, 0x00,                 /* Key frame rate in key frame/video frame units: only applicable
-                                 to video streaming with adjustable compression parameters */
-  0x00, 0x00,                 /* PFrame rate in PFrame / key frame units: only applicable to
-                                 video streaming with adjustable compression parameters */
-  0x00, 0x00,                 /* Compression quality control: only applicable to video streaming
-                                 with adjustable compression parameters */
-  0x00, 0x00,                 /* Window size for average bit rate: only applicable to video
-                                 streaming with adjustable compression parameters */
-  0x00, 0x00,                 /* Internal video streaming i/f latency in ms */
-  0x00, 0x48, 0x3F, 0x00,     /* Max video frame size in bytes */
-  0x00, 0x40, 0x00, 0x00      /* No. of bytes device can rx in single payload = 16 KB */
-  };
+static void statusPost (statusPacket_t* packet) {
+// queue status packet, safe from interrupt callbacks, dropped when full
+
+  if (CyU3PQueueSend (&statusQueue, packet, CYU3P_NO_WAIT) == CY_U3P_SUCCESS)
+    CyU3PEventSet (&uvcEvent, STATUS_EVENT, CYU3P_EVENT_OR);
+  else
+    telemetry.statusDrops++;
+  }
+//}}}
+//{{{
+static void statusControl (uint8_t originator, uint8_t selector, uint32_t value, uint8_t length) {
+// VideoControl interface status, control value change
+
+  statusPacket_t packet;
+  packet.length = 5 + length;
+  packet.data[0] = 1;           // bStatusType, VideoControl interface
+  packet.data[1] = originator;  // bOriginator, entity id
+  packet.data[2] = 0;           // bEvent, control change
+  packet.data[3] = selector;    // bSelector
+  packet.data[4] = 0;           // bAttribute, value change
+  for (int i = 0; i < length; i++)
+    packet.data[5 + i] = (value >> (i * 8)) & 0xFF;
+
+  statusPost (&packet);
+  }
+//}}}
+//{{{
+static void statusStream (uint8_t event, uint8_t value) {
+// VideoStreaming interface status, event 0 button, value 1 pressed, 0 released, events 1:255 stream error
+
+  statusPacket_t packet;
+  packet.length = 4;
+  packet.data[0] = 2;                           // bStatusType, VideoStreaming interface
+  packet.data[1] = CY_FX_UVC_STREAM_INTERFACE;  // bOriginator
+  packet.data[2] = event;                       // bEvent
+  packet.data[3] = value;                       // bValue
+
+  statusPost (&packet);
+  }
 //}}}
+//{{{
+static void statusSend() {
+// control thread, send queued status packets, dropped if host is not draining ep2
+
+  statusPacket_t packet;
+  while (CyU3PQueueReceive (&statusQueue, &packet, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
+    CyU3PDmaBuffer_t buffer;
+    if (CyU3PDmaChannelGetBuffer (&statusChannel, &buffer, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
+      CyU3PMemCopy (buffer.buffer, packet.data, packet.length);
+      if (CyU3PDmaChannelCommitBuffer (&statusChannel, packet.length, 0) == CY_U3P_SUCCESS)
+        telemetry.statusSent++;
+      else
+        telemetry.statusDrops++;
+      }
+    else
+      telemetry.statusDrops++;
+    }
+  }
 //}}}
 
 // button interrupt
@@ -872,43 +1325,263 @@ static void gpioInterruptCallback (uint8_t gpioId) {
 
   CyBool_t gpioValue = CyFalse;
   if (gpioId == BUTTON_GPIO)
-    if (CyU3PGpioGetValue (gpioId, &gpioValue) == CY_U3P_SUCCESS)
+    if (CyU3PGpioGetValue (gpioId, &gpioValue) == CY_U3P_SUCCESS) {
       CyU3PEventSet (&uvcEvent, gpioValue ? BUTTON_UP_EVENT : BUTTON_DOWN_EVENT, CYU3P_EVENT_OR);
+      statusStream (0, gpioValue ? 0 : 1);
+      }
   }
 //}}}
 
 // vid thread
 //{{{
+static inline void uvcHeaderWrite (uint8_t* buffer, uint8_t eof) {
+// write UVC header into the 12 byte prodHeader area in front of buffer
+// - dma buffers are cache line aligned, so the header is word aligned, three word stores
+// - PTS frame capture start, SCR source time clock now at commit, both in 48MHz timer ticks
+// - SCR sof field is not the usb bus frame number, the sdk has no api for the bus frame counter
+//   - it is the low 11 bits of the 1ms os tick, same 1ms period as a bus frame, unrelated phase and origin
+//   - a host can order SCRs by it, but must not correlate it with its own sof count, it drifts against the bus
+//   - the stc field alone carries the source clock, PTS, SCR latency decode uses only that
+
+  uint32_t stc = timerTicks();
+  uint32_t sof = CyU3PGetTime() & 0x7FF;
+
+  uint32_t* header = (uint32_t*)(buffer - CY_FX_UVC_MAX_HEADER);
+  header[0] = CY_FX_UVC_MAX_HEADER | ((uvcHeaderBFH | uvcFrameFlags | eof) << 8) | (uvcPTS << 16);
+  header[1] = (uvcPTS >> 16) | (stc << 16);
+  header[2] = (stc >> 16) | (sof << 16);
+  }
+//}}}
+//{{{
+static inline void analyserHeaderWrite (uint8_t* buffer, uint16_t count) {
+// write analyserHeader_t into the prodHeader area in front of buffer, raw 8 bit gpif bus samples
+// - timestamp when vid thread takes the buffer, gpif completion is at most the buffers waiting before it
+
+  analyserHeader_t* header = (analyserHeader_t*)(buffer - ANALYSER_HEADER_SIZE);
+  header->encoding = ANALYSER_RAW;
+  header->flags = (analyserSequence == 0) ? ANALYSER_FLAG_FIRST : 0;
+  if (analyserPib) {
+    analyserPib = CyFalse;
+    header->flags |= ANALYSER_FLAG_PIB;
+    }
+  header->length = count;
+  header->sequence = analyserSequence++;
+  header->timestamp = timerTicks();
+  header->samples = count;
+  }
+//}}}
+//{{{
+static void vidConsumed() {
+// buffer consumed by USB, first of a stream marks streaming started, wakes vid thread
+
+  if (!streamingStarted) {
+    startFirstConsTicks = timerTicks() - startRequestTicks;
+    if (startFirstConsTicks > startMaxConsTicks)
+      startMaxConsTicks = startFirstConsTicks;
+    }
+  streamingStarted = CyTrue;
+  CyU3PEventSet (&uvcEvent, VID_EVENT, CYU3P_EVENT_OR);
+  }
+//}}}
+//{{{
 static void vidDmaCallback (CyU3PDmaMultiChannel* multiChHandle, CyU3PDmaCbType_t type, CyU3PDmaCBInput_t* input) {
-// vid manual DMA callback, each buffer produced by gpif vid
+// vid manual DMA callback, each buffer produced by gpif, consumed by USB, wakes vid thread
 
-  if (type == CY_U3P_DMA_CB_CONS_EVENT) {
+  if (type == CY_U3P_DMA_CB_PROD_EVENT) {
+    vidProduced++;
+    CyU3PEventSet (&uvcEvent, VID_EVENT, CYU3P_EVENT_OR);
+    }
+
+  else if (type == CY_U3P_DMA_CB_CONS_EVENT) {
     consCount++;
-    streamingStarted = CyTrue;
+    vidConsumed();
+    }
+  }
+//}}}
+//{{{
+static void ringDmaCallback (CyU3PDmaChannel* handle, CyU3PDmaCbType_t type, CyU3PDmaCBInput_t* input) {
+// ring cpu to usb callback, slot consumed, vid thread sends the next
+
+  if (type == CY_U3P_DMA_CB_CONS_EVENT) {
+    ringOut++;
+    vidConsumed();
+    }
+  }
+//}}}
+//{{{
+static CyBool_t ringCreate (uint32_t frameSize) {
+// ring slots from spare buffer heap, after the gpif channel took its buffers
+// - fewer slots than the largest frame could tear a frame, returns CyFalse with nothing held
+
+  ringFrameSlots = (frameSize + vidPlan.payload - 1) / vidPlan.payload;
+  ringStillSlots = (STILL_SIZE + vidPlan.payload - 1) / vidPlan.payload;
+
+  ringSlots = bufferPlanSpare (vidPlan.size);
+  if (ringSlots > RING_SLOTS_MAX)
+    ringSlots = RING_SLOTS_MAX;
+
+  for (uint32_t i = 0; i < ringSlots; i++) {
+    ringSlot[i] = (uint8_t*)CyU3PDmaBufferAlloc (vidPlan.size);
+    if (!ringSlot[i]) {
+      ringSlots = i;
+      break;
+      }
+    }
+
+  if (ringSlots < ringFrameSlots) {
+    for (uint32_t i = 0; i < ringSlots; i++)
+      CyU3PDmaBufferFree (ringSlot[i]);
+    ringSlots = 0;
+    return CyFalse;
+    }
+
+  ringIn = 0;
+  ringSent = 0;
+  ringOut = 0;
+  ringDrop = 0;
+
+  // no buffers of its own, sends ring slots with SetupSendBuffer
+  CyU3PDmaChannelConfig_t dmaConfig;
+  CyU3PMemSet ((uint8_t*)&dmaConfig, 0, sizeof(dmaConfig));
+  dmaConfig.size         = vidPlan.size;
+  dmaConfig.count        = 0;
+  dmaConfig.prodSckId    = CY_U3P_CPU_SOCKET_PROD;
+  dmaConfig.consSckId    = CY_U3P_UIB_SOCKET_CONS_3; // ep3
+  dmaConfig.dmaMode      = CY_U3P_DMA_MODE_BYTE;
+  dmaConfig.notification = CY_U3P_DMA_CB_CONS_EVENT;
+  dmaConfig.cb           = ringDmaCallback;
+  CyU3PDmaChannelCreate (&ringChannel, CY_U3P_DMA_TYPE_MANUAL_OUT, &dmaConfig);
+  return CyTrue;
+  }
+//}}}
+//{{{
+static void ringDestroy() {
+
+  CyU3PDmaChannelDestroy (&ringChannel);
+  for (uint32_t i = 0; i < ringSlots; i++)
+    CyU3PDmaBufferFree (ringSlot[i]);
+  ringSlots = 0;
+  }
+//}}}
+//{{{
+static void ringReset() {
+// drop queued slots, stream restarts with an empty ring
+
+  CyU3PDmaChannelReset (&ringChannel);
+  ringIn = 0;
+  ringSent = 0;
+  ringOut = 0;
+  ringDrop = 0;
+  }
+//}}}
+//{{{
+static inline void ringCopy (uint8_t* slot, const uint8_t* from, uint32_t bytes) {
+// word copy, dma buffers and slots cache line aligned, rounded up bytes stay inside the slot
+
+  uint32_t* dst = (uint32_t*)slot;
+  const uint32_t* src = (const uint32_t*)from;
+  for (uint32_t words = (bytes + 3) / 4; words; words--)
+    *dst++ = *src++;
+  }
+//}}}
+//{{{
+static void ringPut (CyU3PDmaBuffer_t* buffer, CyBool_t first) {
+// copy gpif buffer, header in front, into next ring slot, discard it back to gpif
+// - frame starting without room for the largest frame dropped whole, nothing sent, a still never fits
+// - ring full mid frame, only a frame larger than planned, last slot takes a header only ERR EOF payload
+
+  uint32_t used = ringIn - ringOut;
+  if (first) {
+    uint32_t need = (uvcFrameFlags & CY_FX_UVC_HEADER_STILL) ? ringStillSlots : ringFrameSlots;
+    ringDrop = (ringSlots - used < need) ? RING_FRAME : 0;
+    if (ringDrop)
+      telemetry.ringDrops++;
+    }
+
+  if (!ringDrop) {
+    uint32_t slot = ringIn % ringSlots;
+    if (used >= ringSlots - 1) {
+      ringCopy (ringSlot[slot], buffer->buffer - CY_FX_UVC_MAX_HEADER, CY_FX_UVC_MAX_HEADER);
+      ringSlot[slot][1] |= CY_FX_UVC_HEADER_ERR | CY_FX_UVC_HEADER_EOF;
+      ringLength[slot] = CY_FX_UVC_MAX_HEADER;
+      ringDrop = RING_TORN;
+      telemetry.ringTorn++;
+      }
+    else {
+      ringCopy (ringSlot[slot], buffer->buffer - CY_FX_UVC_MAX_HEADER, buffer->count + CY_FX_UVC_MAX_HEADER);
+      ringLength[slot] = buffer->count + CY_FX_UVC_MAX_HEADER;
+      }
+    ringIn++;
+
+    if (used + 1 > telemetry.ringMaxUsed)
+      telemetry.ringMaxUsed = used + 1;
+    }
+
+  CyU3PDmaMultiChannelDiscardBuffer (&dmaMultiChannel);
+  }
+//}}}
+//{{{
+static void ringSend() {
+// hand next filled slot to usb, one outstanding
+
+  if ((ringSent == ringOut) && (ringIn != ringSent)) {
+    uint32_t slot = ringSent % ringSlots;
+
+    CyU3PDmaBuffer_t buffer;
+    buffer.buffer = ringSlot[slot];
+    buffer.count  = ringLength[slot];
+    buffer.size   = vidPlan.size;
+    buffer.status = 0;
+    if (CyU3PDmaChannelSetupSendBuffer (&ringChannel, &buffer) == CY_U3P_SUCCESS)
+      ringSent++;
+    else
+      telemetry.commitFails++;
+    }
+  }
+//}}}
+//{{{
+static void gpifSocketMap (uint8_t socket) {
+// gpif thread 0, where the state machine starts a frame, to producer socket, thread 1 to the other
+
+// - watermark, flag, burst as the designer config loaded them, only the socket changes
+
+  gpifThread0Socket = socket;
+  for (uint8_t thread = 0; thread < 2; thread++) {
+    uint32_t config = CyFxGpifRegValue[GPIF_THREAD_CONFIG + thread];
+    CyU3PGpifSocketConfigure (thread, CY_U3P_PIB_SOCKET_0 + (socket ^ thread),
+                              (config >> 8) & 0xFF, (config >> 30) & 1, (config >> 16) & 0xF);
     }
   }
 //}}}
 //{{{
 static void gpifCallback (CyU3PGpifEventType event, uint8_t currentState) {
 // vid gpif endOfFrame callback
+// - continuous, re-arm at once for the next frame in the socket after this frame's last,
+//   so the many to one channel keeps its socket order without a reset
 
   if (event == CYU3P_GPIF_EVT_SM_INTERRUPT) {
     hitFV = CyTrue;
+    hitFVTicks = timerTicks();
 
+    uint8_t thread = 0;
     switch (currentState) {
-      case FULL_BUF_IN_SCK0:
       case FULL_BUF_IN_SCK1:
-        // Buffer is already full and would have been committed. Do nothing
-        break;
-
-      case PARTIAL_BUF_IN_SCK0:
-        if (CyU3PDmaMultiChannelSetWrapUp (&dmaMultiChannel, 0) != CY_U3P_SUCCESS)
-          CyU3PDebugPrint (4, "CyFxGpifCallback Channel Set WrapUp failed\r\n");
-        gotPartial = CyTrue;
+        thread = 1;
+        // fall through
+      case FULL_BUF_IN_SCK0:
+        // Buffer is already full and would have been committed
+        // - a variable length mjpeg frame ending exactly on a buffer boundary has no EOF payload,
+        //   host ends the frame on the next frame ID toggle
+        // - continuous, vid thread ends the frame once it has taken every buffer produced so far
+        if (vidContinuous)
+          fullEndProduced = vidProduced;
         break;
 
       case PARTIAL_BUF_IN_SCK1:
-        if (CyU3PDmaMultiChannelSetWrapUp (&dmaMultiChannel, 1) != CY_U3P_SUCCESS)
+        thread = 1;
+        // fall through
+      case PARTIAL_BUF_IN_SCK0:
+        if (CyU3PDmaMultiChannelSetWrapUp (&dmaMultiChannel, gpifThread0Socket ^ thread) != CY_U3P_SUCCESS)
           CyU3PDebugPrint (4, "CyFxGpifCallback Channel Set WrapUp failed\r\n");
         gotPartial = CyTrue;
         break;
@@ -917,106 +1590,276 @@ static void gpifCallback (CyU3PGpifEventType event, uint8_t currentState) {
         CyU3PDebugPrint (4, "CyFxGpifCallback failed!\n");
         break;
       }
+
+    if (vidContinuous && (channelMode != CHANNEL_ANALYSER)) {
+      gpifSocketMap (gpifThread0Socket ^ thread ^ 1);
+      CyU3PGpifSMSwitch (257, 0, 257, 0, 2);
+
+      telemetry.restartUsLast = (timerTicks() - hitFVTicks) / (timerFrequency() / 1000000);
+      if (telemetry.restartUsLast > telemetry.restartUsMax)
+        telemetry.restartUsMax = telemetry.restartUsLast;
+      }
+
+    CyU3PEventSet (&uvcEvent, VID_EVENT | FRAME_EVENT, CYU3P_EVENT_OR);
+    }
+  }
+//}}}
+
+//{{{
+static void vidStart() {
+// start gpif capture into first producer socket
+
+  vidProduced = 0;
+  vidTaken = 0;
+  fullEndProduced = 0;
+
+  // Set DMA Channel transfer size, first producer socket
+  CyU3PDmaMultiChannelSetXfer (&dmaMultiChannel, 0, 0);
+
+  if (gpifInitialized == CyFalse) {
+    // init gpif configuration
+    CyU3PGpifLoad ((CyU3PGpifConfig_t*)&CyFxGpifConfig);
+
+    // buffer full counters from plan, 8bit bus, count bytes up to limit
+    CyU3PGpifInitDataCounter (0, vidPlan.payload - 1, CyFalse, CyTrue, 1);
+    CyU3PGpifInitAddrCounter (0, vidPlan.payload - 1, CyFalse, CyTrue, 1);
+    // designer socket config, thread 0 on socket 0
+    gpifThread0Socket = 0;
+    CyU3PGpifSMStart (START, ALPHA_START);
+    gpifInitialized = CyTrue;
+    }
+
+  else {
+    // dma restarts at socket 0, only continuous remaps, left the default path on the designer config
+    if (gpifThread0Socket != 0)
+      gpifSocketMap (0);
+    // Jump to startState of  GPIF state machine,  257 arbitrary invalid state (> 255) number
+    CyU3PGpifSMSwitch (257, 0, 257, 0, 2);
     }
   }
 //}}}
+//{{{
+static void vidFrameDone (uint32_t frameBytes) {
+// frame telemetry, toggle frame ID for the next frame
+
+  telemetry.frames++;
+  telemetry.frameBytesLast = frameBytes;
+  if (frameBytes > telemetry.frameBytesMax)
+    telemetry.frameBytesMax = frameBytes;
+
+  if (stillState == STILL_FRAME) {
+    // still sent, sensor thread can switch back to preview
+    stillState = STILL_DONE;
+    telemetry.stills++;
+    CyU3PEventSet (&uvcEvent, STILL_EVENT, CYU3P_EVENT_OR);
+    }
 
+  // Toggle UVC header FRAME ID bit, not for a ring frame the host never saw
+  if ((channelMode != CHANNEL_RING) || (ringDrop != RING_FRAME))
+    uvcHeaderBFH ^= CY_FX_UVC_HEADER_FRAME_ID;
+  }
+//}}}
 //{{{
 static void vidThreadFunc (uint32_t input) {
+// blocks on VID_EVENT from dma prod, cons and gpif callbacks while streaming
+// - continuous, gpifCallback has already re-armed gpif, frame ends at its EOF buffer
+// - otherwise frame ends once USB has drained it, dma reset, gpif restarted
 
   //uint32_t frameCnt = 0;
   CyU3PReturnStatus_t status = CY_U3P_SUCCESS;
 
+  CyBool_t frameFirst = CyTrue;
+  uint32_t frameBytes = 0;
+  uint32_t windowBytes = 0;
+  uint32_t busyTicks = 0;
+  uint32_t windowTicks = timerTicks();
+  uint32_t windowLength = timerFrequency();
+
   for (;;) {
     uint32_t flag;
-    if (CyU3PEventGet (&uvcEvent, STREAM_EVENT, CYU3P_EVENT_AND, &flag, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
-      // gpif producer buffer ready
+    if (CyU3PEventGet (&uvcEvent, STREAM_ABORT_EVENT, CYU3P_EVENT_AND_CLEAR, &flag, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
+      //{{{  stream abort request pending
+      hitFV = CyFalse;
+      prodCount = 0;
+      consCount = 0;
+      frameFirst = CyTrue;
+      frameBytes = 0;
+
+      if (!clearFeatureRqtReceived) {
+        CyU3PDmaMultiChannelReset (&dmaMultiChannel);
+        if (channelMode == CHANNEL_RING)
+          ringReset();
+        CyU3PUsbFlushEp (CY_FX_EP_BULK_VID);
+        }
+
+      clearFeatureRqtReceived = CyFalse;
+      }
+      //}}}
+    else if (CyU3PEventGet (&uvcEvent, STREAM_EVENT, CYU3P_EVENT_AND, &flag, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
+      if (gpifInitialized == CyFalse)
+        // stream restarted after stopStreaming
+        vidStart();
+
+      CyU3PEventGet (&uvcEvent, VID_EVENT | STREAM_ABORT_EVENT, CYU3P_EVENT_OR, &flag, CYU3P_WAIT_FOREVER);
+      if (!(flag & VID_EVENT))
+        continue;
+
+      uint32_t wakeTicks = timerTicks();
+
+      // clear before draining, a callback after this wakes us again
+      CyU3PEventSet (&uvcEvent, ~VID_EVENT, CYU3P_EVENT_AND);
+
+      // gpif producer buffers ready
       CyU3PDmaBuffer_t produced_buffer;
-      if (CyU3PDmaMultiChannelGetBuffer (&dmaMultiChannel, &produced_buffer, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
+      while (CyU3PDmaMultiChannelGetBuffer (&dmaMultiChannel, &produced_buffer, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
         //{{{  add header, commit to consumer endpoint
-        if (produced_buffer.count == 16384 - 16) {
+        vidTaken++;
+        CyBool_t first = frameFirst;
+        if (frameFirst) {
+          // first buffer of frame, earliest point capture start is known
+          frameFirst = CyFalse;
+          uvcPTS = timerTicks();
+
+          // still frame starts once sensor is in capture mode, frames around the mode switches are torn
+          if (stillState == STILL_ARMED)
+            stillState = STILL_FRAME;
+          uvcFrameFlags = (stillState == STILL_FRAME) ? CY_FX_UVC_HEADER_STILL :
+                          (stillState != STILL_IDLE) ? CY_FX_UVC_HEADER_ERR : 0;
+          if (startProdPending) {
+            startFirstProdTicks = uvcPTS - startRequestTicks;
+            startProdPending = CyFalse;
+            }
+          }
+
+        // partial buffer ends a frame, continuous uncompressed frame can also end on a full buffer
+        CyBool_t eof = produced_buffer.count != vidPlan.payload;
+        if (vidContinuous && !eof && (curFormat == FORMAT_YUY2) &&
+            (frameBytes + produced_buffer.count ==
+             ((uvcFrameFlags & CY_FX_UVC_HEADER_STILL) ? STILL_SIZE : channelFrameSize)))
+          eof = CyTrue;
+        if (vidContinuous && !eof && fullEndProduced && (vidTaken == fullEndProduced))
+          // last buffer of a frame gpif ended on a full buffer, still in hand
+          eof = CyTrue;
+
+        if (!eof) {
           // full buffer, add normal header to buffer
-          if (!analyserMode)
-            CyU3PMemCopy (produced_buffer.buffer - CY_FX_UVC_MAX_HEADER, (uint8_t*)uvcHeader, CY_FX_UVC_MAX_HEADER);
+          if ((channelMode != CHANNEL_ANALYSER))
+            uvcHeaderWrite (produced_buffer.buffer, CY_FX_UVC_HEADER_FRAME);
           }
 
         else {
-          if (!analyserMode)
-            CyU3PMemCopy (produced_buffer.buffer - CY_FX_UVC_MAX_HEADER, (uint8_t*)uvcHeaderEOF, CY_FX_UVC_MAX_HEADER);
+          if ((channelMode != CHANNEL_ANALYSER))
+            uvcHeaderWrite (produced_buffer.buffer, CY_FX_UVC_HEADER_EOF);
 
           // partial buffer, add EOF header to buffer
           gotPartial = CyFalse;
           }
 
-        // commit buffer to consumer endpoint
-        prodCount++;
+        if (channelMode == CHANNEL_RING) {
+          // cpu is the gpif consumer, buffer taken as soon as copied
+          ringPut (&produced_buffer, first);
+          prodCount++;
+          consCount++;
+          frameBytes += produced_buffer.count;
+          windowBytes += produced_buffer.count;
+          telemetry.buffers++;
+          }
 
-        if (analyserMode)
-          status = CyU3PDmaMultiChannelCommitBuffer (&dmaMultiChannel, produced_buffer.count, 0);
-        else
-          status = CyU3PDmaMultiChannelCommitBuffer (&dmaMultiChannel, produced_buffer.count + CY_FX_UVC_MAX_HEADER, 0);
+        else {
+          // commit buffer to consumer endpoint
+          prodCount++;
+
+          if (channelMode == CHANNEL_ANALYSER) {
+            analyserHeaderWrite (produced_buffer.buffer, produced_buffer.count);
+            status = CyU3PDmaMultiChannelCommitBuffer (&dmaMultiChannel, produced_buffer.count + ANALYSER_HEADER_SIZE, 0);
+            }
+          else
+            status = CyU3PDmaMultiChannelCommitBuffer (&dmaMultiChannel, produced_buffer.count + CY_FX_UVC_MAX_HEADER, 0);
+
+          if (status != CY_U3P_SUCCESS) {
+            //line3 ("err", status);
+            prodCount--;
+            telemetry.commitFails++;
+            }
+          else {
+            frameBytes += produced_buffer.count;
+            windowBytes += produced_buffer.count;
+            telemetry.buffers++;
+            uint16_t lag = prodCount - consCount;
+            if (lag > telemetry.maxLag)
+              telemetry.maxLag = lag;
+            }
+          }
 
-        if (status != CY_U3P_SUCCESS) {
-          //line3 ("err", status);
-          prodCount--;
+        if (vidContinuous && eof && (channelMode != CHANNEL_ANALYSER)) {
+          // gpif already on the next frame, its buffers may follow in this loop
+          hitFV = CyFalse;
+          fullEndProduced = 0;
+          vidFrameDone (frameBytes);
+          frameBytes = 0;
+          frameFirst = CyTrue;
           }
         }
         //}}}
+      if (vidContinuous && fullEndProduced && (vidTaken == fullEndProduced)) {
+        // continuous frame ended on a full buffer already committed, no EOF payload, host ends it on the frame ID toggle
+        fullEndProduced = 0;
+        hitFV = CyFalse;
+        if (!frameFirst) {
+          vidFrameDone (frameBytes);
+          frameBytes = 0;
+          frameFirst = CyTrue;
+          }
+        }
+
+      if (channelMode == CHANNEL_RING)
+        ringSend();
 
-      if (hitFV && (prodCount == consCount) && !gotPartial) {
+      if (!vidContinuous && hitFV && (prodCount == consCount) && !gotPartial) {
         //{{{  endOfFrame, restart next frame
         //line3 ("f", frameCnt++);
         prodCount = 0;
         consCount = 0;
         hitFV = CyFalse;
         backFlowDetected = 0;
-
-        // Toggle UVC header FRAME ID bit
-        uvcHeader[1] ^= CY_FX_UVC_HEADER_FRAME_ID;
-        uvcHeaderEOF[1] =  uvcHeader[1];
+        vidFrameDone (frameBytes);
+        frameBytes = 0;
+        frameFirst = CyTrue;
 
         // restart dma, gpif
         CyU3PDmaMultiChannelReset (&dmaMultiChannel);
         CyU3PDmaMultiChannelSetXfer (&dmaMultiChannel, 0, 0);
         CyU3PGpifSMSwitch (257, 0, 257, 0, 2);
+
+        telemetry.restartUsLast = (timerTicks() - hitFVTicks) / (windowLength / 1000000);
+        if (telemetry.restartUsLast > telemetry.restartUsMax)
+          telemetry.restartUsMax = telemetry.restartUsLast;
         }
         //}}}
-      }
-    else if (CyU3PEventGet (&uvcEvent, STREAM_ABORT_EVENT, CYU3P_EVENT_AND_CLEAR, &flag, CYU3P_NO_WAIT) == CY_U3P_SUCCESS) {
-      //{{{  stream abort request pending
-      hitFV = CyFalse;
-      prodCount = 0;
-      consCount = 0;
 
-      if (!clearFeatureRqtReceived) {
-        CyU3PDmaMultiChannelReset (&dmaMultiChannel);
-        CyU3PUsbFlushEp (CY_FX_EP_BULK_VID);
+      //{{{  busy time, per mille, throughput of each 1s streaming window
+      uint32_t doneTicks = timerTicks();
+      busyTicks += doneTicks - wakeTicks;
+      if (doneTicks - windowTicks >= windowLength) {
+        telemetry.vidBusyPerMille = busyTicks / ((doneTicks - windowTicks) / 1000);
+        telemetry.bytesPerSec = ((uint64_t)windowBytes * windowLength) / (doneTicks - windowTicks);
+        busyTicks = 0;
+        windowBytes = 0;
+        windowTicks = doneTicks;
         }
-
-      clearFeatureRqtReceived = CyFalse;
-      }
       //}}}
+      }
     else {
       //{{{  idle, wait for start streaming request
       CyU3PEventGet (&uvcEvent, STREAM_EVENT, CYU3P_EVENT_AND, &flag, CYU3P_WAIT_FOREVER);
+      vidStart();
 
-      // Set DMA Channel transfer size, first producer socket
-      CyU3PDmaMultiChannelSetXfer (&dmaMultiChannel, 0, 0);
-
-      if (gpifInitialized == CyFalse) {
-        // init gpif configuration
-        CyU3PGpifLoad ((CyU3PGpifConfig_t*)&CyFxGpifConfig);
-        CyU3PGpifSMStart (START, ALPHA_START);
-        gpifInitialized = CyTrue;
-        }
-
-      else
-        // Jump to startState of  GPIF state machine,  257 arbitrary invalid state (> 255) number
-        CyU3PGpifSMSwitch (257, 0, 257, 0, 2);
+      frameFirst = CyTrue;
+      busyTicks = 0;
+      windowBytes = 0;
+      windowTicks = timerTicks();
       }
       //}}}
-
-    CyU3PThreadRelinquish();
     }
   }
 //}}}
@@ -1037,6 +1880,8 @@ static void stopStreaming() {
 
   // Reset and flush the endpoint pipe
   CyU3PDmaMultiChannelReset (&dmaMultiChannel);
+  if (channelMode == CHANNEL_RING)
+    ringReset();
   CyU3PUsbFlushEp (CY_FX_EP_BULK_VID);
   CyU3PUsbSetEpNak (CY_FX_EP_BULK_VID, CyFalse);
   CyU3PBusyWait (100);
@@ -1058,53 +1903,390 @@ static void abortHandler() {
     }
   }
 //}}}
-
 //{{{
-static void USBEventCallback (CyU3PUsbEventType_t evtype, uint16_t  evdata ) {
-
-  switch (evtype) {
-    case CY_U3P_USB_EVENT_RESET:
-      CyU3PDebugPrint (4, "RESET encountered...\r\n");
-      CyU3PGpifDisable (CyTrue);
-      gpifInitialized = 0;
-      streamingStarted = CyFalse;
-      abortHandler();
-      break;
-
-    case CY_U3P_USB_EVENT_SUSPEND:
-      CyU3PDebugPrint (4, "SUSPEND encountered...\r\n");
-      CyU3PGpifDisable (CyTrue);
-      gpifInitialized = 0;
-      streamingStarted = CyFalse;
-      abortHandler();
-      break;
-
-    case CY_U3P_USB_EVENT_DISCONNECT:
-      CyU3PDebugPrint (4, "USB disconnected...\r\n");
-      CyU3PGpifDisable (CyTrue);
-      gpifInitialized = 0;
-      usbSpeed = CY_U3P_NOT_CONNECTED;
-      streamingStarted = CyFalse;
-      abortHandler();
-      break;
+static const frame_t* frameFind (uint8_t format, uint8_t index) {
+// frame table entry for format, usb speed, out of range index clamps to first or last
+
+  const frame_t* frames = framesMJPEG;
+  uint8_t count = FRAME_COUNT_MJPEG;
+  if (format != FORMAT_MJPEG) {
+    frames = (usbSpeed == CY_U3P_SUPER_SPEED) ? framesSS : framesHS;
+    count = (usbSpeed == CY_U3P_SUPER_SPEED) ? FRAME_COUNT_SS : FRAME_COUNT_HS;
+    }
 
-    case CY_U3P_USB_EVENT_EP_UNDERRUN:
-      CyU3PDebugPrint (4, "CY_U3P_USB_EVENT_EP_UNDERRUN encountered...\r\n");
-      break;
+  if (index < 1)
+    index = 1;
+  if (index > count)
+    index = count;
 
-    default:
-      break;
-    }
+  return &frames[index - 1];
   }
 //}}}
 //{{{
-static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
-// Callback to handle the USB Setup Requests and UVC Class events
+static uint32_t frameSize (uint8_t format, const frame_t* frame) {
+// max bytes in a frame
 
-  bReqType =  setupdat0 & CY_U3P_USB_REQUEST_TYPE_MASK;
-  bType    =  bReqType  & CY_U3P_USB_TYPE_MASK;
-  bTarget  =  bReqType  & CY_U3P_USB_TARGET_MASK;
-  bRequest = (setupdat0 & CY_U3P_USB_REQUEST_MASK) >> CY_U3P_USB_REQUEST_POS;
+  if (format == FORMAT_MJPEG)
+    return FRAME_SIZE_MJPEG (frame->width, frame->height);
+  else
+    return FRAME_SIZE_YUY2 (frame->width, frame->height);
+  }
+//}}}
+//{{{
+static uint32_t frameInterval (uint8_t format, const frame_t* frame, uint32_t interval) {
+// fastest listed interval no faster than requested, or than usb speed bandwidth sustains
+// - 0 requests fastest, 0xFFFFFFFF slowest
+
+  uint32_t bytes = (format == FORMAT_MJPEG) ? FRAME_AVERAGE_MJPEG (frame->width, frame->height) :
+                                              FRAME_SIZE_YUY2 (frame->width, frame->height);
+  uint32_t bandwidth = (usbSpeed == CY_U3P_SUPER_SPEED) ? FRAME_BANDWIDTH_SS : FRAME_BANDWIDTH_HS;
+  uint32_t sustainable = (bytes * 100) / (bandwidth / 100000);
+  if (interval < sustainable)
+    interval = sustainable;
+
+  for (int i = 0; i < 3; i++)
+    if (frame->interval[i] >= interval)
+      return frame->interval[i];
+
+  return frame->interval[2];
+  }
+//}}}
+//{{{
+static uint32_t uvcFrameSize() {
+
+  return frameSize (curFormat, frameFind (curFormat, curFrameIndex));
+  }
+//}}}
+//{{{
+static uint8_t isocCount() {
+// isochronous alt settings at usb speed, 0 bulk
+
+  if (!UVC_ISOC)
+    return 0;
+
+  return (usbSpeed == CY_U3P_SUPER_SPEED) ? ISOC_COUNT_SS : ISOC_COUNT_HS;
+  }
+//}}}
+//{{{
+static uint32_t isocBytes (uint8_t alt) {
+// bytes per service interval of alt setting at usb speed, 0 for alt 0 or bulk
+
+  if (!UVC_ISOC || !alt)
+    return 0;
+
+  const isocTier_t* tiers = (usbSpeed == CY_U3P_SUPER_SPEED) ? isocTiersSS : isocTiersHS;
+  if (alt > isocCount())
+    alt = isocCount();
+
+  return tiers[alt-1].packet * tiers[alt-1].burst * tiers[alt-1].mult;
+  }
+//}}}
+//{{{
+static uint32_t isocPayloadSize (uint32_t frameBytes, uint32_t interval) {
+// payload transfer size of lowest alt setting carrying frameBytes each interval
+// - payload includes header, buffer footer never sent, highest alt if none fits
+
+  uint32_t bytes = 0;
+  for (uint8_t alt = 1; alt <= isocCount(); alt++) {
+    bytes = isocBytes (alt);
+    // 1250 service intervals of 125us in a 100ns unit interval of 10000000
+    if ((uint64_t)(bytes - CY_FX_UVC_MAX_HEADER - 4) * interval >= (uint64_t)frameBytes * 1250)
+      break;
+    }
+
+  return bytes - 4;
+  }
+//}}}
+//{{{
+static void probeFill (uint8_t* probe, uint8_t format, uint8_t index, uint32_t interval) {
+// fill probe control for format, frame index, interval clamped to frame table, usb speed
+// - dwMaxVideoFrameSize max frame, mjpeg upper bound
+// - dwMaxPayloadTransferSize one dma buffer less footer, header included
+//   isochronous, lowest alt setting sustaining the frame rate, so host reserves no more than that
+// - MJPEG falls back to YUY2 on a sensor without a jpeg encoder
+
+  if ((format != FORMAT_MJPEG) || !sensorJpegCapable())
+    format = FORMAT_YUY2;
+
+  const frame_t* frame = frameFind (format, index);
+  interval = frameInterval (format, frame, interval);
+  uint32_t maxFrameSize = frameSize (format, frame);
+  uint32_t payloadSize = ((usbSpeed == CY_U3P_SUPER_SPEED) ? BUFFER_PLAN_SIZE_SS : BUFFER_PLAN_SIZE_HS) - 4;
+  if (UVC_ISOC)
+    payloadSize = isocPayloadSize ((format == FORMAT_MJPEG) ? FRAME_AVERAGE_MJPEG (frame->width, frame->height) :
+                                                              maxFrameSize, interval);
+
+  CyU3PMemSet (probe, 0, CY_FX_UVC_MAX_PROBE_SETTING);
+  probe[2] = format;        // bFormatIndex
+  probe[3] = frame->index;  // bFrameIndex
+
+  probe[4] = interval;      // dwFrameInterval
+  probe[5] = interval >> 8;
+  probe[6] = interval >> 16;
+  probe[7] = interval >> 24;
+
+  probe[18] = maxFrameSize; // dwMaxVideoFrameSize
+  probe[19] = maxFrameSize >> 8;
+  probe[20] = maxFrameSize >> 16;
+  probe[21] = maxFrameSize >> 24;
+
+  probe[22] = payloadSize;  // dwMaxPayloadTransferSize
+  probe[23] = payloadSize >> 8;
+  probe[24] = payloadSize >> 16;
+  probe[25] = payloadSize >> 24;
+  }
+//}}}
+//{{{
+static void stillFill (uint8_t* probe) {
+// fill still probe control, one YUY2 still frame, payload as negotiated for the preview
+
+  uint32_t maxFrameSize = STILL_SIZE;
+
+  CyU3PMemSet (probe, 0, CY_FX_UVC_MAX_STILL_PROBE);
+  probe[0] = FORMAT_YUY2;   // bFormatIndex
+  probe[1] = 1;             // bFrameIndex
+  probe[2] = 0;             // bCompressionIndex
+
+  probe[3] = maxFrameSize;  // dwMaxVideoFrameSize
+  probe[4] = maxFrameSize >> 8;
+  probe[5] = maxFrameSize >> 16;
+  probe[6] = maxFrameSize >> 24;
+
+  probe[7] = probeCtrl[22]; // dwMaxPayloadTransferSize
+  probe[8] = probeCtrl[23];
+  probe[9] = probeCtrl[24];
+  probe[10] = probeCtrl[25];
+  }
+//}}}
+//{{{
+static void channelSwitch (uint8_t mode) {
+// create manual dmaMultiChannel for mode, gpif to USB host
+// - keep existing channel if mode, usb speed, frame size and isochronous alt setting unchanged
+// - buffers planned after destroy, so the old channel buffers count as free heap
+// - CHANNEL_NONE destroys channel, isochronous UVC has no channel in alt setting 0
+
+  if (UVC_ISOC && (mode == CHANNEL_UVC) && !isocAlt)
+    mode = CHANNEL_NONE;
+  if ((mode == CHANNEL_UVC) && ringEnable)
+    mode = CHANNEL_RING;
+
+  CyBool_t uvc = (mode == CHANNEL_UVC) || (mode == CHANNEL_RING);
+  uint32_t frameSize = uvc ? uvcFrameSize() : 0;
+  uint32_t bufferSize = uvc ? isocBytes (isocAlt) : 0;
+  if ((mode == channelMode) && (usbSpeed == channelSpeed) && (frameSize == channelFrameSize) &&
+      ((mode == CHANNEL_NONE) || (bufferSize == channelBufferSize)))
+    return;
+
+  if (streamingStarted) {
+    // switching mode under a live stream
+    stopStreaming();
+    abortHandler();
+    }
+
+  if (channelMode == CHANNEL_RING)
+    ringDestroy();
+  if (channelMode != CHANNEL_NONE)
+    CyU3PDmaMultiChannelDestroy (&dmaMultiChannel);
+
+  channelMode = mode;
+  if (mode == CHANNEL_NONE)
+    return;
+
+  if (mode == CHANNEL_ANALYSER)
+    bufferPlanMake (&vidPlan, usbSpeed, 0, 0, ANALYSER_HEADER_SIZE, 0);
+  else
+    bufferPlanMake (&vidPlan, usbSpeed, bufferSize, frameSize, CY_FX_UVC_MAX_HEADER, 4);
+  if (mode == CHANNEL_RING)
+    // cpu consumer, buffers back to gpif as soon as copied, ring takes the spare heap
+    vidPlan.count = RING_GPIF_COUNT;
+
+  CyU3PDmaMultiChannelConfig_t dmaMultiChannelConfig;
+  CyU3PMemSet ((uint8_t*)&dmaMultiChannelConfig, 0, sizeof(dmaMultiChannelConfig));
+  dmaMultiChannelConfig.size           = vidPlan.size;
+  dmaMultiChannelConfig.count          = vidPlan.count;
+  dmaMultiChannelConfig.validSckCount  = 2;
+  dmaMultiChannelConfig.prodSckId [0]  = CY_U3P_PIB_SOCKET_0;
+  dmaMultiChannelConfig.prodSckId [1]  = CY_U3P_PIB_SOCKET_1;
+  if (mode == CHANNEL_ANALYSER) {
+    dmaMultiChannelConfig.consSckId [0]  = CY_U3P_UIB_SOCKET_CONS_1; // ep1
+    dmaMultiChannelConfig.prodHeader     = ANALYSER_HEADER_SIZE;
+    dmaMultiChannelConfig.prodFooter     = 0;
+    }
+  else {
+    dmaMultiChannelConfig.consSckId [0]  = (mode == CHANNEL_RING) ? CY_U3P_CPU_SOCKET_CONS : CY_U3P_UIB_SOCKET_CONS_3; // ep3
+    dmaMultiChannelConfig.prodHeader     = 12; // 12 byte UVC header to be added
+    dmaMultiChannelConfig.prodFooter     = 4;  // byte footer to compensate for the 12 byte header
+    }
+  dmaMultiChannelConfig.dmaMode        = CY_U3P_DMA_MODE_BYTE;
+  dmaMultiChannelConfig.notification   = (mode == CHANNEL_RING) ? CY_U3P_DMA_CB_PROD_EVENT :
+                                           CY_U3P_DMA_CB_PROD_EVENT | CY_U3P_DMA_CB_CONS_EVENT;
+  dmaMultiChannelConfig.cb             = vidDmaCallback;
+  CyU3PDmaMultiChannelCreate (&dmaMultiChannel, CY_U3P_DMA_TYPE_MANUAL_MANY_TO_ONE, &dmaMultiChannelConfig);
+
+  if ((mode == CHANNEL_RING) && !ringCreate (frameSize)) {
+    // spare heap cannot hold a whole frame, ring mode off until the host enables it again, plain UVC channel
+    line2 ("ring fallback");
+    CyU3PDmaMultiChannelDestroy (&dmaMultiChannel);
+    channelMode = CHANNEL_NONE;
+    ringEnable = CyFalse;
+    channelSwitch (CHANNEL_UVC);
+    return;
+    }
+
+  channelSpeed = usbSpeed;
+  channelFrameSize = frameSize;
+  channelBufferSize = bufferSize;
+  channelCreates++;
+  }
+//}}}
+//{{{
+static void channelSetMode (uint8_t mode) {
+// channelSwitch serialised, commit in the control thread, alt setting and analyser start in the setup callback
+
+  CyU3PMutexGet (&channelMutex, CYU3P_WAIT_FOREVER);
+  channelSwitch (mode);
+  CyU3PMutexPut (&channelMutex);
+  }
+//}}}
+//{{{
+static void streamStart() {
+// mark stream start request for latency counters, kick vid thread
+
+  streamStarts++;
+  startRequestTicks = timerTicks();
+  startProdPending = CyTrue;
+  CyU3PEventSet (&uvcEvent, STREAM_EVENT, CYU3P_EVENT_OR);
+  }
+//}}}
+//{{{
+static void streamSetAlt (uint8_t alt) {
+// VS interface SET_INTERFACE
+// - alt 0 stops streaming, destroys the channel releasing its buffers, isochronous endpoint disabled
+// - isochronous alt 1..n configures the endpoint for its tier, plans one buffer per service interval, starts
+
+  if (streamingStarted) {
+    stopStreaming();
+    // stopStreaming reset the channel, vid thread abort must not touch it once destroyed
+    clearFeatureRqtReceived = CyTrue;
+    abortHandler();
+    }
+
+  isocAlt = alt;
+  channelSetMode (alt ? CHANNEL_UVC : CHANNEL_NONE);
+
+  if (UVC_ISOC) {
+    CyU3PEpConfig_t epConfig;
+    CyU3PMemSet ((uint8_t*)&epConfig, 0, sizeof(epConfig));
+    if (alt) {
+      const isocTier_t* tier = ((usbSpeed == CY_U3P_SUPER_SPEED) ? isocTiersSS : isocTiersHS) + alt - 1;
+      epConfig.enable   = 1;
+      epConfig.epType   = CY_U3P_USB_EP_ISO;
+      epConfig.pcktSize = tier->packet;
+      epConfig.burstLen = tier->burst;
+      epConfig.isoPkts  = tier->burst * tier->mult;
+      }
+    CyU3PSetEpConfig (CY_FX_EP_BULK_VID, &epConfig);
+
+    if (alt)
+      streamStart();
+    }
+  }
+//}}}
+
+//{{{
+static void USBEventCallback (CyU3PUsbEventType_t evtype, uint16_t  evdata ) {
+
+  switch (evtype) {
+    case CY_U3P_USB_EVENT_RESET:
+      CyU3PDebugPrint (4, "RESET encountered...\r\n");
+      CyU3PDmaChannelReset (&statusChannel);
+      CyU3PDmaChannelSetXfer (&statusChannel, 0);
+      probeCtrl[2] = 0;
+      isocAlt = 0;
+      CyU3PGpifDisable (CyTrue);
+      gpifInitialized = 0;
+      streamingStarted = CyFalse;
+      abortHandler();
+      break;
+
+    case CY_U3P_USB_EVENT_SUSPEND:
+      CyU3PDebugPrint (4, "SUSPEND encountered...\r\n");
+      CyU3PGpifDisable (CyTrue);
+      gpifInitialized = 0;
+      streamingStarted = CyFalse;
+      abortHandler();
+      break;
+
+    case CY_U3P_USB_EVENT_DISCONNECT:
+      CyU3PDebugPrint (4, "USB disconnected...\r\n");
+      CyU3PDmaChannelReset (&statusChannel);
+      CyU3PDmaChannelSetXfer (&statusChannel, 0);
+      probeCtrl[2] = 0;
+      isocAlt = 0;
+      CyU3PGpifDisable (CyTrue);
+      gpifInitialized = 0;
+      usbSpeed = CY_U3P_NOT_CONNECTED;
+      streamingStarted = CyFalse;
+      abortHandler();
+      break;
+
+    case CY_U3P_USB_EVENT_EP_UNDERRUN:
+      CyU3PDebugPrint (4, "CY_U3P_USB_EVENT_EP_UNDERRUN encountered...\r\n");
+      telemetry.underruns++;
+      break;
+
+    default:
+      break;
+    }
+  }
+//}}}
+//{{{
+static CyBool_t setupPut() {
+// copy current setup request to control thread, false stalls it when queue full
+
+  if (setupIn - setupOut >= SETUP_QUEUE_SIZE) {
+    telemetry.setupDrops++;
+    return CyFalse;
+    }
+
+  setupReq_t* req = &setupQueue[setupIn % SETUP_QUEUE_SIZE];
+  req->bReqType = bReqType;
+  req->bRequest = bRequest;
+  req->wValue = wValue;
+  req->wIndex = wIndex;
+  req->wLength = wLength;
+  setupIn++;
+
+  CyU3PEventSet (&uvcEvent, SETUP_EVENT, CYU3P_EVENT_OR);
+  return CyTrue;
+  }
+//}}}
+//{{{
+static CyBool_t sensorPost (uint8_t op, uint16_t value, uint8_t arg, uint32_t interval) {
+// queue sensor work for sensor thread, never blocks caller, CyFalse if queue full
+
+  sensorWork_t work;
+  work.op = op;
+  work.arg = arg;
+  work.value = value;
+  work.interval = interval;
+
+  if (CyU3PQueueSend (&sensorQueue, &work, CYU3P_NO_WAIT) != CY_U3P_SUCCESS) {
+    telemetry.sensorDrops++;
+    return CyFalse;
+    }
+
+  return CyTrue;
+  }
+//}}}
+//{{{
+static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
+// Callback to handle the USB Setup Requests and UVC Class events
+
+  bReqType =  setupdat0 & CY_U3P_USB_REQUEST_TYPE_MASK;
+  bType    =  bReqType  & CY_U3P_USB_TYPE_MASK;
+  bTarget  =  bReqType  & CY_U3P_USB_TARGET_MASK;
+  bRequest = (setupdat0 & CY_U3P_USB_REQUEST_MASK) >> CY_U3P_USB_REQUEST_POS;
   wValue   = (setupdat0 & CY_U3P_USB_VALUE_MASK) >> CY_U3P_USB_VALUE_POS;
   wIndex   = (setupdat1 & CY_U3P_USB_INDEX_MASK) >> CY_U3P_USB_INDEX_POS;
   wLength  = (setupdat1 & CY_U3P_USB_LENGTH_MASK) >> CY_U3P_USB_LENGTH_POS;
@@ -1117,9 +2299,9 @@ static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
         break;
       case 0xAC:
         //{{{  sensorFocus
-        CyU3PUsbGetEP0Data (wLength, glEp0Buffer, NULL);
+        CyU3PUsbGetEP0Data ((wLength < sizeof(setupEp0Buffer)) ? wLength : sizeof(setupEp0Buffer), setupEp0Buffer, NULL);
 
-        sensorFocus (wValue);
+        sensorPost (SENSOR_FOCUS, wValue, 0, 0);
 
         isHandled = CyTrue;
         break;
@@ -1127,56 +2309,78 @@ static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
       case 0xAD:
         //{{{  readReg
         //line3 ("vRead", wValue);
-        I2C_Read (wValue >> 8, wValue & 0xFF, glEp0Buffer);
-        CyU3PUsbSendEP0Data (2, glEp0Buffer);
+        // sensor thread reads and sends the data stage, ep0 naks until then
+        if (!sensorPost (SENSOR_READ, wValue, 0, 0))
+          CyU3PUsbStall (0, CyTrue, CyFalse);
         isHandled = CyTrue;
         break;
         //}}}
       case 0xAE:
         //{{{  writeReg
         //line3 ("vWrite", wValue);
-        CyU3PUsbGetEP0Data (wLength, glEp0Buffer, NULL);
-        I2C_Write (wValue >> 8, wValue & 0xFF, glEp0Buffer[0], glEp0Buffer[1]);
+        CyU3PUsbGetEP0Data ((wLength < sizeof(setupEp0Buffer)) ? wLength : sizeof(setupEp0Buffer), setupEp0Buffer, NULL);
+        sensorPost (SENSOR_WRITE, wValue, 0, (setupEp0Buffer[0] << 8) | setupEp0Buffer[1]);
         isHandled = CyTrue;
         break;
         //}}}
       case 0xAF:
-        //{{{  start analyser streaming
-        CyU3PUsbGetEP0Data (wLength, glEp0Buffer, NULL);
-
-        if (streamingStarted == CyTrue) {
-          stopStreaming();
-          abortHandler();
-          }
-
-        if (analyserMode == CyFalse) {
-          analyserMode = CyTrue;
-          CyU3PDmaMultiChannelDestroy (&dmaMultiChannel);
-
-          // create manual dmaMultiChannel for video to USB host
-          CyU3PDmaMultiChannelConfig_t dmaMultiChannelConfig;
-          CyU3PMemSet ((uint8_t*)&dmaMultiChannelConfig, 0, sizeof(dmaMultiChannelConfig));
-
-          dmaMultiChannelConfig.size           = 16384;
-          dmaMultiChannelConfig.count          = 4;
-          dmaMultiChannelConfig.validSckCount  = 2;
-          dmaMultiChannelConfig.prodSckId [0]  = CY_U3P_PIB_SOCKET_0;
-          dmaMultiChannelConfig.prodSckId [1]  = CY_U3P_PIB_SOCKET_1;
-
-          dmaMultiChannelConfig.consSckId [0]  = CY_U3P_UIB_SOCKET_CONS_1; // ep1
-          dmaMultiChannelConfig.prodHeader     = 0;
-          dmaMultiChannelConfig.prodFooter     = 16;
-
-          dmaMultiChannelConfig.dmaMode        = CY_U3P_DMA_MODE_BYTE;
-          dmaMultiChannelConfig.notification   = CY_U3P_DMA_CB_CONS_EVENT;
-          dmaMultiChannelConfig.cb             = vidDmaCallback;
-
-          CyU3PDmaMultiChannelCreate (&dmaMultiChannel, CY_U3P_DMA_TYPE_MANUAL_MANY_TO_ONE, &dmaMultiChannelConfig);
-          }
-
-        sensorScaling (600);
-        CyU3PEventSet (&uvcEvent, STREAM_EVENT, CYU3P_EVENT_OR);
-
+        //{{{  start analyser streaming, queued to control thread, stream stop takes channelMutex
+        isHandled = setupPut();
+        break;
+        //}}}
+      case 0xB0: {
+        //{{{  read channel, stream start latency counters us
+        uint32_t ticksPerUs = timerFrequency() / 1000000;
+        startStats.channelCreates = channelCreates;
+        startStats.streamStarts = streamStarts;
+        startStats.firstProdUs = startFirstProdTicks / ticksPerUs;
+        startStats.firstConsUs = startFirstConsTicks / ticksPerUs;
+        startStats.maxConsUs = startMaxConsTicks / ticksPerUs;
+        CyU3PUsbSendEP0Data ((wLength < sizeof(startStats)) ? wLength : sizeof(startStats), (uint8_t*)&startStats);
+        isHandled = CyTrue;
+        break;
+        }
+        //}}}
+      case 0xB1:
+        //{{{  read dma buffer plan
+        CyU3PUsbSendEP0Data ((wLength < sizeof(vidPlan)) ? wLength : sizeof(vidPlan), (uint8_t*)&vidPlan);
+        isHandled = CyTrue;
+        break;
+        //}}}
+      case 0xB2:
+        //{{{  read telemetry, reset if wValue
+        CyU3PUsbSendEP0Data ((wLength < sizeof(telemetry)) ? wLength : sizeof(telemetry), (uint8_t*)&telemetry);
+        if (wValue)
+          CyU3PMemSet ((uint8_t*)&telemetry, 0, sizeof(telemetry));
+        isHandled = CyTrue;
+        break;
+        //}}}
+      case 0xB3:
+        //{{{  ring mode enable from wValue, takes effect at next commit, no data stage
+        CyU3PUsbAckSetup();
+        ringEnable = (wValue != 0);
+        isHandled = CyTrue;
+        break;
+        //}}}
+      case 0xB4:
+        //{{{  continuous streaming enable from wValue, takes effect at next stream start, no data stage
+        CyU3PUsbAckSetup();
+        if (!streamingStarted)
+          vidContinuous = (wValue != 0);
+        isHandled = CyTrue;
+        break;
+        //}}}
+      case 0xB5:
+        //{{{  read ae af controller state, convergence times
+        CyU3PUsbSendEP0Data ((wLength < sizeof(aeaf)) ? wLength : sizeof(aeaf), (uint8_t*)&aeaf);
+        isHandled = CyTrue;
+        break;
+        //}}}
+      case 0xB6:
+        //{{{  read sensor init ms, shadow hits misses
+        sensorCounters.initMs = sensorInitMs();
+        sensorShadowCounters (&sensorCounters.shadowHits, &sensorCounters.shadowMisses);
+        CyU3PUsbSendEP0Data ((wLength < sizeof(sensorCounters)) ? wLength : sizeof(sensorCounters), (uint8_t*)&sensorCounters);
         isHandled = CyTrue;
         break;
         //}}}
@@ -1191,36 +2395,16 @@ static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
       case CY_FX_USB_UVC_GET_REQ_TYPE:
       //{{{
       case CY_FX_USB_UVC_SET_REQ_TYPE:   // start UVC streaming
-        // UVC Specific requests are handled in the EP0 thread
+        // UVC Specific requests are queued to the control thread
         switch (wIndex & 0xFF) {
           case CY_FX_UVC_CONTROL_INTERFACE: {
-            CyU3PEventSet (&uvcEvent, VIDEO_CONTROL_EVENT, CYU3P_EVENT_OR);
-            isHandled = CyTrue;
+            isHandled = setupPut();
             break;
             }
 
           case CY_FX_UVC_STREAM_INTERFACE: {
-            analyserMode = CyFalse;
-            CyU3PDmaMultiChannelDestroy (&dmaMultiChannel);
-
-            // create manual dmaMultiChannel for video to USB host
-            CyU3PDmaMultiChannelConfig_t dmaMultiChannelConfig;
-            CyU3PMemSet ((uint8_t*)&dmaMultiChannelConfig, 0, sizeof(dmaMultiChannelConfig));
-            dmaMultiChannelConfig.size           = 16384;
-            dmaMultiChannelConfig.count          = 4;
-            dmaMultiChannelConfig.validSckCount  = 2;
-            dmaMultiChannelConfig.prodSckId [0]  = CY_U3P_PIB_SOCKET_0;
-            dmaMultiChannelConfig.prodSckId [1]  = CY_U3P_PIB_SOCKET_1;
-            dmaMultiChannelConfig.consSckId [0]  = CY_U3P_UIB_SOCKET_CONS_3; // ep3
-            dmaMultiChannelConfig.prodHeader     = 12; // 12 byte UVC header to be added
-            dmaMultiChannelConfig.prodFooter     = 4;  // byte footer to compensate for the 12 byte header
-            dmaMultiChannelConfig.dmaMode        = CY_U3P_DMA_MODE_BYTE;
-            dmaMultiChannelConfig.notification   = CY_U3P_DMA_CB_CONS_EVENT;
-            dmaMultiChannelConfig.cb             = vidDmaCallback;
-            CyU3PDmaMultiChannelCreate (&dmaMultiChannel, CY_U3P_DMA_TYPE_MANUAL_MANY_TO_ONE, &dmaMultiChannelConfig);
-
-            CyU3PEventSet (&uvcEvent, VIDEO_STREAM_EVENT, CYU3P_EVENT_OR);
-            isHandled = CyTrue;
+            // channel mode changed by the commit in the control thread, with the frame it commits
+            isHandled = setupPut();
             break;
             }
 
@@ -1232,9 +2416,14 @@ static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
       //}}}
       //{{{
       case CY_FX_USB_SET_INTF_REQ_TYPE:
-        if (bRequest == CY_FX_USB_SET_INTERFACE_REQ) {
+        if ((bRequest == CY_FX_USB_SET_INTERFACE_REQ) && (wIndex == CY_FX_UVC_STREAM_INTERFACE)) {
           // MAC OS sends Set Interface Alternate Setting 0 command after
-          //stopping to stream. This application needs to stop streaming
+          // stopping to stream, isochronous hosts select alt setting to start, 0 to stop
+          if ((channelMode != CHANNEL_ANALYSER) && (wValue <= isocCount())) {
+            CyU3PUsbAckSetup();
+            streamSetAlt (wValue);
+            isHandled = CyTrue;
+            }
           }
         break;
       //}}}
@@ -1278,83 +2467,259 @@ static CyBool_t USBSetupCallback (uint32_t setupdat0, uint32_t setupdat1) {
 //{{{
 static void pibCallback (CyU3PPibIntrType cbType, uint16_t cbArg) {
 
+  if (cbType == CYU3P_PIB_INTR_ERROR) {
+    analyserPib = CyTrue;
+    telemetry.pibErrors[CYU3P_GET_PIB_ERROR_TYPE (cbArg) & 0x1F]++;
+    if (CYU3P_GET_GPIF_ERROR_TYPE (cbArg))
+      telemetry.gpifErrors++;
+    }
+
   if ((cbType == CYU3P_PIB_INTR_ERROR) && ((cbArg == 0x1005) || (cbArg == 0x1006))) {
     if (!backFlowDetected) {
       CyU3PDebugPrint (4, "Backflow detected\r\n");
       line2 ("b");
       backFlowDetected = 1;
+      statusStream (1, 0);
       }
     }
   }
 //}}}
 
 //{{{
-static void processingUnitRequests() {
+static uint32_t aeExposureMax() {
+// longest exposure, 100us units, the committed frame interval
+
+  return curInterval ? (curInterval / 1000) : 333;
+  }
+//}}}
+
+//{{{
+static void processingUnitRequests (const setupReq_t* req) {
+// table driven, selector indexes puControls, GET served from table, SET posted to sensor thread
+
+  uint8_t index = req->wValue >> 8;
+  if ((index >= PU_CONTROLS) || (puControls[index].length == 0)) {
+    CyU3PUsbStall (0, CyTrue, CyFalse);
+    return;
+    }
+
+  const puControl_t* control = &puControls[index];
+  CyBool_t wbAuto = puCur[CY_FX_UVC_PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL >> 8] != 0;
+  CyBool_t autoDisabled = wbAuto && (control->control == CONTROL_WB_TEMP);
+
+  int16_t value;
+  switch (req->bRequest) {
+    case CY_FX_USB_UVC_GET_LEN_REQ:
+      glEp0Buffer[0] = control->length;
+      glEp0Buffer[1] = 0;
+      CyU3PUsbSendEP0Data (2, (uint8_t*)glEp0Buffer);
+      return;
+
+    case CY_FX_USB_UVC_GET_INFO_REQ: // GET and SET supported, D2 disabled while white balance auto
+      glEp0Buffer[0] = autoDisabled ? 0x07 : 0x03;
+      CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+      return;
+
+    case CY_FX_USB_UVC_GET_CUR_REQ:
+      value = puCur[index];
+      break;
+    case CY_FX_USB_UVC_GET_MIN_REQ:
+      value = control->min;
+      break;
+    case CY_FX_USB_UVC_GET_MAX_REQ:
+      value = control->max;
+      break;
+    case CY_FX_USB_UVC_GET_RES_REQ:
+      value = control->res;
+      break;
+    case CY_FX_USB_UVC_GET_DEF_REQ:
+      value = control->def;
+      break;
+
+    case CY_FX_USB_UVC_SET_CUR_REQ: {
+      // data stage acks the request, a stall now would hit the host's next request, bad value dropped, GET_CUR shows it
+      uint16_t readCount;
+      if (CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, glEp0Buffer, &readCount) == CY_U3P_SUCCESS) {
+        value = (control->length == 1) ? glEp0Buffer[0] : (int16_t)(glEp0Buffer[0] | (glEp0Buffer[1] << 8));
+        if (!autoDisabled && (value >= control->min) && (value <= control->max)) {
+          puCur[index] = value;
+          sensorPost (SENSOR_CONTROL, value, control->control, 0);
+          }
+        }
+      return;
+      }
+
+    default:
+      CyU3PUsbStall (0, CyTrue, CyFalse);
+      return;
+    }
+
+  glEp0Buffer[0] = value & 0xFF;
+  glEp0Buffer[1] = (value >> 8) & 0xFF;
+  CyU3PUsbSendEP0Data (control->length, (uint8_t*)glEp0Buffer);
+  }
+//}}}
+//{{{
+static void cameraTerminalRequests (const setupReq_t* req) {
+
+  CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
 
   uint16_t readCount;
-  switch (wValue) {
-    case CY_FX_UVC_PU_BRIGHTNESS_CONTROL:
-      switch (bRequest) {
-        case CY_FX_USB_UVC_GET_LEN_REQ: // Length of brightness data = 1 byte
-          glEp0Buffer[0] = 1;
-          CyU3PUsbSendEP0Data (2, (uint8_t*)glEp0Buffer);
+  uint16_t zoomVal;
+  int32_t  panVal, tiltVal;
+
+  CyBool_t sendData = CyFalse;
+  switch (req->wValue) {
+    case CY_FX_UVC_CT_AE_MODE_CONTROL:
+      switch (req->bRequest) {
+        //{{{
+        case CY_FX_USB_UVC_GET_INFO_REQ:
+          glEp0Buffer[0] = 3;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
           break;
-        case CY_FX_USB_UVC_GET_CUR_REQ: // Current brightness value
-          glEp0Buffer[0] = sensorGetBrightness();
-          CyU3PUsbSendEP0Data (2, (uint8_t*)glEp0Buffer);
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_CUR_REQ:
+          glEp0Buffer[0] = aeaf.aeMode;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
           break;
-        case CY_FX_USB_UVC_GET_MIN_REQ: // Minimum brightness = 0
-          glEp0Buffer[0] = 0;
-          CyU3PUsbSendEP0Data (2, (uint8_t*)glEp0Buffer);
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_RES_REQ: // bitmap of supported modes
+          glEp0Buffer[0] = AE_MODE_MANUAL | AE_MODE_APERTURE;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
           break;
-        case CY_FX_USB_UVC_GET_MAX_REQ: // Maximum brightness = 255
-          glEp0Buffer[0] = 255;
-          CyU3PUsbSendEP0Data (2, (uint8_t*)glEp0Buffer);
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_DEF_REQ:
+          glEp0Buffer[0] = AE_MODE_APERTURE;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
           break;
-        case CY_FX_USB_UVC_GET_RES_REQ: // Resolution = 1
-          glEp0Buffer[0] = 1;
-          CyU3PUsbSendEP0Data (2, (uint8_t*)glEp0Buffer);
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_SET_CUR_REQ:
+          apiRetStatus = CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, glEp0Buffer, &readCount);
+          // data stage acks the request, unsupported mode dropped, GET_CUR shows it
+          if ((apiRetStatus == CY_U3P_SUCCESS) &&
+              ((glEp0Buffer[0] == AE_MODE_MANUAL) || (glEp0Buffer[0] == AE_MODE_APERTURE))) {
+            aeaf.aeMode = glEp0Buffer[0];
+            aeaf.aeState = AEAF_IDLE;
+            }
           break;
-        case CY_FX_USB_UVC_GET_INFO_REQ: // Both GET and SET requests are supported, auto modes not supported
-          glEp0Buffer[0] = 3;
+        //}}}
+        //{{{
+        default:
+          CyU3PUsbStall (0, CyTrue, CyFalse);
+          break;
+        //}}}
+        }
+      break;
+
+    case CY_FX_UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL: {
+      uint32_t exposureVal = 0;
+      switch (req->bRequest) {
+        //{{{
+        case CY_FX_USB_UVC_GET_INFO_REQ: // GET/SET, autoupdate, disabled while auto
+          glEp0Buffer[0] = (aeaf.aeMode == AE_MODE_APERTURE) ? 0x0F : 0x0B;
           CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
           break;
-        case CY_FX_USB_UVC_GET_DEF_REQ: // Default brightness value = 55
-          glEp0Buffer[0] = 55;
-          CyU3PUsbSendEP0Data (2, (uint8_t*)glEp0Buffer);
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_CUR_REQ:
+          exposureVal = aeaf.exposure;
+          sendData = CyTrue;
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_MIN_REQ:
+        case CY_FX_USB_UVC_GET_RES_REQ:
+          exposureVal = 1;
+          sendData = CyTrue;
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_MAX_REQ:
+          exposureVal = aeExposureMax();
+          sendData = CyTrue;
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_DEF_REQ:
+          exposureVal = 333;
+          sendData = CyTrue;
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_SET_CUR_REQ:
+          apiRetStatus = CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, glEp0Buffer, &readCount);
+          if (apiRetStatus == CY_U3P_SUCCESS) {
+            exposureVal = (glEp0Buffer[0]) | (glEp0Buffer[1] << 8) |
+                          (glEp0Buffer[2] << 16) | (glEp0Buffer[3] << 24);
+            // data stage acks the request, exposure out of range or under auto ae dropped
+            if ((aeaf.aeMode == AE_MODE_MANUAL) && exposureVal && (exposureVal <= aeExposureMax())) {
+              aeaf.exposure = exposureVal;
+              aeaf.aeState = AEAF_IDLE;
+              }
+            }
           break;
-        case CY_FX_USB_UVC_SET_CUR_REQ: // Update brightness value
-           if (CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, glEp0Buffer, &readCount) == CY_U3P_SUCCESS) {
-             sensorSetBrightness (glEp0Buffer[0]);
-             line3 ("bright", glEp0Buffer[0]);
-             }
-           break;
+        //}}}
+        //{{{
         default:
           CyU3PUsbStall (0, CyTrue, CyFalse);
           break;
+        //}}}
+        }
+      if (sendData) {
+        //{{{  Send the 4-byte exposure back to the USB host
+        glEp0Buffer[0] = CY_U3P_DWORD_GET_BYTE0 (exposureVal);
+        glEp0Buffer[1] = CY_U3P_DWORD_GET_BYTE1 (exposureVal);
+        glEp0Buffer[2] = CY_U3P_DWORD_GET_BYTE2 (exposureVal);
+        glEp0Buffer[3] = CY_U3P_DWORD_GET_BYTE3 (exposureVal);
+        CyU3PUsbSendEP0Data (4, (uint8_t*)glEp0Buffer);
         }
+        //}}}
       break;
+      }
 
-    default:
-      // Only the brightness control is supported as of now. Add additional code here to support other controls
-      CyU3PUsbStall (0, CyTrue, CyFalse);
+    case CY_FX_UVC_CT_FOCUS_AUTO_CONTROL:
+      switch (req->bRequest) {
+        //{{{
+        case CY_FX_USB_UVC_GET_INFO_REQ:
+          glEp0Buffer[0] = 3;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_CUR_REQ:
+          glEp0Buffer[0] = aeaf.focusAuto;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_DEF_REQ:
+          glEp0Buffer[0] = 1;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_SET_CUR_REQ:
+          apiRetStatus = CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, glEp0Buffer, &readCount);
+          if (apiRetStatus == CY_U3P_SUCCESS) {
+            aeaf.focusAuto = glEp0Buffer[0] ? 1 : 0;
+            aeaf.afState = AEAF_IDLE;
+            }
+          break;
+        //}}}
+        //{{{
+        default:
+          CyU3PUsbStall (0, CyTrue, CyFalse);
+          break;
+        //}}}
+        }
       break;
-    }
-  }
-//}}}
-//{{{
-static void cameraTerminalRequests() {
 
-  CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
-
-  uint16_t readCount;
-  uint16_t zoomVal;
-  int32_t  panVal, tiltVal;
-
-  CyBool_t sendData = CyFalse;
-  switch (wValue) {
     case CY_FX_UVC_CT_ZOOM_ABSOLUTE_CONTROL:
-      switch (bRequest) {
+      switch (req->bRequest) {
         //{{{
         case CY_FX_USB_UVC_GET_INFO_REQ:
           glEp0Buffer[0] = 3;                /* Support GET/SET queries. */
@@ -1410,13 +2775,13 @@ static void cameraTerminalRequests() {
         //{{{  Send the 2-byte data in zoomVal back to the USB host
         glEp0Buffer[0] = CY_U3P_GET_LSB (zoomVal);
         glEp0Buffer[1] = CY_U3P_GET_MSB (zoomVal);
-        CyU3PUsbSendEP0Data (wLength, (uint8_t*)glEp0Buffer);
+        CyU3PUsbSendEP0Data (req->wLength, (uint8_t*)glEp0Buffer);
         }
         //}}}
       break;
 
     case CY_FX_UVC_CT_PANTILT_ABSOLUTE_CONTROL:
-      switch (bRequest) {
+      switch (req->bRequest) {
         //{{{
         case CY_FX_USB_UVC_GET_INFO_REQ:
           glEp0Buffer[0] = 3;                /* GET/SET requests supported for this control */
@@ -1463,7 +2828,7 @@ static void cameraTerminalRequests() {
           apiRetStatus = CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, glEp0Buffer, &readCount);
           if (apiRetStatus == CY_U3P_SUCCESS) {
             panVal = (glEp0Buffer[0]) | (glEp0Buffer[1]<<8) |
-                     (glEp0Buffer[2]<<16) | (glEp0Buffer[2]<<24);
+                     (glEp0Buffer[2]<<16) | (glEp0Buffer[3]<<24);
             tiltVal = (glEp0Buffer[4]) | (glEp0Buffer[5]<<8) |
                       (glEp0Buffer[6]<<16) | (glEp0Buffer[7]<<24);
 
@@ -1488,7 +2853,7 @@ static void cameraTerminalRequests() {
         glEp0Buffer[5] = CY_U3P_DWORD_GET_BYTE1 (tiltVal);
         glEp0Buffer[6] = CY_U3P_DWORD_GET_BYTE2 (tiltVal);
         glEp0Buffer[7] = CY_U3P_DWORD_GET_BYTE3 (tiltVal);
-        CyU3PUsbSendEP0Data (wLength, (uint8_t*)glEp0Buffer);
+        CyU3PUsbSendEP0Data (req->wLength, (uint8_t*)glEp0Buffer);
         //}}}
         }
       break;
@@ -1500,14 +2865,19 @@ static void cameraTerminalRequests() {
   }
 //}}}
 //{{{
-static void videoStreamingRequests() {
+static void videoStreamingRequests (const setupReq_t* req) {
+// probe negotiates frame, interval against frame table, commit configures sensor, starts stream
 
   CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
   uint16_t readCount;
 
-  switch (wValue) {
+  if (probeCtrl[2] == 0)
+    // not negotiated since connect, default frame, interval
+    probeFill (probeCtrl, FORMAT_YUY2, 1, 0);
+
+  switch (req->wValue) {
     case CY_FX_UVC_PROBE_CTRL:
-      switch (bRequest) {
+      switch (req->bRequest) {
         //{{{
         case CY_FX_USB_UVC_GET_INFO_REQ:
           glEp0Buffer[0] = 3;                /* GET/SET requests are supported. */
@@ -1520,31 +2890,36 @@ static void videoStreamingRequests() {
           CyU3PUsbSendEP0Data (1, (uint8_t *)glEp0Buffer);
           break;
         //}}}
+        //{{{
         case CY_FX_USB_UVC_GET_CUR_REQ:
-        case CY_FX_USB_UVC_GET_MIN_REQ:
-        case CY_FX_USB_UVC_GET_MAX_REQ:
+          CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, probeCtrl);
+          break;
+        //}}}
         //{{{
-        case CY_FX_USB_UVC_GET_DEF_REQ: // There is only one setting per USB speed
-          if (usbSpeed == CY_U3P_SUPER_SPEED)
-            CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, (uint8_t*)probeCtrl30);
-          else
-            CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, (uint8_t*)probeCtrl20);
+        case CY_FX_USB_UVC_GET_MIN_REQ: // fastest interval of probed frame
+          probeFill (glEp0Buffer, probeCtrl[2], probeCtrl[3], 0);
+          CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_MAX_REQ: // slowest interval of probed frame
+          probeFill (glEp0Buffer, probeCtrl[2], probeCtrl[3], 0xFFFFFFFF);
+          CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_DEF_REQ:
+          probeFill (glEp0Buffer, FORMAT_YUY2, 1, 0);
+          CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, glEp0Buffer);
           break;
         //}}}
         //{{{
         case CY_FX_USB_UVC_SET_CUR_REQ:
           apiRetStatus = CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, commitCtrl, &readCount);
-          if (apiRetStatus == CY_U3P_SUCCESS) {
-            if (usbSpeed == CY_U3P_SUPER_SPEED) {
-              // Copy from the host provided data into the active data
-              probeCtrl30[2] = commitCtrl[2];
-              probeCtrl30[3] = commitCtrl[3];
-              probeCtrl30[4] = commitCtrl[4];
-              probeCtrl30[5] = commitCtrl[5];
-              probeCtrl30[6] = commitCtrl[6];
-              probeCtrl30[7] = commitCtrl[7];
-              }
-            }
+          if (apiRetStatus == CY_U3P_SUCCESS)
+            // clamp host request to what the frame table and usb speed support
+            probeFill (probeCtrl, commitCtrl[2], commitCtrl[3],
+                       commitCtrl[4] | (commitCtrl[5] << 8) | (commitCtrl[6] << 16) | (commitCtrl[7] << 24));
           break;
         //}}}
         //{{{
@@ -1556,7 +2931,7 @@ static void videoStreamingRequests() {
       break;
 
     case CY_FX_UVC_COMMIT_CTRL:
-      switch (bRequest) {
+      switch (req->bRequest) {
         //{{{
         case CY_FX_USB_UVC_GET_INFO_REQ:
           glEp0Buffer[0] = 3;                        /* GET/SET requests are supported. */
@@ -1571,10 +2946,8 @@ static void videoStreamingRequests() {
         //}}}
         //{{{
         case CY_FX_USB_UVC_GET_CUR_REQ:
-          if (usbSpeed == CY_U3P_SUPER_SPEED)
-            CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, (uint8_t*)probeCtrl30);
-          else
-            CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, (uint8_t*)probeCtrl20);
+          probeFill (glEp0Buffer, curFormat, curFrameIndex, curInterval);
+          CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_PROBE_SETTING, glEp0Buffer);
           break;
         //}}}
         //{{{
@@ -1583,16 +2956,85 @@ static void videoStreamingRequests() {
           // resolution settings, configure the sensor and start the video stream
           apiRetStatus = CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, commitCtrl, &readCount);
           if (apiRetStatus == CY_U3P_SUCCESS) {
+            curFormat = ((commitCtrl[2] == FORMAT_MJPEG) && sensorJpegCapable()) ? FORMAT_MJPEG : FORMAT_YUY2;
+            const frame_t* frame = frameFind (curFormat, commitCtrl[3]);
+            curFrameIndex = frame->index;
+            curInterval = frameInterval (curFormat, frame,
+              commitCtrl[4] | (commitCtrl[5] << 8) | (commitCtrl[6] << 16) | (commitCtrl[7] << 24));
+
+            // replan dma buffers if frame size changed, sensor thread starts stream once sensor switched
+            channelSetMode (CHANNEL_UVC);
+            sensorPost (SENSOR_MODE, frame->height, curFormat == FORMAT_MJPEG, curInterval);
+            }
 
-        #ifdef lines1200
-            sensorScaling (usbSpeed == CY_U3P_SUPER_SPEED ? 1200 : 600);
-        #else
-            sensorScaling (600);
-        #endif
+          break;
+        //}}}
+        //{{{
+        default:
+          CyU3PUsbStall (0, CyTrue, CyFalse);
+          break;
+        //}}}
+        }
+      break;
 
-            CyU3PEventSet (&uvcEvent, STREAM_EVENT, CYU3P_EVENT_OR);
-            }
+    case CY_FX_UVC_STILL_PROBE_CTRL:
+    case CY_FX_UVC_STILL_COMMIT_CTRL:
+      // one still size, probe and commit both settle on it
+      switch (req->bRequest) {
+        //{{{
+        case CY_FX_USB_UVC_GET_INFO_REQ:
+          glEp0Buffer[0] = 3;                /* GET/SET requests are supported. */
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_LEN_REQ:
+          glEp0Buffer[0] = CY_FX_UVC_MAX_STILL_PROBE;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_CUR_REQ:
+        case CY_FX_USB_UVC_GET_MIN_REQ:
+        case CY_FX_USB_UVC_GET_MAX_REQ:
+        case CY_FX_USB_UVC_GET_DEF_REQ:
+          stillFill (stillProbe);
+          CyU3PUsbSendEP0Data (CY_FX_UVC_MAX_STILL_PROBE, stillProbe);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_SET_CUR_REQ:
+          // accept, host reads back the only still it can have
+          CyU3PUsbGetEP0Data (CY_FX_UVC_MAX_PROBE_SETTING_ALIGNED, glEp0Buffer, &readCount);
+          break;
+        //}}}
+        //{{{
+        default:
+          CyU3PUsbStall (0, CyTrue, CyFalse);
+          break;
+        //}}}
+        }
+      break;
 
+    case CY_FX_UVC_STILL_TRIGGER_CTRL:
+      switch (req->bRequest) {
+        //{{{
+        case CY_FX_USB_UVC_GET_INFO_REQ:
+          glEp0Buffer[0] = 3;                /* GET/SET requests are supported. */
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_GET_CUR_REQ: // 1 still in progress, 0 normal operation
+          glEp0Buffer[0] = stillState != STILL_IDLE;
+          CyU3PUsbSendEP0Data (1, (uint8_t*)glEp0Buffer);
+          break;
+        //}}}
+        //{{{
+        case CY_FX_USB_UVC_SET_CUR_REQ: // 1 transmit still in the video stream, 0, 3 nothing to abort
+          apiRetStatus = CyU3PUsbGetEP0Data (16, glEp0Buffer, &readCount);
+          if ((apiRetStatus == CY_U3P_SUCCESS) && (glEp0Buffer[0] == 1))
+            sensorPost (SENSOR_STILL, 0, 0, 0);
           break;
         //}}}
         //{{{
@@ -1610,9 +3052,41 @@ static void videoStreamingRequests() {
   }
 //}}}
 //{{{
+static void vendorRequests (const setupReq_t* req) {
+// vendor requests that block, queued by the setup callback
+
+  switch (req->bRequest) {
+    case 0xAF:
+      //{{{  start analyser streaming
+      if (req->wLength)
+        CyU3PUsbGetEP0Data ((req->wLength < sizeof(glEp0Buffer)) ? req->wLength : sizeof(glEp0Buffer), glEp0Buffer, NULL);
+      else
+        CyU3PUsbAckSetup();
+
+      if (streamingStarted == CyTrue) {
+        stopStreaming();
+        abortHandler();
+        }
+
+      channelSetMode (CHANNEL_ANALYSER);
+      analyserSequence = 0;
+
+      // sensor thread scales, then starts the stream
+      sensorPost (SENSOR_ANALYSER, 600, 0, 0);
+      break;
+      //}}}
+
+    default:
+      CyU3PUsbStall (0, CyTrue, CyFalse);
+      break;
+    }
+  }
+//}}}
+//{{{
 static void controlThreadFunc (uint32_t input) {
+// drains setup queue, each request handled from its own queued copy, sensor i2c posted to sensor thread
 
-  uint32_t eventMask = VIDEO_CONTROL_EVENT | VIDEO_STREAM_EVENT | BUTTON_DOWN_EVENT | BUTTON_UP_EVENT;
+  uint32_t eventMask = SETUP_EVENT | BUTTON_DOWN_EVENT | BUTTON_UP_EVENT | STATUS_EVENT;
   for (;;) {
     uint32_t eventFlag;
     if (CyU3PEventGet (&uvcEvent, eventMask, CYU3P_EVENT_OR_CLEAR, &eventFlag, CYU3P_WAIT_FOREVER) == CY_U3P_SUCCESS) {
@@ -1629,48 +3103,303 @@ static void controlThreadFunc (uint32_t input) {
           line1 ("uvc 0");
         }
         //}}}
-      if (eventFlag & VIDEO_CONTROL_EVENT) {
-        //{{{  videoControl requests
-        switch ((wIndex >> 8)) {
-          case CY_FX_UVC_PROCESSING_UNIT_ID:
-            processingUnitRequests();
-            break;
-
-          case CY_FX_UVC_CAMERA_TERMINAL_ID:
-            cameraTerminalRequests();
-            break;
-
-          case CY_FX_UVC_INTERFACE_CTRL:
-            CyU3PUsbStall (0, CyTrue, CyFalse);
-            break;
-
-          case CY_FX_UVC_EXTENSION_UNIT_ID:
-            CyU3PUsbStall (0, CyTrue, CyFalse);
-            break;
-
-          default:
-            // Unsupported request. Fail by stalling the control endpoint
-            CyU3PUsbStall (0, CyTrue, CyFalse);
-            break;
+      while (setupOut != setupIn) {
+        const setupReq_t* req = &setupQueue[setupOut % SETUP_QUEUE_SIZE];
+        if ((req->bReqType & CY_U3P_USB_TYPE_MASK) == CY_U3P_USB_VENDOR_RQT)
+          vendorRequests (req);
+        else if ((req->wIndex & 0xFF) == CY_FX_UVC_CONTROL_INTERFACE) {
+          //{{{  videoControl requests
+          switch ((req->wIndex >> 8)) {
+            case CY_FX_UVC_PROCESSING_UNIT_ID:
+              processingUnitRequests (req);
+              break;
+
+            case CY_FX_UVC_CAMERA_TERMINAL_ID:
+              cameraTerminalRequests (req);
+              break;
+
+            case CY_FX_UVC_INTERFACE_CTRL:
+              CyU3PUsbStall (0, CyTrue, CyFalse);
+              break;
+
+            case CY_FX_UVC_EXTENSION_UNIT_ID:
+              CyU3PUsbStall (0, CyTrue, CyFalse);
+              break;
+
+            default:
+              // Unsupported request. Fail by stalling the control endpoint
+              CyU3PUsbStall (0, CyTrue, CyFalse);
+              break;
+            }
           }
-        }
-        //}}}
-      if (eventFlag & VIDEO_STREAM_EVENT) {
-        if (wIndex == CY_FX_UVC_STREAM_INTERFACE)
-          videoStreamingRequests();
+          //}}}
+        else if (req->wIndex == CY_FX_UVC_STREAM_INTERFACE)
+          videoStreamingRequests (req);
         else
           CyU3PUsbStall (0, CyTrue, CyFalse);
+        setupOut++;
         }
       if (eventFlag & BUTTON_DOWN_EVENT)
-        sensorButton (1);
-      if (eventFlag & BUTTON_UP_EVENT)
-        sensorButton (0);
+        // button up only reported in the status packet
+        sensorPost (SENSOR_STILL, 0, 0, 0);
+      if (eventFlag & STATUS_EVENT)
+        statusSend();
       }
 
     CyU3PThreadRelinquish();
     }
   }
 //}}}
+//{{{
+static void stillCapture() {
+// one still frame, switch sensor to capture mode B, wait for the vid thread to send it, back to preview
+// - sensor thread, holds sensorMutex for the mode switches, released for the wait, ae af skip still frames
+// - preview gap is the two seq.state switches plus the still frame, reported in telemetry
+// - bulk only, isochronous bandwidth is reserved for the preview frame rate
+
+  if (UVC_ISOC || !streamingStarted || (channelMode == CHANNEL_ANALYSER) ||
+      (curFormat != FORMAT_YUY2) || (stillState != STILL_IDLE))
+    return;
+
+  uint32_t startMs = CyU3PGetTime();
+  const frame_t* frame = frameFind (curFormat, curFrameIndex);
+  CyBool_t preview = frame->height != STILL_HEIGHT;
+
+  uint32_t flag;
+  CyU3PEventGet (&uvcEvent, STILL_EVENT, CYU3P_EVENT_OR_CLEAR, &flag, CYU3P_NO_WAIT);
+  if (preview) {
+    stillState = STILL_SWITCH;
+    sensorScaling (STILL_HEIGHT);
+    }
+  stillState = STILL_ARMED;
+
+  CyU3PMutexPut (&sensorMutex);
+  if (CyU3PEventGet (&uvcEvent, STILL_EVENT, CYU3P_EVENT_OR_CLEAR, &flag, STILL_TIMEOUT) != CY_U3P_SUCCESS)
+    telemetry.stillTimeouts++;
+  CyU3PMutexGet (&sensorMutex, CYU3P_WAIT_FOREVER);
+
+  stillState = STILL_DONE;
+  if (preview) {
+    sensorScaling (frame->height);
+    sensorFrameInterval (frame->height, curInterval);
+    PTZRefresh();
+    }
+  stillState = STILL_IDLE;
+
+  telemetry.stillGapMsLast = CyU3PGetTime() - startMs;
+  if (telemetry.stillGapMsLast > telemetry.stillGapMsMax)
+    telemetry.stillGapMsMax = telemetry.stillGapMsLast;
+  }
+//}}}
+//{{{
+static void sensorThreadFunc (uint32_t input) {
+// runs sensor work below vid, control thread priority, slow i2c never delays frame boundaries or ep0
+
+  for (;;) {
+    sensorWork_t work;
+    if (CyU3PQueueReceive (&sensorQueue, &work, CYU3P_WAIT_FOREVER) == CY_U3P_SUCCESS) {
+      CyU3PMutexGet (&sensorMutex, CYU3P_WAIT_FOREVER);
+      switch (work.op) {
+        case SENSOR_CONTROL:
+          sensorControl (work.arg, (int16_t)work.value);
+          break;
+
+        case SENSOR_STILL:
+          stillCapture();
+          break;
+
+        case SENSOR_FOCUS:
+          sensorFocus (work.value);
+          break;
+
+        case SENSOR_MODE:
+          sensorJpeg (work.value, work.arg);
+          sensorScaling (work.value);
+          sensorFrameInterval (work.value, work.interval);
+          PTZRefresh();
+          break;
+
+        case SENSOR_READ:
+          I2C_Read (work.value >> 8, work.value & 0xFF, sensorEp0Buffer);
+          break;
+
+        case SENSOR_WRITE:
+          I2C_Write (work.value >> 8, work.value & 0xFF, work.interval >> 8, work.interval & 0xFF);
+          break;
+
+        case SENSOR_ANALYSER:
+          sensorScaling (work.value);
+          break;
+
+        default:
+          break;
+        }
+      CyU3PMutexPut (&sensorMutex);
+
+      if (work.op == SENSOR_READ)
+        CyU3PUsbSendEP0Data (2, sensorEp0Buffer);
+      if (((work.op == SENSOR_MODE) || (work.op == SENSOR_ANALYSER)) && (channelMode != CHANNEL_NONE))
+        streamStart();
+      }
+    }
+  }
+//}}}
+//{{{
+static void aeStep() {
+// luma roughly linear in exposure, scale exposure by target / luma, at most 2x per step,
+// step every other frame so each step is measured after the sensor has applied the last
+
+  if (aeaf.aeState == AEAF_IDLE) {
+    //{{{  apply mode
+    aeaf.sensorAe = !sensorExposure (aeaf.exposure);
+    sensorAutoExposure (aeaf.sensorAe && (aeaf.aeMode == AE_MODE_APERTURE));
+    if (aeaf.aeMode == AE_MODE_MANUAL) {
+      aeaf.aeState = AEAF_CONVERGED;
+      return;
+      }
+
+    aeaf.aeState = AEAF_SEARCH;
+    aeaf.aeFrames = 0;
+    aeStartMs = CyU3PGetTime();
+    aeaf.aeSearches++;
+    return;
+    }
+    //}}}
+  if (aeaf.aeMode != AE_MODE_APERTURE)
+    return;
+
+  int32_t target = puCur[CY_FX_UVC_PU_BRIGHTNESS_CONTROL >> 8];
+  int32_t error = (int32_t)aeaf.luma - target;
+  if (error < 0)
+    error = -error;
+
+  if (aeaf.aeState != AEAF_SEARCH) {
+    //{{{  converged or timed out, restart on a scene change
+    if (error <= 2 * AE_GATE)
+      return;
+
+    aeaf.aeState = AEAF_SEARCH;
+    aeaf.aeFrames = 0;
+    aeStartMs = CyU3PGetTime();
+    aeaf.aeSearches++;
+    }
+    //}}}
+
+  aeaf.aeFrames++;
+  if ((error <= AE_GATE) || (aeaf.aeFrames > AE_FRAMES_MAX)) {
+    // settled, host sees the autoupdate exposure without polling
+    aeaf.aeState = (error <= AE_GATE) ? AEAF_CONVERGED : AEAF_TIMEOUT;
+    aeaf.aeConvergeMs = CyU3PGetTime() - aeStartMs;
+    statusControl (CY_FX_UVC_CAMERA_TERMINAL_ID, CY_FX_UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL >> 8, aeaf.exposure, 4);
+    return;
+    }
+  if (aeaf.sensorAe || (aeaf.aeFrames & 1))
+    return;
+
+  uint32_t exposure = aeaf.luma ? (aeaf.exposure * target) / aeaf.luma : aeaf.exposure * 2;
+  if (exposure > aeaf.exposure * 2)
+    exposure = aeaf.exposure * 2;
+  if (exposure < aeaf.exposure / 2)
+    exposure = aeaf.exposure / 2;
+  if (exposure > aeExposureMax())
+    exposure = aeExposureMax();
+  if (exposure < 1)
+    exposure = 1;
+
+  aeaf.exposure = exposure;
+  sensorExposure (exposure);
+  }
+//}}}
+//{{{
+static void afStep() {
+// hill climb, coarse sweep of the focus pwm range, then narrower sweeps around the sharpest,
+// each frame's sharpness is for the focus set on the frame before
+
+  if (!aeaf.focusAuto) {
+    aeaf.afState = AEAF_IDLE;
+    return;
+    }
+
+  if (aeaf.afState >= AEAF_CONVERGED) {
+    // restart when sharpness falls well below the peak, scene changed
+    if (aeaf.sharpness >= (afPeakSharpness * 3) / 4)
+      return;
+    aeaf.afState = AEAF_IDLE;
+    }
+
+  if (aeaf.afState == AEAF_IDLE) {
+    //{{{  start coarse sweep
+    aeaf.afState = AEAF_SEARCH;
+    aeaf.afFrames = 0;
+    aeaf.afSearches++;
+    afStartMs = CyU3PGetTime();
+
+    afLo = AF_MIN;
+    afHi = AF_MAX;
+    afDelta = (AF_MAX - AF_MIN) / AF_STEPS;
+    afPeak = AF_MIN;
+    afPeakSharpness = 0;
+
+    aeaf.focus = afLo;
+    sensorFocus (aeaf.focus);
+    return;
+    }
+    //}}}
+
+  aeaf.afFrames++;
+  if (aeaf.sharpness > afPeakSharpness) {
+    afPeakSharpness = aeaf.sharpness;
+    afPeak = aeaf.focus;
+    }
+
+  if ((aeaf.afFrames < AF_FRAMES_MAX) && (aeaf.focus + afDelta <= afHi)) {
+    aeaf.focus += afDelta;
+    sensorFocus (aeaf.focus);
+    return;
+    }
+
+  if ((aeaf.afFrames < AF_FRAMES_MAX) && (afDelta > 1)) {
+    //{{{  narrower sweep around peak
+    afLo = (afPeak > AF_MIN + afDelta) ? afPeak - afDelta : AF_MIN;
+    afHi = (afPeak + afDelta < AF_MAX) ? afPeak + afDelta : AF_MAX;
+    afDelta = (afDelta / AF_FINE) ? (afDelta / AF_FINE) : 1;
+
+    aeaf.focus = afLo;
+    sensorFocus (aeaf.focus);
+    return;
+    }
+    //}}}
+
+  aeaf.afState = (aeaf.afFrames < AF_FRAMES_MAX) ? AEAF_CONVERGED : AEAF_TIMEOUT;
+  aeaf.afConvergeMs = CyU3PGetTime() - afStartMs;
+  aeaf.focus = afPeak;
+  sensorFocus (aeaf.focus);
+  }
+//}}}
+//{{{
+static void aeafThreadFunc (uint32_t input) {
+// one controller step, ptz window update per gpif end of frame while streaming
+// - sensor i2c shared under sensorMutex, statistics only read while ae or af active
+// - sensor latches crop window changes at its next frame start
+
+  for (;;) {
+    uint32_t eventFlag;
+    if (CyU3PEventGet (&uvcEvent, FRAME_EVENT, CYU3P_EVENT_OR_CLEAR, &eventFlag, CYU3P_WAIT_FOREVER) == CY_U3P_SUCCESS) {
+      if (!streamingStarted || (channelMode == CHANNEL_ANALYSER) || (stillState != STILL_IDLE))
+        continue;
+
+      CyU3PMutexGet (&sensorMutex, CYU3P_WAIT_FOREVER);
+      if ((aeaf.aeMode == AE_MODE_APERTURE) || aeaf.focusAuto || (aeaf.aeState == AEAF_IDLE)) {
+        sensorStats (&aeaf.luma, &aeaf.sharpness);
+        aeStep();
+        afStep();
+        }
+      PTZFrame (frameFind (curFormat, curFrameIndex)->height);
+      CyU3PMutexPut (&sensorMutex);
+      }
+    }
+  }
+//}}}
 
 // init
 //{{{
@@ -1698,13 +3427,16 @@ static void debugInit() {
 static void gpioInit() {
 
   CyU3PGpioClock_t gpioClock;
-  gpioClock.fastClkDiv = 2;
+  gpioClock.fastClkDiv = TIMER_FAST_CLK_DIV;
   gpioClock.slowClkDiv = 2;
   gpioClock.simpleDiv  = CY_U3P_GPIO_SIMPLE_DIV_BY_2;
   gpioClock.clkSrc     = CY_U3P_SYS_CLK;
   gpioClock.halfDiv    = 0;
   CyU3PGpioInit (&gpioClock, gpioInterruptCallback);
 
+  // free running timestamp counter for UVC PTS, SCR
+  timerInit();
+
   // Confige BUTTON_GPIO to trigger interrupt on falling edge
   CyU3PDeviceGpioOverride (BUTTON_GPIO, CyTrue);
   CyU3PGpioSimpleConfig_t gpioConfig;
@@ -1735,6 +3467,19 @@ static void gpioInit() {
 static void appInit() {
 
   CyU3PEventCreate (&uvcEvent);
+  CyU3PMutexCreate (&sensorMutex, CYU3P_INHERIT);
+  CyU3PMutexCreate (&channelMutex, CYU3P_INHERIT);
+  // threadx queue messages are 1,2,4,8 or 16 words, any other size fails create
+  if (CyU3PQueueCreate (&sensorQueue, sizeof(sensorWork_t) / 4, sensorQueueMem, sizeof(sensorQueueMem)) != CY_U3P_SUCCESS) {
+    CyU3PDebugPrint (4, "sensorQueue create failed\r\n");
+    line2 ("sensorQueue fail");
+    }
+  if (CyU3PQueueCreate (&statusQueue, sizeof(statusPacket_t) / 4, statusQueueMem, sizeof(statusQueueMem)) != CY_U3P_SUCCESS) {
+    CyU3PDebugPrint (4, "statusQueue create failed\r\n");
+    line2 ("statusQueue fail");
+    }
+  for (uint32_t i = 0; i < PU_CONTROLS; i++)
+    puCur[i] = puControls[i].def;
   //{{{  init P-port
   CyU3PPibClock_t pibClock;
   pibClock.clkDiv = 2;
@@ -1766,9 +3511,7 @@ static void appInit() {
   CyU3PUsbSetDesc (CY_U3P_USB_SET_STRING_DESCR, 2, (uint8_t*)CyFxUSBProductDscr);
 
   //{{{  config status interrupt endpoint
-  // Note: This endpoint is not being used by the application as of now. This can be used in case
-  // UVC device needs to notify the host about any error conditions. A MANUAL_OUT DMA channel
-  // can be associated with this endpoint and used to send these data packets.
+  // control change and stream error status packets, cpu to ep2 through a MANUAL_OUT channel
   CyU3PEpConfig_t epConfig;
 
   epConfig.enable   = 1;
@@ -1777,6 +3520,18 @@ static void appInit() {
   epConfig.burstLen = 1;
 
   CyU3PSetEpConfig (CY_FX_EP_CONTROL_STATUS, &epConfig);
+
+  CyU3PDmaChannelConfig_t dmaConfig;
+  CyU3PMemSet ((uint8_t*)&dmaConfig, 0, sizeof(dmaConfig));
+  dmaConfig.size         = 64;
+  dmaConfig.count        = STATUS_QUEUE_SIZE / 2;
+  dmaConfig.prodSckId    = CY_U3P_CPU_SOCKET_PROD;
+  dmaConfig.consSckId    = CY_U3P_UIB_SOCKET_CONS_2; // ep2
+  dmaConfig.dmaMode      = CY_U3P_DMA_MODE_BYTE;
+  dmaConfig.notification = 0;
+  dmaConfig.cb           = NULL;
+  CyU3PDmaChannelCreate (&statusChannel, CY_U3P_DMA_TYPE_MANUAL_OUT, &dmaConfig);
+  CyU3PDmaChannelSetXfer (&statusChannel, 0);
   //}}}
   //{{{  config video streaming endpoints
   CyU3PMemSet ((uint8_t*)&epConfig, 0, sizeof(epConfig));
@@ -1787,7 +3542,8 @@ static void appInit() {
   epConfig.burstLen = 16;
 
   CyU3PSetEpConfig (CY_FX_EP_CONSUMER, &epConfig);
-  CyU3PSetEpConfig (CY_FX_EP_BULK_VID, &epConfig);
+  if (!UVC_ISOC)
+    CyU3PSetEpConfig (CY_FX_EP_BULK_VID, &epConfig); // isochronous configured by streamSetAlt
   //}}}
 
   // enable USB connection from the FX3 device, preferably at USB 3.0 speed
@@ -1828,6 +3584,32 @@ void CyFxApplicationDefine() {
     CYU3P_NO_TIME_SLICE,     // No time slice for the application thread
     CYU3P_AUTO_START         // Start the Thread immediately
     );
+
+  // Create the ae af controller thread, same priority as sensor worker
+  CyU3PThreadCreate (&aeafThread,
+    "33:UVC aeafThread",     // Thread Id and name
+    aeafThreadFunc,          // ae af controller
+    0,                       // No input parameter to thread
+    CyU3PMemAlloc (0x0800),  // Pointer to the allocated thread stack
+    0x0800,                  // stack size
+    10,                      // lower priority than vid, control threads
+    10,                      // Threshold value for thread pre-emption.
+    CYU3P_NO_TIME_SLICE,     // No time slice for the application thread
+    CYU3P_AUTO_START         // Start the Thread immediately
+    );
+
+  // Create the sensor i2c worker thread, lower priority than vid and control
+  CyU3PThreadCreate (&sensorThread,
+    "32:UVC sensorThread",   // Thread Id and name
+    sensorThreadFunc,        // sensor i2c worker
+    0,                       // No input parameter to thread
+    CyU3PMemAlloc (0x0800),  // Pointer to the allocated thread stack
+    0x0800,                  // stack size
+    10,                      // lower priority than vid, control threads
+    10,                      // Threshold value for thread pre-emption.
+    CYU3P_NO_TIME_SLICE,     // No time slice for the application thread
+    CYU3P_AUTO_START         // Start the Thread immediately
+    );
   }
 //}}}
 
@@ -1853,7 +3635,7 @@ int main() {
   io_cfg.gpioSimpleEn[0]  = 0;
   io_cfg.gpioSimpleEn[1]  = 0;
   io_cfg.gpioComplexEn[0] = 0;
-  io_cfg.gpioComplexEn[1] = 0;
+  io_cfg.gpioComplexEn[1] = 1 << (TIMER_GPIO - 32);
   CyU3PDeviceConfigureIOMatrix (&io_cfg);
 
   CyU3PKernelEntry();